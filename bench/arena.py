@@ -0,0 +1,139 @@
+#!/usr/bin/python
+"""
+Allocation counts and memory use of arena vs. malloc decoding.
+
+Loads a corpus of certificates (PEM bundles, DER files or concatenated DER, or directories of
+them), then, in a fresh process for each mode, decodes every certificate into a list of cx509
+objects, calls the main getters on each, and frees them. Reports C library allocator calls per
+certificate (from cx509._alloc_stats()), resident memory per live certificate, and the time taken
+to decode and to free.
+
+usage: python bench/arena.py [-r REPEAT] corpus [corpus ...]
+"""
+import os
+import re
+import sys
+import gc
+import json
+import time
+import base64
+import argparse
+import subprocess
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+import cx509
+
+PEM_RE = re.compile(r"-----BEGIN [A-Z0-9 ]*CERTIFICATE-----(.*?)-----END [A-Z0-9 ]*CERTIFICATE-----", re.S)
+
+
+def split_der(data):
+    """Split concatenated DER certificates using the outer SEQUENCE lengths."""
+    certs = []
+    offset = 0
+    while offset + 2 <= len(data):
+        length = ord(data[offset + 1])
+        header = 2
+        if length & 0x80:
+            n = length & 0x7f
+            length = 0
+            for b in data[offset + 2:offset + 2 + n]:
+                length = (length << 8) | ord(b)
+            header += n
+        certs.append(data[offset:offset + header + length])
+        offset += header + length
+    return certs
+
+
+def load_corpus(paths):
+    certs = []
+    for path in paths:
+        if os.path.isdir(path):
+            names = [os.path.join(d, f) for d, _, files in os.walk(path) for f in sorted(files)]
+        else:
+            names = [path]
+        for name in names:
+            data = open(name, "rb").read()
+            if "-----BEGIN" in data:
+                certs.extend(base64.b64decode("".join(body.split())) for body in PEM_RE.findall(data))
+            else:
+                certs.extend(split_der(data))
+    return certs
+
+
+def rss():
+    try:
+        return int(open("/proc/self/statm").read().split()[1]) * os.sysconf("SC_PAGE_SIZE")
+    except (IOError, OSError):
+        import resource
+        return resource.getrusage(resource.RUSAGE_SELF).ru_maxrss * 1024
+
+
+def delta(after, before):
+    return dict((k, after[k] - before[k]) for k in after)
+
+
+def child(mode, certs):
+    cx509._use_arena(mode == "arena")
+    gc.collect()
+    gc.disable()
+
+    rss0 = rss()
+    s0 = cx509._alloc_stats()
+    start = time.time()
+    objs = [cx509.cx509(der) for der in certs]
+    decoded = time.time()
+    s1 = cx509._alloc_stats()
+    rss1 = rss()
+
+    for c in objs:
+        if c.get_version() is not None:
+            c.get_subject()
+            c.get_issuer()
+            c.extensions()
+            c.get_public_key()
+    s2 = cx509._alloc_stats()
+
+    freeing = time.time()
+    del objs
+    freed = time.time()
+    s3 = cx509._alloc_stats()
+
+    return {
+        "decode": delta(s1, s0),
+        "getters": delta(s2, s1),
+        "free": delta(s3, s2),
+        "rss": rss1 - rss0,
+        "decode_sec": decoded - start,
+        "free_sec": freed - freeing,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description="arena vs. malloc decoding")
+    parser.add_argument("-r", "--repeat", type=int, default=1, help="decode the corpus this many times over")
+    parser.add_argument("--child", choices=["malloc", "arena"], help=argparse.SUPPRESS)
+    parser.add_argument("corpus", nargs="+", help="certificate files or directories")
+    args = parser.parse_args()
+
+    certs = load_corpus(args.corpus) * args.repeat
+    if args.child:
+        print json.dumps(child(args.child, certs))
+        return
+
+    if not certs:
+        sys.exit("no certificates found")
+    n = float(len(certs))
+    print "%d certificates" % len(certs)
+    print "%-8s %12s %12s %12s %12s %12s %10s %10s" % ("mode", "malloc/cert", "arena/cert", "getters/cert",
+                                                      "free()/cert", "KB/cert", "decode s", "free s")
+    for mode in ("malloc", "arena"):
+        out = subprocess.Popen([sys.executable, os.path.abspath(__file__), "--child", mode, "-r", str(args.repeat)] +
+                               args.corpus, stdout=subprocess.PIPE).communicate()[0]
+        r = json.loads(out)
+        print "%-8s %12.1f %12.1f %12.1f %12.1f %12.2f %10.3f %10.3f" % (
+            mode, r["decode"]["malloc"] / n, r["decode"]["arena"] / n, r["getters"]["malloc"] / n,
+            r["free"]["free"] / n, r["rss"] / n / 1024, r["decode_sec"], r["free_sec"])
+
+
+if __name__ == "__main__":
+    main()
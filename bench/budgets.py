@@ -0,0 +1,105 @@
+#!/usr/bin/python
+"""
+Parse latency under adversarial input, with and without decode budgets.
+
+Mixes the synthetic corpus from bench/corpus.py with hostile encodings (deeply nested indefinite
+lengths, a certificate with a huge subjectAltName list, a flat run of many small elements, an
+oversized blob) and parses the mix ITERATIONS times, first with no limits and then with the
+given max_size/max_depth/max_elements/max_ns. Reports p50/p99/p99.9/max parse latency over each
+run for the well-formed certificates and for the hostile inputs, and how many parses were stopped
+by each budget.
+
+usage: python bench/budgets.py [-n ITERATIONS] [--max-size BYTES] [--max-depth LEVELS]
+                               [--max-elements COUNT] [--max-ns NS] [--seed SEED]
+"""
+import os
+import sys
+import timeit
+import argparse
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+import cx509
+import corpus
+
+
+def deep(levels):
+    """An INTEGER inside levels of indefinite-length SEQUENCEs."""
+    return "\x30\x80" * levels + "\x02\x01\x01" + "\x00\x00" * levels
+
+
+def flat(count):
+    """A SEQUENCE of count one-byte INTEGERs."""
+    body = "\x02\x01\x01" * count
+    n = len(body)
+    return "\x30\x84" + "".join(chr((n >> shift) & 0xff) for shift in (24, 16, 8, 0)) + body
+
+
+def hostile(seed):
+    """(name, input) pairs meant to be expensive to decode."""
+    kw = dict(corpus.DEFAULTS)
+    kw.update({"sans": 50000})
+    huge_san = corpus.build(len(corpus.PROFILES), seed, **kw)
+    blob = corpus.Encoder("der").octet_string("\x00" * (16 << 20))
+    return [
+        ("deep-indefinite", deep(100000)),
+        ("flat-elements", flat(1000000)),
+        ("san-50000", huge_san),
+        ("blob-16m", corpus.Encoder("der").seq(blob)),
+    ]
+
+
+def percentile(sorted_samples, p):
+    return sorted_samples[min(len(sorted_samples) - 1, int(len(sorted_samples) * p / 100.0))]
+
+
+def run(inputs, iterations, limits):
+    """Per-parse latencies (ns) for each input kind, and a count of BudgetExceeded by budget."""
+    latencies = {"corpus": [], "hostile": []}
+    stopped = {}
+    for i in xrange(iterations):
+        for kind, name, data in inputs:
+            start = timeit.default_timer()
+            try:
+                cx509.cx509(data, **limits)
+            except cx509.BudgetExceeded, e:
+                budget = str(e).rsplit(" ", 1)[-1]
+                stopped[budget] = stopped.get(budget, 0) + 1
+            latencies[kind].append((timeit.default_timer() - start) * 1e9)
+    return latencies, stopped
+
+
+def report(label, latencies, stopped):
+    print label
+    for kind in ("corpus", "hostile"):
+        samples = sorted(latencies[kind])
+        print "  %-8s %8d parses  p50 %12.0f  p99 %12.0f  p99.9 %12.0f  max %12.0f ns" % (
+            kind, len(samples), percentile(samples, 50), percentile(samples, 99), percentile(samples, 99.9),
+            samples[-1])
+    if stopped:
+        print "  stopped: %s" % ", ".join("%s %d" % item for item in sorted(stopped.items()))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="cx509 parse latency with decode budgets")
+    parser.add_argument("-n", "--iterations", type=int, default=20, help="passes over the input mix")
+    parser.add_argument("--max-size", type=int, default=64 << 10, help="max_size budget in bytes")
+    parser.add_argument("--max-depth", type=int, default=32, help="max_depth budget")
+    parser.add_argument("--max-elements", type=int, default=20000, help="max_elements budget")
+    parser.add_argument("--max-ns", type=int, default=5000000, help="max_ns budget")
+    parser.add_argument("--seed", type=int, default=1, help="synthetic corpus seed")
+    args = parser.parse_args()
+
+    inputs = [("corpus", profile, der) for profile, der in corpus.generate(args.seed)]
+    inputs += [("hostile", name, data) for name, data in hostile(args.seed)]
+    for kind, name, data in inputs:
+        print "%-8s %-20s %10d bytes" % (kind, name, len(data))
+
+    report("no budgets", *run(inputs, args.iterations, {}))
+    limits = {"max_size": args.max_size, "max_depth": args.max_depth, "max_elements": args.max_elements,
+              "max_ns": args.max_ns}
+    report("budgets %s" % ", ".join("%s=%d" % item for item in sorted(limits.items())),
+           *run(inputs, args.iterations, limits))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,76 @@
+#!/usr/bin/python
+"""
+cx509.extract_columns() against per-object getters.
+
+Repeats the given DER certificates up to N rows and gathers validity, key length, algorithms and
+version for every row, first the usual way (parse each certificate, call the getters, build a
+dict per row) and then with one extract_columns() call, from both DER buffers and already-parsed
+cx509 objects. If NumPy is installed, also times wrapping the columns with numpy.frombuffer().
+
+usage: python bench/columns.py [-n ROWS] [-t THREADS] cert.der [cert.der ...]
+"""
+import os
+import sys
+import time
+import argparse
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+import cx509
+
+FIELDS = ["not_before", "not_after", "keylen", "key_algorithm", "signature_algorithm", "version"]
+
+
+def getters(certs):
+    rows = []
+    for der in certs:
+        cert = cx509.cx509(der)
+        not_before, not_after = cert.get_validity()
+        rows.append({
+            "not_before": not_before,
+            "not_after": not_after,
+            "public_key": cert.get_public_key(),
+            "signature_algorithm": cert.get_signature_algorithm(),
+            "version": cert.get_version(),
+        })
+    return rows
+
+
+def main():
+    parser = argparse.ArgumentParser(description="cx509.extract_columns speed")
+    parser.add_argument("-n", "--rows", type=int, default=200000, help="certificates to extract")
+    parser.add_argument("-t", "--threads", type=int, default=0, help="extract_columns() threads (default: number of CPUs)")
+    parser.add_argument("certs", nargs="+", help="DER-encoded certificate files")
+    args = parser.parse_args()
+
+    ders = [open(path, "rb").read() for path in args.certs]
+    certs = (ders * (args.rows // len(ders) + 1))[:args.rows]
+
+    start = time.time()
+    getters(certs)
+    elapsed = time.time() - start
+    print "getters + dicts:         %8.2f us/cert" % (elapsed / len(certs) * 1e6)
+
+    start = time.time()
+    columns = cx509.extract_columns(certs, fields=FIELDS, threads=args.threads)
+    elapsed = time.time() - start
+    print "extract_columns(DER):    %8.2f us/cert" % (elapsed / len(certs) * 1e6)
+
+    objects = [cx509.cx509(der) for der in certs]
+    start = time.time()
+    cx509.extract_columns(objects, fields=FIELDS, threads=args.threads)
+    elapsed = time.time() - start
+    print "extract_columns(cx509):  %8.2f us/cert" % (elapsed / len(certs) * 1e6)
+
+    try:
+        import numpy
+    except ImportError:
+        return
+    start = time.time()
+    arrays = dict((f, numpy.frombuffer(columns[f], dtype=columns[f].format)) for f in FIELDS)
+    elapsed = time.time() - start
+    print "numpy.frombuffer():      %8.2f us total  (%d rows, not_after max %d)" % (
+        elapsed * 1e6, len(arrays["not_after"]), arrays["not_after"].max())
+
+
+if __name__ == "__main__":
+    main()
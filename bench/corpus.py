@@ -0,0 +1,235 @@
+#!/usr/bin/python
+"""
+Deterministic synthetic certificate corpus for the benchmark suite.
+
+Builds one certificate per profile: RSA and EC keys, subject and issuer names of varying depth,
+1 to 1000 dNSName subjectAltNames, the usual set of extensions (and many more for one profile),
+and DER as well as BER encodings with long-form and indefinite lengths. Keys, serials and
+signatures are random bytes of the right shape; nothing here is cryptographically valid, but
+every certificate decodes as an RFC 5280 Certificate. The same seed always gives the same bytes.
+
+usage: python bench/corpus.py [--seed SEED] [--list] [OUTDIR]
+"""
+import os
+import sys
+import random
+import hashlib
+import argparse
+
+# profile name -> build() keyword arguments; see DEFAULTS
+PROFILES = [
+    ("rsa2048", {}),
+    ("rsa4096", {"key": "rsa4096"}),
+    ("ec-p256", {"key": "ec-p256"}),
+    ("ec-p384", {"key": "ec-p384"}),
+    ("name-depth-1", {"depth": 1}),
+    ("name-depth-8", {"depth": 8}),
+    ("name-depth-32", {"depth": 32}),
+    ("san-1", {"sans": 1}),
+    ("san-10", {"sans": 10}),
+    ("san-100", {"sans": 100}),
+    ("san-1000", {"sans": 1000}),
+    ("extensions-many", {"private_extensions": 32}),
+    ("generalized-time", {"not_after": "20520101000000Z"}),
+    ("ber-long-lengths", {"encoding": "ber-long"}),
+    ("ber-indefinite", {"encoding": "ber-indefinite"}),
+]
+
+DEFAULTS = {
+    "key": "rsa2048",
+    "depth": 4,
+    "sans": 3,
+    "private_extensions": 0,
+    "not_after": "270101000000Z",
+    "encoding": "der",
+}
+
+KEYS = {
+    # name -> (key algorithm OID, parameters OID or None for NULL, size in bits)
+    "rsa2048": ("1.2.840.113549.1.1.1", None, 2048),
+    "rsa4096": ("1.2.840.113549.1.1.1", None, 4096),
+    "ec-p256": ("1.2.840.10045.2.1", "1.2.840.10045.3.1.7", 256),
+    "ec-p384": ("1.2.840.10045.2.1", "1.3.132.0.34", 384),
+}
+
+# name attributes, cycled through from the top of the name down; the last RDN is always a commonName
+ATTRIBUTES = [
+    ("2.5.4.6", 0x13, lambda i: "US"),
+    ("2.5.4.8", 0x0c, lambda i: "Massachusetts"),
+    ("2.5.4.7", 0x0c, lambda i: "Cambridge"),
+    ("2.5.4.10", 0x0c, lambda i: "Example Widgets, Inc."),
+    ("2.5.4.11", 0x0c, lambda i: "Unit %d" % i),
+    ("0.9.2342.19200300.100.1.25", 0x16, lambda i: "dc%d" % i),
+]
+
+
+class Encoder(object):
+    """DER, or BER with every length in 4-byte long form or every constructed length indefinite."""
+
+    def __init__(self, encoding):
+        self.encoding = encoding
+
+    def tlv(self, tag, body):
+        n = len(body)
+        if self.encoding == "ber-indefinite" and tag & 0x20:
+            return chr(tag) + "\x80" + body + "\x00\x00"
+        if self.encoding == "ber-long":
+            return chr(tag) + "\x84" + "".join(chr((n >> shift) & 0xff) for shift in (24, 16, 8, 0)) + body
+        if n < 0x80:
+            return chr(tag) + chr(n) + body
+        length = ""
+        while n:
+            length = chr(n & 0xff) + length
+            n >>= 8
+        return chr(tag) + chr(0x80 | len(length)) + length + body
+
+    def seq(self, *items):
+        return self.tlv(0x30, "".join(items))
+
+    def oid(self, dotted):
+        arcs = [int(a) for a in dotted.split(".")]
+        body = chr(40 * arcs[0] + arcs[1])
+        for arc in arcs[2:]:
+            octets = chr(arc & 0x7f)
+            arc >>= 7
+            while arc:
+                octets = chr(0x80 | (arc & 0x7f)) + octets
+                arc >>= 7
+            body += octets
+        return self.tlv(0x06, body)
+
+    def integer(self, value):
+        """An INTEGER from a non-negative int or a big-endian byte string."""
+        if isinstance(value, str):
+            body = value.lstrip("\x00")
+        else:
+            body = ""
+            while value:
+                body = chr(value & 0xff) + body
+                value >>= 8
+        if not body or ord(body[0]) & 0x80:
+            body = "\x00" + body
+        return self.tlv(0x02, body)
+
+    def bit_string(self, body):
+        return self.tlv(0x03, "\x00" + body)
+
+    def octet_string(self, body):
+        return self.tlv(0x04, body)
+
+
+def random_bytes(rng, n):
+    return "".join(chr(rng.getrandbits(8)) for i in xrange(n))
+
+
+def name(enc, depth, cn):
+    rdns = []
+    for i in xrange(depth - 1):
+        oid, tag, value = ATTRIBUTES[i % len(ATTRIBUTES)]
+        rdns.append(enc.tlv(0x31, enc.seq(enc.oid(oid), enc.tlv(tag, value(i)))))
+    rdns.append(enc.tlv(0x31, enc.seq(enc.oid("2.5.4.3"), enc.tlv(0x0c, cn))))
+    return enc.seq(*rdns)
+
+
+def time_value(enc, t):
+    return enc.tlv(0x18 if len(t) == 15 else 0x17, t)
+
+
+def extension(enc, oid, value, critical=False):
+    return enc.seq(enc.oid(oid), enc.tlv(0x01, "\xff") if critical else "", enc.octet_string(value))
+
+
+def extensions(enc, rng, key_id, issuer_key_id, hostnames, private):
+    uri = lambda path: enc.tlv(0x86, "http://pki.example.com/" + path)
+    exts = [
+        extension(enc, "2.5.29.19", enc.seq(), True),
+        extension(enc, "2.5.29.15", enc.tlv(0x03, "\x05\xa0"), True),
+        extension(enc, "2.5.29.37", enc.seq(enc.oid("1.3.6.1.5.5.7.3.1"), enc.oid("1.3.6.1.5.5.7.3.2"))),
+        extension(enc, "2.5.29.14", enc.octet_string(key_id)),
+        extension(enc, "2.5.29.35", enc.seq(enc.tlv(0x80, issuer_key_id))),
+        extension(enc, "2.5.29.17", enc.seq(*[enc.tlv(0x82, h) for h in hostnames])),
+        extension(enc, "2.5.29.31", enc.seq(enc.seq(enc.tlv(0xa0, enc.tlv(0xa0, uri("ca.crl")))))),
+        extension(enc, "1.3.6.1.5.5.7.1.1", enc.seq(enc.seq(enc.oid("1.3.6.1.5.5.7.48.1"), uri("ocsp")),
+                                                    enc.seq(enc.oid("1.3.6.1.5.5.7.48.2"), uri("ca.der")))),
+        extension(enc, "2.5.29.32", enc.seq(
+            enc.seq(enc.oid("2.23.140.1.2.2")),
+            enc.seq(enc.oid("1.3.6.1.4.1.99999.1.1"),
+                    enc.seq(enc.seq(enc.oid("1.3.6.1.5.5.7.2.1"), enc.tlv(0x16, "http://pki.example.com/cps")))))),
+        extension(enc, "1.3.6.1.4.1.11129.2.4.2", enc.octet_string(random_bytes(rng, 240))),
+    ]
+    for i in xrange(private):
+        exts.append(extension(enc, "1.3.6.1.4.1.99999.2.%d" % i, enc.octet_string(random_bytes(rng, 16 + i))))
+    return enc.tlv(0xa3, enc.seq(*exts))
+
+
+def build(index, seed, key, depth, sans, private_extensions, not_after, encoding):
+    """The certificate for the index'th profile, with the given settings."""
+    rng = random.Random(seed * 1000003 + index)
+    enc = Encoder(encoding)
+    algorithm, parameters, bits = KEYS[key]
+    size = bits // 8
+
+    if parameters is None:
+        signature_algorithm = enc.seq(enc.oid("1.2.840.113549.1.1.11"), enc.tlv(0x05, ""))
+        modulus = chr(0x80 | rng.getrandbits(7)) + random_bytes(rng, size - 1)
+        spki = enc.seq(enc.seq(enc.oid(algorithm), enc.tlv(0x05, "")),
+                       enc.bit_string(enc.seq(enc.integer(modulus), enc.integer(65537))))
+        signature = random_bytes(rng, size)
+    else:
+        signature_algorithm = enc.seq(enc.oid("1.2.840.10045.4.3.2" if bits == 256 else "1.2.840.10045.4.3.3"))
+        spki = enc.seq(enc.seq(enc.oid(algorithm), enc.oid(parameters)),
+                       enc.bit_string("\x04" + random_bytes(rng, 2 * size)))
+        signature = enc.seq(enc.integer(random_bytes(rng, size)), enc.integer(random_bytes(rng, size)))
+
+    hostnames = ["host%d.service%d.example.com" % (i, i % 7) for i in xrange(sans)]
+    tbs = enc.seq(
+        enc.tlv(0xa0, enc.integer(2)),
+        enc.integer(chr(rng.getrandbits(7)) + random_bytes(rng, 15)),
+        signature_algorithm,
+        name(enc, depth, "Example Issuing CA %d" % index),
+        enc.seq(time_value(enc, "260101000000Z"), time_value(enc, not_after)),
+        name(enc, depth, hostnames[0]),
+        spki,
+        extensions(enc, rng, random_bytes(rng, 20), random_bytes(rng, 20), hostnames, private_extensions))
+    return enc.seq(tbs, signature_algorithm, enc.bit_string(signature))
+
+
+def generate(seed=1):
+    """Return a list of (profile name, certificate) pairs."""
+    corpus = []
+    for index, (profile, settings) in enumerate(PROFILES):
+        kw = dict(DEFAULTS)
+        kw.update(settings)
+        corpus.append((profile, build(index, seed, **kw)))
+    return corpus
+
+
+def digest(corpus):
+    """A SHA-256 over the whole corpus, to tell whether two runs measured the same input."""
+    h = hashlib.sha256()
+    for profile, der in corpus:
+        h.update("%s:%d:" % (profile, len(der)))
+        h.update(der)
+    return h.hexdigest()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="generate the synthetic certificate corpus")
+    parser.add_argument("--seed", type=int, default=1, help="random seed")
+    parser.add_argument("--list", action="store_true", help="list profiles, sizes and digests only")
+    parser.add_argument("outdir", nargs="?", help="directory to write PROFILE.der files into")
+    args = parser.parse_args()
+
+    corpus = generate(args.seed)
+    for profile, der in corpus:
+        print "%-20s %7d bytes  %s" % (profile, len(der), hashlib.sha256(der).hexdigest()[:16])
+        if args.outdir and not args.list:
+            if not os.path.isdir(args.outdir):
+                os.makedirs(args.outdir)
+            with open(os.path.join(args.outdir, profile + ".der"), "wb") as f:
+                f.write(der)
+    print "corpus digest %s" % digest(corpus)
+
+
+if __name__ == "__main__":
+    main()
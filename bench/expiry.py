@@ -0,0 +1,68 @@
+#!/usr/bin/python
+"""
+Expiry sweep speed: get_validity() with strptime vs. get_validity_epoch() vs. cx509.expiring().
+
+Repeats the given DER certificates up to N items and finds the ones whose notAfter falls within
+the next D days, first by parsing the get_validity() strings in Python, then with the cached
+epochs from get_validity_epoch(), then with expiring() over the cx509 objects and over the raw
+DER buffers (which it scans without decoding).
+
+usage: python bench/expiry.py [-n ITEMS] [-d DAYS] [-t THREADS] cert.der [cert.der ...]
+"""
+import os
+import sys
+import time
+import calendar
+import argparse
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+import cx509
+
+
+def strptime_sweep(certs, before, after):
+    found = []
+    for i, cert in enumerate(certs):
+        not_after = cert.get_validity()[1]
+        if not_after is None:
+            continue
+        t = calendar.timegm(time.strptime(not_after[:14], "%Y%m%d%H%M%S"))
+        if after <= t < before:
+            found.append(i)
+    return found
+
+
+def epoch_sweep(certs, before, after):
+    found = []
+    for i, cert in enumerate(certs):
+        t = cert.get_validity_epoch()[1]
+        if t is not None and after <= t < before:
+            found.append(i)
+    return found
+
+
+def main():
+    parser = argparse.ArgumentParser(description="cx509 expiry sweep speed")
+    parser.add_argument("-n", "--items", type=int, default=1000000, help="certificates to sweep")
+    parser.add_argument("-d", "--days", type=int, default=30, help="window size in days from now")
+    parser.add_argument("-t", "--threads", type=int, default=0, help="expiring() threads (default: number of CPUs)")
+    parser.add_argument("certs", nargs="+", help="DER-encoded certificate files")
+    args = parser.parse_args()
+
+    ders = [open(path, "rb").read() for path in args.certs]
+    ders = (ders * (args.items // len(ders) + 1))[:args.items]
+    certs = [cx509.cx509(der) for der in ders]
+    after = int(time.time())
+    before = after + args.days * 86400
+
+    for label, fn in [("get_validity + strptime", lambda: strptime_sweep(certs, before, after)),
+                      ("get_validity_epoch", lambda: epoch_sweep(certs, before, after)),
+                      ("expiring(cx509)", lambda: cx509.expiring(certs, before, after, args.threads)),
+                      ("expiring(DER)", lambda: cx509.expiring(ders, before, after, args.threads))]:
+        start = time.time()
+        found = fn()
+        elapsed = time.time() - start
+        print "%-24s %8.3f us/cert  (%d expiring)" % (label, elapsed / len(ders) * 1e6, len(found))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,167 @@
+#!/usr/bin/python
+"""
+cx509.HostnameIndex build and lookup speed.
+
+Builds a set of synthetic certificates, each with a few dNSName subjectAltNames (and every tenth
+with a wildcard), indexes them, then times match() and match_many() over a stream of hostnames
+that mixes exact hits, wildcard hits and misses. For comparison, it also times a linear scan over
+the certificates' extensions() in Python for a small sample of the hostnames.
+
+usage: python bench/hostnames.py [-n CERTS] [-l LOOKUPS] [--baseline SAMPLE] [--batch SIZE]
+"""
+import os
+import sys
+import time
+import random
+import argparse
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+import cx509
+
+
+def tlv(tag, body):
+    n = len(body)
+    if n < 0x80:
+        length = chr(n)
+    else:
+        length = ""
+        while n:
+            length = chr(n & 0xff) + length
+            n >>= 8
+        length = chr(0x80 | len(length)) + length
+    return chr(tag) + length + body
+
+
+def seq(*items):
+    return tlv(0x30, "".join(items))
+
+
+def oid(dotted):
+    arcs = [int(a) for a in dotted.split(".")]
+    body = chr(40 * arcs[0] + arcs[1])
+    for arc in arcs[2:]:
+        octets = chr(arc & 0x7f)
+        arc >>= 7
+        while arc:
+            octets = chr(0x80 | (arc & 0x7f)) + octets
+            arc >>= 7
+        body += octets
+    return tlv(0x06, body)
+
+
+def integer(n):
+    body = ""
+    while n:
+        body = chr(n & 0xff) + body
+        n >>= 8
+    if not body or ord(body[0]) & 0x80:
+        body = "\x00" + body
+    return tlv(0x02, body)
+
+
+def name(cn):
+    return seq(tlv(0x31, seq(oid("2.5.4.3"), tlv(0x0c, cn))))
+
+
+SHA256_WITH_RSA = seq(oid("1.2.840.113549.1.1.11"), "\x05\x00")
+SPKI = seq(seq(oid("1.2.840.113549.1.1.1"), "\x05\x00"),
+           tlv(0x03, "\x00" + seq(integer(int("c5" * 128, 16)), integer(65537))))
+VALIDITY = seq(tlv(0x17, "260101000000Z"), tlv(0x17, "270101000000Z"))
+
+
+def make_certificate(serial, sans):
+    """A DER certificate (with a dummy signature) for the given dNSNames."""
+    san = seq(*[tlv(0x82, s) for s in sans])
+    extensions = tlv(0xa3, seq(seq(oid("2.5.29.17"), tlv(0x04, san))))
+    tbs = seq(tlv(0xa0, integer(2)), integer(serial), SHA256_WITH_RSA, name("Bench CA"), VALIDITY,
+              name(sans[0]), SPKI, extensions)
+    return seq(tbs, SHA256_WITH_RSA, tlv(0x03, "\x00" + "\x5a" * 256))
+
+
+def names_for(i):
+    zone = "zone%d.example%d.com" % (i % 1000, i % 10)
+    names = ["host%d.%s" % (i, zone), "www.host%d.%s" % (i, zone), "api%d.%s" % (i, zone)]
+    if i % 10 == 0:
+        names.append("*." + zone)
+    return names
+
+
+def hostnames(count, ncerts):
+    """A reproducible stream of hostnames: about 60% exact hits, 20% wildcard hits, 20% misses."""
+    rng = random.Random(1)
+    out = []
+    for _ in xrange(count):
+        i = rng.randrange(ncerts)
+        r = rng.random()
+        if r < 0.6:
+            out.append(rng.choice(names_for(i)))
+        elif r < 0.8:
+            j = i - i % 10  # has a wildcard
+            out.append("x%d.zone%d.example%d.com" % (i, j % 1000, j % 10))
+        else:
+            out.append("host%d.nowhere.example.net" % i)
+    return out
+
+
+def python_match(certs, hostname):
+    """The linear scan HostnameIndex replaces."""
+    hostname = hostname.lower()
+    found = []
+    for cert, names in certs:
+        for n in names:
+            if n == hostname or (n.startswith("*.") and "." in hostname and
+                                 hostname.split(".", 1)[1] == n[2:]):
+                found.append(cert)
+                break
+    return found
+
+
+def main():
+    parser = argparse.ArgumentParser(description="cx509.HostnameIndex speed")
+    parser.add_argument("-n", "--certs", type=int, default=100000, help="certificates to index")
+    parser.add_argument("-l", "--lookups", type=int, default=1000000, help="hostnames to look up")
+    parser.add_argument("--baseline", type=int, default=100, help="hostnames to look up with the Python scan")
+    parser.add_argument("--batch", type=int, default=10000, help="hostnames per match_many() call")
+    args = parser.parse_args()
+
+    start = time.time()
+    certs = [cx509.cx509(make_certificate(i + 1, names_for(i))) for i in xrange(args.certs)]
+    print "%d certificates generated and parsed in %.2fs" % (len(certs), time.time() - start)
+
+    start = time.time()
+    index = cx509.HostnameIndex(certs)
+    print "index built in %.2fs" % (time.time() - start)
+
+    queries = hostnames(args.lookups, args.certs)
+
+    start = time.time()
+    hits = 0
+    for h in queries:
+        if index.match(h):
+            hits += 1
+    elapsed = time.time() - start
+    print "match():      %8.2f us/lookup  (%d of %d matched)" % (elapsed / len(queries) * 1e6, hits, len(queries))
+
+    start = time.time()
+    for i in xrange(0, len(queries), args.batch):
+        index.match_many(queries[i:i + args.batch])
+    elapsed = time.time() - start
+    print "match_many(): %8.2f us/lookup" % (elapsed / len(queries) * 1e6)
+
+    if args.baseline:
+        scan = []
+        for cert in certs:
+            names = set()
+            for ext in cert.extensions():
+                names.update(ext.get("dNSName", ()))
+            scan.append((cert, names))
+        sample = queries[:args.baseline]
+        start = time.time()
+        for h in sample:
+            python_match(scan, h)
+        elapsed = time.time() - start
+        print "Python scan:  %8.2f us/lookup  (%d lookups)" % (elapsed / len(sample) * 1e6, len(sample))
+
+
+if __name__ == "__main__":
+    main()
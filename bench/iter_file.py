@@ -0,0 +1,48 @@
+#!/usr/bin/python
+"""
+cx509.iter_file() throughput.
+
+Streams every certificate out of one or more bundle files (concatenated DER, or PEM with
+--format pem) and reports certificates/second and MB/second of input for each file.
+
+usage: python bench/iter_file.py [--format der|pem] [--zero-copy] [-n PASSES] bundle [bundle ...]
+"""
+import os
+import sys
+import time
+import argparse
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+import cx509
+
+
+def main():
+    parser = argparse.ArgumentParser(description="cx509.iter_file throughput")
+    parser.add_argument("--format", default="der", choices=["der", "pem"], help="bundle format")
+    parser.add_argument("--zero-copy", action="store_true", help="keep certificates as views on the mapping")
+    parser.add_argument("-n", "--passes", type=int, default=3, help="passes over each file; the best is reported")
+    parser.add_argument("bundles", nargs="+", help="bundle files")
+    args = parser.parse_args()
+
+    print "%-40s %10s %8s %14s %10s" % ("file", "certs", "errors", "certs/sec", "MB/sec")
+    for path in args.bundles:
+        size = os.path.getsize(path)
+        best = None
+        for i in xrange(args.passes):
+            certs = errors = 0
+            start = time.time()
+            for cert in cx509.iter_file(path, format=args.format, zero_copy=args.zero_copy):
+                if isinstance(cert, Exception):
+                    errors += 1
+                else:
+                    certs += 1
+            elapsed = time.time() - start
+            if best is None or elapsed < best:
+                best = elapsed
+        best = max(best, 1e-9)
+        print "%-40s %10d %8d %14.0f %10.1f" % (os.path.basename(path)[-40:], certs, errors,
+                                                (certs + errors) / best, size / best / 1e6)
+
+
+if __name__ == "__main__":
+    main()
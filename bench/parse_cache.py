@@ -0,0 +1,73 @@
+#!/usr/bin/python
+"""
+ParseCache against plain cx509() parsing.
+
+Draws N certificates from the given DER files with a skewed (Zipf-like) distribution, the way the
+same few certificates dominate a TLS handshake log, and parses each with cx509() and then through a
+ParseCache of the given size, reporting certificates per second and the cache's hit rate.
+
+usage: python bench/parse_cache.py [-n ITEMS] [-e MAX_ENTRIES] [-b MAX_BYTES] [-s SKEW] cert.der [cert.der ...]
+"""
+import os
+import sys
+import time
+import random
+import argparse
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+import cx509
+
+
+def workload(ders, items, skew):
+    """items DER buffers drawn from ders, the i'th with weight 1 / (i + 1) ** skew."""
+    weights = [1.0 / (i + 1) ** skew for i in xrange(len(ders))]
+    total = sum(weights)
+    cumulative, acc = [], 0.0
+    for w in weights:
+        acc += w / total
+        cumulative.append(acc)
+    rng = random.Random(1)
+    picks = []
+    for i in xrange(items):
+        r = rng.random()
+        lo, hi = 0, len(cumulative) - 1
+        while lo < hi:
+            mid = (lo + hi) // 2
+            if cumulative[mid] < r:
+                lo = mid + 1
+            else:
+                hi = mid
+        picks.append(ders[lo])
+    return picks
+
+
+def main():
+    parser = argparse.ArgumentParser(description="cx509.ParseCache speed")
+    parser.add_argument("-n", "--items", type=int, default=200000, help="certificates to parse")
+    parser.add_argument("-e", "--max-entries", type=int, default=1024, help="cache entries")
+    parser.add_argument("-b", "--max-bytes", type=int, default=0, help="cache size in bytes (0 for no limit)")
+    parser.add_argument("-s", "--skew", type=float, default=1.0, help="Zipf exponent of the workload")
+    parser.add_argument("certs", nargs="+", help="DER-encoded certificate files")
+    args = parser.parse_args()
+
+    ders = [open(path, "rb").read() for path in args.certs]
+    picks = workload(ders, args.items, args.skew)
+
+    start = time.time()
+    for der in picks:
+        cx509.cx509(der).get_subject()
+    plain = args.items / max(time.time() - start, 1e-9)
+    print "cx509():           %10.0f certs/sec" % plain
+
+    cache = cx509.ParseCache(args.max_entries, args.max_bytes)
+    start = time.time()
+    for der in picks:
+        cache.parse(der).get_subject()
+    cached = args.items / max(time.time() - start, 1e-9)
+    print "ParseCache.parse(): %10.0f certs/sec  (%.2fx; %.1f%% hits, %d evictions, %d entries, %d bytes)" % (
+        cached, cached / plain, 100.0 * cache.hits / max(cache.hits + cache.misses, 1), cache.evictions,
+        len(cache), cache.bytes)
+
+
+if __name__ == "__main__":
+    main()
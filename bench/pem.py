@@ -0,0 +1,57 @@
+#!/usr/bin/python
+"""
+Native PEM decoding vs. the pure Python route.
+
+For each PEM certificate file, compares cx509._pem_decode() against stripping the armor and calling
+base64.b64decode(), and cx509.cx509(pem, format="pem") against cx509.cx509(base64.b64decode(...)).
+Reports certificates/second for each and the base64 kernel selected at import time.
+
+usage: python bench/pem.py [-n ITERATIONS] cert.pem [cert.pem ...]
+"""
+import os
+import sys
+import time
+import base64
+import argparse
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+import cx509
+
+
+def python_pem_decode(pem):
+    begin = pem.index("-----BEGIN CERTIFICATE-----") + len("-----BEGIN CERTIFICATE-----")
+    end = pem.index("-----END CERTIFICATE-----", begin)
+    return base64.b64decode("".join(pem[begin:end].split()))
+
+
+def rate(fn, arg, iterations):
+    start = time.time()
+    for i in xrange(iterations):
+        fn(arg)
+    return iterations / max(time.time() - start, 1e-9)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="native vs. Python PEM decoding")
+    parser.add_argument("-n", "--iterations", type=int, default=20000, help="decodes per measurement")
+    parser.add_argument("files", nargs="+", help="PEM certificate files")
+    args = parser.parse_args()
+
+    print "base64 kernel: %s" % cx509._base64_kernel
+    print "%-30s %14s %14s %8s %14s %14s %8s" % ("file", "b64decode/s", "_pem_decode/s", "x",
+                                                  "parse(b64)/s", "parse(pem)/s", "x")
+    for path in args.files:
+        pem = open(path).read()
+        assert cx509._pem_decode(pem) == python_pem_decode(pem)
+
+        python = rate(python_pem_decode, pem, args.iterations)
+        native = rate(lambda data: cx509._pem_decode(data), pem, args.iterations)
+        python_parse = rate(lambda data: cx509.cx509(python_pem_decode(data)), pem, args.iterations)
+        native_parse = rate(lambda data: cx509.cx509(data, format="pem"), pem, args.iterations)
+        print "%-30s %14.0f %14.0f %8.2f %14.0f %14.0f %8.2f" % (os.path.basename(path)[-30:], python, native,
+                                                                 native / python, python_parse, native_parse,
+                                                                 native_parse / python_parse)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,75 @@
+#!/usr/bin/python
+"""
+Projected vs. full parse throughput.
+
+Parses the given DER certificates over and over, in full and with each of the common fields=
+projections, and reports certificates per second for each: for the parse alone, and for the parse
+followed by the getters the projection is meant to serve, against a full parse followed by the same
+getters.
+
+usage: python bench/projection.py [-n ITERATIONS] cert.der [cert.der ...]
+"""
+import os
+import sys
+import time
+import argparse
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+import cx509
+
+PROJECTIONS = [
+    ("subject", "validity", "san"),
+    ("validity",),
+    ("subject",),
+    ("subject", "issuer"),
+    ("public_key",),
+]
+
+
+def use(cert, fields):
+    """Call the getters that need the projected fields."""
+    if "subject" in fields:
+        cert.get_subject()
+    if "issuer" in fields:
+        cert.get_issuer()
+    if "validity" in fields:
+        cert.get_validity_epoch()
+    if "san" in fields:
+        cert.extensions()
+    if "public_key" in fields:
+        cert.get_public_key()
+
+
+def rate(certs, fields, iterations, getters):
+    """Certificates per second parsed with fields= (or in full if None), using the getters for getters."""
+    kw = {} if fields is None else {"fields": fields}
+    start = time.time()
+    for i in xrange(iterations):
+        for der in certs:
+            cert = cx509.cx509(der, **kw)
+            if getters:
+                use(cert, getters)
+    return iterations * len(certs) / max(time.time() - start, 1e-9)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="cx509 projected parse throughput")
+    parser.add_argument("-n", "--iterations", type=int, default=2000, help="passes over the input")
+    parser.add_argument("certs", nargs="+", help="DER-encoded certificate files")
+    args = parser.parse_args()
+
+    certs = [open(path, "rb").read() for path in args.certs]
+    full = rate(certs, None, args.iterations, ())
+    print "full parse: %.0f certs/sec" % full
+    print "%-28s %14s %8s %16s %16s %8s" % ("fields", "parse/sec", "speedup", "full+getters/sec",
+                                            "proj+getters/sec", "speedup")
+    for fields in PROJECTIONS:
+        parse = rate(certs, fields, args.iterations, ())
+        full_getters = rate(certs, None, args.iterations, fields)
+        getters = rate(certs, fields, args.iterations, fields)
+        print "%-28s %14.0f %8.2f %16.0f %16.0f %8.2f" % (",".join(fields), parse, parse / full, full_getters,
+                                                          getters, getters / full_getters)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,206 @@
+#!/usr/bin/python
+"""
+Benchmark suite: per-operation time, allocations and peak memory over the synthetic corpus.
+
+For each certificate profile from bench/corpus.py (or each DER file given with --corpus) and each
+operation, runs the operation in a fresh process until the timing is stable and records ns/op
+(best of --repeat runs), C library and arena allocations per op (from cx509._alloc_stats()) and
+the process's peak RSS. Writes the results as JSON (to stdout, or to --output) so that runs on
+different commits can be compared; --compare OLD.json prints the ratio of each result to OLD's.
+
+usage: python bench/suite.py [-o OUT.json] [--compare OLD.json] [--corpus DIR] [--seed SEED]
+                             [-p PROFILE ...] [--op OP ...] [-t MIN_TIME] [-r REPEAT]
+"""
+import os
+import sys
+import gc
+import json
+import time
+import hashlib
+import timeit
+import platform
+import argparse
+import resource
+import subprocess
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+import cx509
+import corpus as corpus_module
+
+# name -> f(cert, der); cert is a cx509 object already parsed from der
+OPERATIONS = [
+    ("_parse", lambda cert, der: cert._parse(der)),
+    ("get_subject", lambda cert, der: cert.get_subject()),
+    ("get_issuer", lambda cert, der: cert.get_issuer()),
+    ("extensions", lambda cert, der: cert.extensions()),
+    ("get_public_key", lambda cert, der: cert.get_public_key()),
+    # the getters above return their cached result after the first call; this one decodes the key every time
+    ("_parse+get_public_key", lambda cert, der: (cert._parse(der), cert.get_public_key())),
+    ("get_serial_number", lambda cert, der: cert.get_serial_number()),
+    ("get_tbs_certificate_data", lambda cert, der: cert.get_tbs_certificate_data()),
+    ("__str__", lambda cert, der: str(cert)),
+]
+
+
+def load(args):
+    """The (profile, DER) pairs to measure."""
+    if args.corpus:
+        names = sorted(f for f in os.listdir(args.corpus) if f.endswith(".der"))
+        certs = [(f[:-4], open(os.path.join(args.corpus, f), "rb").read()) for f in names]
+    else:
+        certs = corpus_module.generate(args.seed)
+    if args.profile:
+        certs = [(p, der) for p, der in certs if p in args.profile]
+    return certs
+
+
+def peak_rss_kb():
+    peak = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    return peak // 1024 if sys.platform == "darwin" else peak  # bytes on OS X, KB elsewhere
+
+
+def measure(op, der, min_time, repeat):
+    """Time op on a certificate parsed from der; return the result dict for one (profile, op)."""
+    fn = dict(OPERATIONS)[op]
+    cert = cx509.cx509(der)
+    fn(cert, der)  # warm up (and fail early)
+
+    # find a loop count that takes at least min_time
+    loops = 1
+    while True:
+        start = timeit.default_timer()
+        for i in xrange(loops):
+            fn(cert, der)
+        elapsed = timeit.default_timer() - start
+        if elapsed >= min_time or loops >= 1 << 30:
+            break
+        loops *= 2 if elapsed <= 0 else max(2, min(10, int(min_time / elapsed * 1.2) + 1))
+
+    gc.collect()
+    gc.disable()
+    best = None
+    before = cx509._alloc_stats()
+    for r in xrange(repeat):
+        start = timeit.default_timer()
+        for i in xrange(loops):
+            fn(cert, der)
+        elapsed = timeit.default_timer() - start
+        best = elapsed if best is None else min(best, elapsed)
+    after = cx509._alloc_stats()
+    gc.enable()
+
+    n = float(loops * repeat)
+    return {
+        "ns_per_op": best / loops * 1e9,
+        "loops": loops,
+        "malloc_per_op": (after["malloc"] - before["malloc"]) / n,
+        "free_per_op": (after["free"] - before["free"]) / n,
+        "arena_per_op": (after["arena"] - before["arena"]) / n,
+        "peak_rss_kb": peak_rss_kb(),
+    }
+
+
+def child(args):
+    der = dict(load(args))[args.child[0]]
+    try:
+        result = measure(args.child[1], der, args.min_time, args.repeat)
+    except Exception, e:
+        result = {"error": "%s: %s" % (type(e).__name__, e)}
+    print json.dumps(result)
+
+
+def git_commit():
+    try:
+        return subprocess.Popen(["git", "rev-parse", "HEAD"], stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                                cwd=os.path.dirname(os.path.abspath(__file__))).communicate()[0].strip() or None
+    except OSError:
+        return None
+
+
+def run(args):
+    certs = load(args)
+    if not certs:
+        sys.exit("no certificates to measure")
+    ops = [op for op, fn in OPERATIONS if not args.op or op in args.op]
+
+    passthrough = ["-t", str(args.min_time), "-r", str(args.repeat), "--seed", str(args.seed)]
+    if args.corpus:
+        passthrough += ["--corpus", args.corpus]
+    results = []
+    for profile, der in certs:
+        for op in ops:
+            out = subprocess.Popen([sys.executable, os.path.abspath(__file__), "--child", profile, op] + passthrough,
+                                   stdout=subprocess.PIPE).communicate()[0]
+            try:
+                result = json.loads(out)
+            except ValueError:
+                result = {"error": "benchmark process failed"}
+            result.update({"profile": profile, "op": op, "bytes": len(der), "sha256": hashlib.sha256(der).hexdigest()})
+            results.append(result)
+            sys.stderr.write("%-20s %-26s %s\n" % (profile, op, result["error"] if "error" in result else
+                                                  "%12.0f ns/op" % result["ns_per_op"]))
+
+    return {
+        "meta": {
+            "commit": git_commit(),
+            "time": time.strftime("%Y-%m-%dT%H:%M:%SZ", time.gmtime()),
+            "python": platform.python_version(),
+            "platform": platform.platform(),
+            "machine": platform.machine(),
+            "base64_kernel": getattr(cx509, "_base64_kernel", None),
+            "sha_kernel": getattr(cx509, "_sha_kernel", None),
+            "corpus": args.corpus or "synthetic",
+            "corpus_digest": corpus_module.digest(certs),
+            "seed": args.seed,
+            "min_time": args.min_time,
+            "repeat": args.repeat,
+        },
+        "results": results,
+    }
+
+
+def compare(old, new):
+    """Print new's results against old's, matched by (profile, op); * marks different input."""
+    previous = dict(((r["profile"], r["op"]), r) for r in old["results"])
+    print "%-20s %-26s %12s %12s %8s %10s %10s" % ("profile", "op", "old ns/op", "new ns/op", "ratio",
+                                                   "old alloc", "new alloc")
+    for r in new["results"]:
+        o = previous.get((r["profile"], r["op"]))
+        if not o or "error" in o or "error" in r:
+            continue
+        print "%-20s %-26s %12.0f %12.0f %8.3f %10.1f %10.1f%s" % (
+            r["profile"], r["op"], o["ns_per_op"], r["ns_per_op"], r["ns_per_op"] / max(o["ns_per_op"], 1e-9),
+            o["malloc_per_op"], r["malloc_per_op"], "" if o.get("sha256") == r.get("sha256") else " *")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="cx509 benchmark suite")
+    parser.add_argument("-o", "--output", help="write JSON results here instead of stdout")
+    parser.add_argument("--compare", help="earlier JSON results to compare against")
+    parser.add_argument("--corpus", help="directory of PROFILE.der files to use instead of the synthetic corpus")
+    parser.add_argument("--seed", type=int, default=1, help="synthetic corpus seed")
+    parser.add_argument("-p", "--profile", action="append", help="measure only this profile (repeatable)")
+    parser.add_argument("--op", action="append", choices=[op for op, fn in OPERATIONS],
+                        help="measure only this operation (repeatable)")
+    parser.add_argument("-t", "--min-time", type=float, default=0.2, help="seconds per timed run")
+    parser.add_argument("-r", "--repeat", type=int, default=5, help="timed runs per result; the best counts")
+    parser.add_argument("--child", nargs=2, help=argparse.SUPPRESS)
+    args = parser.parse_args()
+
+    if args.child:
+        child(args)
+        return
+
+    results = run(args)
+    text = json.dumps(results, indent=1, sort_keys=True)
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(text + "\n")
+    elif not args.compare:
+        print text
+    if args.compare:
+        compare(json.load(open(args.compare)), results)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,75 @@
+#!/usr/bin/python
+"""
+Threaded parse throughput for cx509.
+
+Parses the given DER certificates over and over from 1..N Python threads and reports certificates
+per second for each thread count, so you can see how well decoding scales now that the GIL is
+released around ber_decode. With --batch, measures cx509.parse_many() on its native pool instead.
+
+usage: python bench/threads.py [-n ITERATIONS] [-t MAX_THREADS] [--batch] cert.der [cert.der ...]
+"""
+import os
+import sys
+import time
+import threading
+import argparse
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+import cx509
+
+
+def worker(certs, iterations):
+    for i in xrange(iterations):
+        for data in certs:
+            cx509.cx509(data)
+
+
+def run(certs, nthreads, iterations):
+    threads = [threading.Thread(target=worker, args=(certs, iterations)) for i in xrange(nthreads)]
+    start = time.time()
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    elapsed = time.time() - start
+    return nthreads * iterations * len(certs) / elapsed
+
+
+def run_batch(certs, nthreads, iterations):
+    batch = certs * max(1, 1000 / len(certs))
+    rounds = max(1, iterations * len(certs) / len(batch))
+    start = time.time()
+    for i in xrange(rounds):
+        cx509.parse_many(batch, threads=nthreads)
+    elapsed = time.time() - start
+    return rounds * len(batch) / elapsed
+
+
+def main():
+    parser = argparse.ArgumentParser(description="cx509 threaded parse throughput")
+    parser.add_argument("-n", "--iterations", type=int, default=2000, help="passes over the input per thread")
+    parser.add_argument("-t", "--threads", type=int, default=0, help="maximum thread count (default: number of CPUs)")
+    parser.add_argument("--batch", action="store_true", help="use parse_many() instead of Python threads")
+    parser.add_argument("certs", nargs="+", help="DER-encoded certificate files")
+    args = parser.parse_args()
+
+    certs = [open(path, "rb").read() for path in args.certs]
+    max_threads = args.threads
+    if max_threads <= 0:
+        import multiprocessing
+        max_threads = multiprocessing.cpu_count()
+
+    base = None
+    print "%8s %14s %8s" % ("threads", "certs/sec", "speedup")
+    for n in range(1, max_threads + 1):
+        if args.batch:
+            rate = run_batch(certs, n, args.iterations)
+        else:
+            rate = run(certs, n, args.iterations)
+        if base is None:
+            base = rate
+        print "%8d %14.0f %8.2f" % (n, rate, rate / base)
+
+
+if __name__ == "__main__":
+    main()
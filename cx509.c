@@ -11,6 +11,10 @@
 #include <string.h>
 #include <ctype.h>
 #include "structmember.h"
+#include "pythread.h"
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 /* root X.509 type header file; generated by asn1c */
 #include "Certificate.h"
@@ -19,6 +23,13 @@
 #include "BasicConstraints.h"
 #include "KeyUsage.h"
 #include "GeneralNames.h" /* for subjectAltName and issuerAltName */
+#include "SubjectKeyIdentifier.h"
+#include "AuthorityKeyIdentifier.h"
+#include "ExtKeyUsageSyntax.h"
+#include "CRLDistributionPoints.h"
+#include "AuthorityInfoAccessSyntax.h"
+#include "CertificatePolicies.h"
+#include "NameConstraints.h"
 
 /* PKCS1 types we need */
 #include "DigestInfo.h"
@@ -30,20 +41,356 @@
 #include "VisibleString.h"
 #include "NumericString.h"
 
+/* a byte range within the buffer a certificate was decoded from; length 0 if unknown */
+typedef struct {
+    Py_ssize_t offset;
+    Py_ssize_t length;
+} span_t;
+
+/* where the components we hand out as raw bytes live in the original encoding */
+typedef struct {
+    span_t certificate;		/* the whole Certificate TLV */
+    span_t tbs;			/* tbsCertificate TLV */
+    span_t signature_algorithm;	/* signatureAlgorithm TLV */
+    span_t signature;		/* signature BIT STRING contents, without the unused-bits octet */
+    span_t issuer;		/* issuer Name TLV */
+    span_t subject;		/* subject Name TLV */
+    span_t spki;		/* subjectPublicKeyInfo TLV */
+    span_t key;			/* subjectPublicKey BIT STRING contents, without the unused-bits octet */
+} cert_spans_t;
+
+/*
+ * A bump allocator the asn1c runtime decodes into; see "Arena allocator" below. Each cx509 object
+ * owns one, so its tree can be freed or reset without walking it.
+ */
+typedef struct arena_block arena_block;
+typedef struct {
+    arena_block *head;		/* the block we allocate from; older blocks are chained behind it */
+    char *last;			/* the most recent allocation, which can be resized or freed in place */
+    size_t hint;		/* size for the first block */
+} cx509_arena;
+
+/* an arena position to rewind to */
+typedef struct {
+    arena_block *head;
+    size_t used;
+} arena_mark;
+
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+#define ARENA_ALIGN 8
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1))
+#define ARENA_HEADER ARENA_ROUND(sizeof(size_t))	/* each allocation is preceded by its size */
+#define ARENA_MIN_BLOCK 1024
+#define ARENA_BYTES_PER_INPUT_BYTE 4	/* rough size of a decoded tree relative to its encoding */
+
+static THREAD_LOCAL cx509_arena *current_arena = NULL;
+static int arena_enabled = 1;	/* see _use_arena() */
+
+/* optional limits on a decode (see "Decode budgets"); 0 means no limit */
+typedef struct {
+    Py_ssize_t max_size;	/* bytes of input */
+    Py_ssize_t max_depth;	/* nesting depth of BER elements, at most BUDGET_MAX_DEPTH */
+    Py_ssize_t max_elements;	/* BER elements */
+    PY_LONG_LONG max_ns;	/* time */
+} decode_limits;
+
+/* a decode in progress under some limits */
+typedef struct {
+    decode_limits limits;
+    uint64_t deadline;		/* when max_ns runs out, or 0 */
+    unsigned ticks;		/* allocations since the decode began; we check the clock every few */
+    int exceeded;		/* the BUDGET_* limit that stopped the decode, or 0 */
+} decode_budget;
+
+enum { BUDGET_OK, BUDGET_SIZE, BUDGET_DEPTH, BUDGET_ELEMENTS, BUDGET_NS };
+#define BUDGET_MAX_DEPTH 256
+
+static THREAD_LOCAL decode_budget *current_budget = NULL;	/* the decode with a deadline on this thread */
+
 typedef struct {
     PyObject_HEAD
     Certificate_t *certificate;
+    Py_buffer source;		/* the buffer certificate was decoded from (source.obj is NULL if none) */
+    cert_spans_t spans;		/* component locations within source */
+    cx509_arena arena;		/* holds certificate, unless it was decoded with the arena disabled */
+    int missing;	/* PART bits of the components a projected parse hasn't decoded yet; see _need */
+    unsigned char sha1[20];	/* cached fingerprints of the encoding; see digests */
+    unsigned char sha256[32];
+    int digests;	/* DIGEST_* bits for the fingerprints computed since the last _parse */
+    PyObject *subject_key;	/* cached get_subject_key() result, or NULL */
+    PyObject *issuer_key;	/* cached get_issuer_key() result, or NULL */
+    int64_t epochs[2];		/* cached get_validity_epoch() values; see have_epochs */
+    int have_epochs;	/* nonzero if epochs has been filled in since the last _parse */
+    int busy;		/* number of threads reading certificate with the GIL released */
+    int parsing;	/* nonzero while _parse is decoding with the GIL released */
+    int scratch;	/* nonzero while a getter is making temporary decodes in arena */
+    PyObject *shared;	/* the ParseCache entry owning certificate, or NULL if we own it */
+    decode_limits limits;	/* the budgets _parse was given, which also apply to our nested decodes */
+    PyObject *extension_index;	/* extension name or dotted OID -> position, or NULL; see _extension_index */
+    PyObject *extension_cache;	/* get_extension() results by position (None until asked for), or NULL */
+    PyObject *alt_names[4];	/* get_alt_names() results by ALT_NAMES_*, or NULL; None if there are none */
+    PyObject *memo[6];		/* getter results by MEMO_*, or NULL; see _memo */
 } cx509;
 
+enum { ALT_NAMES_SUBJECT, ALT_NAMES_SUBJECT_FLAT, ALT_NAMES_ISSUER, ALT_NAMES_ISSUER_FLAT, ALT_NAMES_COUNT };
+enum { MEMO_VALIDITY, MEMO_ISSUER, MEMO_SUBJECT, MEMO_PUBLIC_KEY, MEMO_EXTENSIONS, MEMO_SERIAL_NUMBER, MEMO_COUNT };
+
+/* return a getter's result from self->memo[slot] if an earlier call made it */
+#define MEMO_RETURN(self, slot) do {							\
+    if ((self)->memo[slot]) {								\
+	Py_INCREF((self)->memo[slot]);							\
+	return (self)->memo[slot];							\
+    }											\
+} while (0)
+
+#define DIGEST_SHA1 1
+#define DIGEST_SHA256 2
+#define DIGEST_SIZE(algorithm) ((algorithm) == DIGEST_SHA1 ? 20 : 32)
+
+/* a validity time that is absent or doesn't parse */
+#define EPOCH_MISSING ((int64_t) -0x7fffffffffffffffLL - 1)
+
+/*
+ * Bracket pure-C work on self->certificate that runs with the GIL released. While any such reader
+ * is active, _parse refuses to replace the tree out from under it.
+ */
+#define BEGIN_ALLOW_THREADS(self) do { (self)->busy++; Py_BEGIN_ALLOW_THREADS
+#define END_ALLOW_THREADS(self) Py_END_ALLOW_THREADS (self)->busy--; } while (0)
+
+/*
+ * Bracket the temporary asn1c decodes a getter makes while building its result (extension values,
+ * attribute strings and so on). They come out of self's arena and are given back at the end, so
+ * they cost no malloc/free pairs. The scope counts as busy, so _parse can't reset the arena under
+ * us if Python code run from within the getter switches threads; if the arena is already in use
+ * for this (which takes exactly that kind of reentry), the temporaries just use malloc.
+ */
+#define BEGIN_SCRATCH(self) do { cx509_arena *_previous_arena = current_arena;		\
+    int _scratch = arena_enabled && !(self)->scratch;					\
+    arena_mark _mark = _arena_mark(&(self)->arena);					\
+    (self)->busy++;									\
+    (self)->scratch |= _scratch;							\
+    current_arena = _scratch ? &(self)->arena : NULL
+#define END_SCRATCH(self) current_arena = _previous_arena;				\
+    if (_scratch) {									\
+	_arena_rewind(&(self)->arena, _mark);						\
+	(self)->scratch = 0;								\
+    }											\
+    (self)->busy--; } while (0)
+
+/*
+ * Instrumentation: call counts, bytes decoded, decode failures by asn_dec_rval_t code and
+ * log2-bucketed latency histograms for _parse, the getters and the nested decodes made by
+ * extensions() and get_public_key(), reported by cx509.stats(). Each thread counts into a block
+ * of its own, so counting takes no locks; stats() sums the blocks, and a thread that exits leaves
+ * its block (and its counts) to the next new thread. Where <sys/sdt.h> is available each site is
+ * also a USDT probe pair, cx509:call__entry(site) and cx509:call__return(site, ns, bytes, code),
+ * for perf or bpftrace to attach to. Building with -DCX509_NO_STATS (setup.py adds it if
+ * CX509_NO_STATS is set in the environment) compiles all of this out.
+ */
+#ifndef CX509_NO_STATS
+#define CX509_STATS 1
+#endif
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/* a monotonic clock, in ns */
+static uint64_t
+_now_ns(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER t, f;
+
+    QueryPerformanceCounter(&t);
+    QueryPerformanceFrequency(&f);
+    return (uint64_t) ((double) t.QuadPart * 1e9 / (double) f.QuadPart);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+enum {
+    STAT_PARSE, STAT_GET_VERSION, STAT_GET_VALIDITY, STAT_GET_VALIDITY_EPOCH, STAT_GET_ISSUER,
+    STAT_GET_SUBJECT, STAT_GET_ISSUER_KEY, STAT_GET_SUBJECT_KEY, STAT_GET_PUBLIC_KEY,
+    STAT_GET_SIGNATURE_ALGORITHM, STAT_GET_SIGNATURE_VALUE, STAT_GET_TBS_CERTIFICATE_DATA,
+    STAT_PARSE_DIGEST_INFO, STAT_EXTENSIONS, STAT_FINGERPRINT, STAT_STR,
+    STAT_EXTENSIONS_DECODE, STAT_PUBLIC_KEY_DECODE, STAT_GET_EXTENSION, STAT_HAS_EXTENSION,
+    STAT_GET_ALT_NAMES, STAT_GET_SERIAL_NUMBER, STAT_COUNT
+};
+
+#ifdef CX509_STATS
+static const char *stat_names[STAT_COUNT] = {
+    "_parse", "get_version", "get_validity", "get_validity_epoch", "get_issuer",
+    "get_subject", "get_issuer_key", "get_subject_key", "get_public_key",
+    "get_signature_algorithm", "get_signature_value", "get_tbs_certificate_data",
+    "parse_digest_info", "extensions", "fingerprint", "__str__",
+    "extensions.ber_decode", "get_public_key.ber_decode", "get_extension", "has_extension",
+    "get_alt_names", "get_serial_number"
+};
+
+#define STAT_BUCKETS 32	/* bucket i counts calls taking [2^i, 2^(i+1)) ns; the last, anything longer too */
+
+typedef struct {
+    uint64_t calls;
+    uint64_t bytes;		/* encoded bytes handed to the decoder */
+    uint64_t ns;		/* total time */
+    uint64_t failures[RC_FAIL + 1];	/* decodes by rval.code; RC_OK is not counted */
+    uint64_t latency[STAT_BUCKETS];
+} stat_site;
+
+typedef struct stat_block stat_block;
+struct stat_block {
+    stat_site sites[STAT_COUNT];
+    stat_block *next;		/* every block made, newest first */
+    stat_block *next_free;	/* blocks left by exited threads */
+};
+
+static THREAD_LOCAL stat_block *stat_mine = NULL;
+static stat_block *stat_blocks = NULL, *stat_free = NULL;	/* protected by stat_lock */
+static PyThread_type_lock stat_lock = NULL;
+static stat_site stat_baseline[STAT_COUNT];	/* the sums at the last reset_stats(); protected by the GIL */
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#define STAT_PTHREAD 1
+static pthread_key_t stat_key;	/* its destructor hands an exiting thread's block on */
+#endif
+
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define STAT_PROBE_ENTRY(site) DTRACE_PROBE1(cx509, call__entry, stat_names[site])
+#define STAT_PROBE_RETURN(site, ns, bytes, code) DTRACE_PROBE4(cx509, call__return, stat_names[site], ns, bytes, code)
+#endif
+#endif
+#ifndef STAT_PROBE_ENTRY
+#define STAT_PROBE_ENTRY(site)
+#define STAT_PROBE_RETURN(site, ns, bytes, code)
+#endif
+
+static void
+_stat_release(void *block)
+{
+    PyThread_acquire_lock(stat_lock, WAIT_LOCK);
+    ((stat_block *) block)->next_free = stat_free;
+    stat_free = (stat_block *) block;
+    PyThread_release_lock(stat_lock);
+}
+
+/* this thread's block, taking over an exited thread's or making a new one the first time */
+static stat_block *
+_stat_block(void)
+{
+    stat_block *block;
+
+    if (stat_mine || !stat_lock)
+	return stat_mine;
+    PyThread_acquire_lock(stat_lock, WAIT_LOCK);
+    if ((block = stat_free))
+	stat_free = block->next_free;
+    else if ((block = calloc(1, sizeof(stat_block)))) {
+	block->next = stat_blocks;
+	stat_blocks = block;
+    }
+    PyThread_release_lock(stat_lock);
+#ifdef STAT_PTHREAD
+    if (block)
+	pthread_setspecific(stat_key, block);
+#endif
+    return stat_mine = block;
+}
+
+/* give up this thread's block before the thread exits; for threads we start ourselves */
+static void
+_stat_thread_exit(void)
+{
+    if (!stat_mine)
+	return;
+#ifdef STAT_PTHREAD
+    pthread_setspecific(stat_key, NULL);
+#endif
+    _stat_release(stat_mine);
+    stat_mine = NULL;
+}
+
+static int
+_stat_init(void)
+{
+    if (stat_lock)
+	return 0;
+#ifdef STAT_PTHREAD
+    if (pthread_key_create(&stat_key, _stat_release) != 0) {
+	PyErr_NoMemory();
+	return -1;
+    }
+#endif
+    if (!(stat_lock = PyThread_allocate_lock())) {
+	PyErr_NoMemory();
+	return -1;
+    }
+    return 0;
+}
+
+/* count a call to site that began at start; code is the decoder's rval.code, or -1 if none */
+static void
+_stat_record(int site, uint64_t start, size_t bytes, int code)
+{
+    stat_block *block = _stat_block();
+    uint64_t ns = _now_ns() - start;
+    stat_site *s;
+    int bucket;
+
+    STAT_PROBE_RETURN(site, ns, bytes, code);
+    if (!block)
+	return;
+    s = &block->sites[site];
+    s->calls++;
+    s->bytes += bytes;
+    s->ns += ns;
+    if (code > RC_OK && code <= RC_FAIL)
+	s->failures[code]++;
+#if defined(__GNUC__)
+    bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+#else
+    for (bucket = 0; bucket < 63 && ns >> (bucket + 1); bucket++)
+	;
+#endif
+    s->latency[bucket < STAT_BUCKETS ? bucket : STAT_BUCKETS - 1]++;
+}
+
+#define STAT_START(site, start) do { STAT_PROBE_ENTRY(site); (start) = _now_ns(); } while (0)
+#define STAT_DONE(site, start, bytes, code) _stat_record(site, start, (size_t) (bytes), code)
+#else
+#define STAT_START(site, start) do { (void) (start); } while (0)
+#define STAT_DONE(site, start, bytes, code) do { (void) (bytes); } while (0)
+#define _stat_thread_exit() do { } while (0)
+#endif
+
+/* signature shared by ber_decode and xer_decode */
+typedef asn_dec_rval_t (*decoder_f)(asn_codec_ctx_t *, asn_TYPE_descriptor_t *, void **, const void *, size_t);
+
+/* allocate a string big enough to hold the decoded form of len chars of base64 */
+#define BASE64_DECODED_STRING(len) PyString_FromStringAndSize(NULL, 3 * ((len) / 4) + 3)
+
 /* 
- * OIDs we know about. These MUST be in lexicographic sorted order by dotted string, because this
- * array is binary-searched.
+ * OIDs we know about. These are kept in lexicographic sorted order by dotted string for ease of
+ * maintenance; lookups go through oid_table below, which is built from this array at module init.
  */
 typedef struct {
     char *dotted;
     char *name;
 } oid_t;
-static int nOIDs = 0; /* set dynamically by find_oid */
 static oid_t OIDs[] = {
     /* see: http://www.alvestrand.no/cgi-bin/hta/oidwordsearch */
     { "{ 0.9.2342.19200300.100.1.25 }", "domainComponent" },
@@ -51,6 +398,8 @@ static oid_t OIDs[] = {
     { "{ 1.2.840.10040.4.1 }", "id-dsa" },
     { "{ 1.2.840.10040.4.3 }", "id-dsa-with-sha1" },
     { "{ 1.2.840.10045.2.1 }", "id-ecPublicKey" }, /* Elliptic Curve public key */
+    { "{ 1.2.840.10045.3.1.1 }", "prime192v1" }, /* named curves, RFC 5480 */
+    { "{ 1.2.840.10045.3.1.7 }", "prime256v1" },
     { "{ 1.2.840.10045.4.1 }", "ecdsa-with-SHA1" }, /* ECDSA signature with SHA-1 */
     { "{ 1.2.840.10045.4.3.1 }", "ecdsa-with-SHA224" }, /* http://tools.ietf.org/html/draft-ietf-pkix-sha2-dsa-ecdsa-10 */
     { "{ 1.2.840.10045.4.3.2 }", "ecdsa-with-SHA256" },
@@ -74,6 +423,17 @@ static oid_t OIDs[] = {
     { "{ 1.2.840.113549.2.2 }", "md2" }, /* MD2 hash function */
     { "{ 1.2.840.113549.2.26 }", "id-sha1" },
     { "{ 1.2.840.113549.2.5 }", "md5" }, /* MD5 hash function */
+    { "{ 1.3.101.110 }", "X25519" }, /* RFC 8410 */
+    { "{ 1.3.101.111 }", "X448" },
+    { "{ 1.3.101.112 }", "Ed25519" },
+    { "{ 1.3.101.113 }", "Ed448" },
+    { "{ 1.3.132.0.10 }", "secp256k1" },
+    { "{ 1.3.132.0.33 }", "secp224r1" },
+    { "{ 1.3.132.0.34 }", "secp384r1" },
+    { "{ 1.3.132.0.35 }", "secp521r1" },
+    { "{ 1.3.36.3.3.2.8.1.1.11 }", "brainpoolP384r1" }, /* RFC 5639 */
+    { "{ 1.3.36.3.3.2.8.1.1.13 }", "brainpoolP512r1" },
+    { "{ 1.3.36.3.3.2.8.1.1.7 }", "brainpoolP256r1" },
     { "{ 1.3.14.3.2.10 }", "desMAC" },
     { "{ 1.3.14.3.2.11 }", "rsaSignature" },
     { "{ 1.3.14.3.2.12 }", "dsa" },
@@ -110,6 +470,16 @@ static oid_t OIDs[] = {
     { "{ 1.3.6.1.5.5.7.1.12 }", "id-pe-logotype" }, /* private certificate extension */
     { "{ 1.3.6.1.5.5.7.1.2 }", "id-pe-biometricInfo" }, /* private certificate extension */
     { "{ 1.3.6.1.5.5.7.1.3 }", "id-pe-qcStatements" }, /* private certificate extension */
+    { "{ 1.3.6.1.5.5.7.2.1 }", "cps" }, /* policy qualifier */
+    { "{ 1.3.6.1.5.5.7.2.2 }", "unotice" }, /* policy qualifier */
+    { "{ 1.3.6.1.5.5.7.3.1 }", "serverAuth" }, /* extended key usage */
+    { "{ 1.3.6.1.5.5.7.3.2 }", "clientAuth" }, /* extended key usage */
+    { "{ 1.3.6.1.5.5.7.3.3 }", "codeSigning" }, /* extended key usage */
+    { "{ 1.3.6.1.5.5.7.3.4 }", "emailProtection" }, /* extended key usage */
+    { "{ 1.3.6.1.5.5.7.3.8 }", "timeStamping" }, /* extended key usage */
+    { "{ 1.3.6.1.5.5.7.3.9 }", "OCSPSigning" }, /* extended key usage */
+    { "{ 1.3.6.1.5.5.7.48.1 }", "ocsp" }, /* access method */
+    { "{ 1.3.6.1.5.5.7.48.2 }", "caIssuers" }, /* access method */
     { "{ 2.16.840.1.101.2.1.1.22 }", "id-keyExchangeAlgorithm" }, /* KEA key */
     { "{ 2.16.840.1.101.3.4.2.1 }", "sha-256" },
     { "{ 2.16.840.1.101.3.4.2.2 }", "sha-384" },
@@ -141,6 +511,7 @@ static oid_t OIDs[] = {
     { "{ 2.5.29.35 }", "authorityKeyIdentifier" },
     { "{ 2.5.29.36 }", "policyConstraints" },
     { "{ 2.5.29.37 }", "extendedKeyUsage" },
+    { "{ 2.5.29.37.0 }", "anyExtendedKeyUsage" },
     { "{ 2.5.29.4 }", "primaryKeyUsageRestriction" },
     { "{ 2.5.29.46 }", "freshestCRL" },
     { "{ 2.5.29.54 }", "inhibitAnyPolicy" },
@@ -219,7 +590,6 @@ static oid_t OIDs[] = {
 };
 
 /* short names aren't currently used; they are here for reference */
-static int nOIDs_short_names = 0; /* set dynamically by find_oid */
 static oid_t OID_short_names[] = {
     { "{ 0.9.2342.19200300.100.1.25 }", "DC" },
     { "{ 0.9.2342.19200300.100.1.1 }", "UID" },
@@ -237,15 +607,136 @@ static oid_t OID_short_names[] = {
     { NULL,  NULL }
 };
 
+/*
+ * Hash table over OIDs[] and OID_short_names[], keyed on the DER content octets of each OID so a
+ * decoded OBJECT_IDENTIFIER_t can be looked up as-is, without printing it to a dotted string first.
+ * Open addressing with linear probing; built by _oid_table_init() and read-only afterwards, so
+ * lookups are safe without the GIL.
+ */
+#define OID_MAX_DER 32
+typedef struct {
+    uint8_t der[OID_MAX_DER];	/* content octets (no tag or length) */
+    size_t len;			/* 0 marks an empty slot */
+    uint32_t hash;
+    const char *dotted;		/* "{ 1.2.3 }", as OBJECT_IDENTIFIER_print renders it */
+    const char *name;		/* from OIDs[], or NULL */
+    const char *short_name;	/* from OID_short_names[], or NULL */
+    /* interned strings built from the above, so getters needn't allocate them */
+    PyObject *py_dotted;
+    PyObject *py_key;		/* name, or dotted if we have no name */
+    PyObject *py_encoding_key;	/* "<key>:encoding" */
+    PyObject *py_oid_key;	/* "<key>:oid" */
+    const struct extension_decoder *decoder;	/* for extension OIDs we decode; see "Extension decoders" */
+} oid_entry_t;
+static oid_entry_t *oid_table = NULL;
+static size_t oid_table_mask = 0;
+
+/*
+ * Other strings the getters hand out over and over (dict keys, encodings, keyUsage flags), interned
+ * once at module init so adding one to a result is a refcount bump rather than an allocation.
+ */
+#define INTERNED_STRINGS(X)							\
+    /* dict keys */								\
+    X(algorithm, "algorithm") X(algorithm_oid, "algorithm_oid") X(cA, "cA")	\
+    X(critical, "critical") X(digest, "digest") X(dNSName, "dNSName")		\
+    X(key, "key") X(keylen, "keylen") X(keyUsage, "keyUsage")			\
+    X(modulus, "modulus") X(name, "name")					\
+    X(pathLenConstraint, "pathLenConstraint") X(public_exponent, "public_exponent") \
+    /* public key fields */							\
+    X(curve, "curve") X(curve_oid, "curve_oid") X(point_format, "point_format")	\
+    X(x, "x") X(y, "y") X(x_parity, "x_parity") X(y_parity, "y_parity")	\
+    X(p, "p") X(q, "q") X(g, "g")						\
+    X(uncompressed, "uncompressed") X(compressed, "compressed") X(hybrid, "hybrid") \
+    /* extension fields */							\
+    X(accessDescriptions, "accessDescriptions") X(authorityCertIssuer, "authorityCertIssuer") \
+    X(authorityCertSerialNumber, "authorityCertSerialNumber") X(cRLIssuer, "cRLIssuer") \
+    X(distributionPoints, "distributionPoints") X(excludedSubtrees, "excludedSubtrees") \
+    X(extendedKeyUsage, "extendedKeyUsage") X(fullName, "fullName")		\
+    X(keyIdentifier, "keyIdentifier") X(nameRelativeToCRLIssuer, "nameRelativeToCRLIssuer") \
+    X(permittedSubtrees, "permittedSubtrees") X(policies, "policies") X(reasons, "reasons") \
+    /* GeneralName forms (dNSName is above) */					\
+    X(otherName, "otherName") X(rfc822Name, "rfc822Name") X(x400Address, "x400Address") \
+    X(directoryName, "directoryName") X(ediPartyName, "ediPartyName")		\
+    X(uniformResourceIdentifier, "uniformResourceIdentifier") X(iPAddress, "iPAddress") \
+    X(registeredID, "registeredID")						\
+    X(nameAssigner, "nameAssigner") X(partyName, "partyName")			\
+    /* string encodings */							\
+    X(ascii, "ascii") X(ia5, "ia5") X(utf8, "utf8")				\
+    X(x500_bmp, "x500-bmp") X(x500_teletex, "x500-teletex")			\
+    X(x500_universal, "x500-universal") X(x500_unknown, "x500-unknown")	\
+    /* keyUsage flags */							\
+    X(digitalSignature, "digitalSignature") X(nonRepudiation, "nonRepudiation")	\
+    X(keyEncipherment, "keyEncipherment") X(dataEncipherment, "dataEncipherment") \
+    X(keyAgreement, "keyAgreement") X(keyCertSign, "keyCertSign")		\
+    X(cRLSign, "cRLSign") X(encipherOnly, "encipherOnly") X(decipherOnly, "decipherOnly") \
+    /* CRL reason flags */							\
+    X(unused, "unused") X(keyCompromise, "keyCompromise") X(cACompromise, "cACompromise") \
+    X(affiliationChanged, "affiliationChanged") X(superseded, "superseded")	\
+    X(cessationOfOperation, "cessationOfOperation") X(certificateHold, "certificateHold") \
+    X(privilegeWithdrawn, "privilegeWithdrawn") X(aACompromise, "aACompromise")
+
+enum {
+#define X(id, text) S_##id,
+    INTERNED_STRINGS(X)
+#undef X
+    S_COUNT
+};
+static PyObject *interned[S_COUNT];
+#define INTERNED(id) (interned[S_##id])
+
+/* keyUsage flag names, indexed by KeyUsage bit number */
+static const int key_usage_strings[] = {
+    S_digitalSignature, S_nonRepudiation, S_keyEncipherment, S_dataEncipherment, S_keyAgreement,
+    S_keyCertSign, S_cRLSign, S_encipherOnly, S_decipherOnly
+};
+
+/*
+ * Internal exporter that gives memory without a new-style buffer interface of its own (such as the
+ * old-style buffer of an mmap object) one, so cx509 objects can hold exports on it and hand out
+ * memoryviews into it.
+ */
+typedef struct {
+    PyObject_HEAD
+    Py_buffer view;	/* the memory we export; view.obj keeps its owner alive */
+} buffer_owner;
+
 /* Forward declarations */
 static PyTypeObject cx509Type;
+static PyTypeObject buffer_ownerType;
 static PyObject *cx509_parse(cx509 *self, PyObject *args, PyObject *kw);
 static char *_oid_to_string(OBJECT_IDENTIFIER_t *oid);
-static char *_integer_to_hex_string(INTEGER_t *I);
+static PyObject *_integer_to_long(const uint8_t *buf, size_t size, int is_signed);
 static void _populate_dict_from_rdn_sequence(PyObject *dict, RDNSequence_t *rdnSequence);
-static void _add_directory_string_to_dict(ANY_t *any, PyObject *dict, const char *key_name, const char *dotted);
-static PyObject *_directory_string_to_string(DirectoryString_t *ds, char encoding[16]);
-static const char *find_oid(const char *dotted, int shortname);
+static void _add_directory_string_to_dict(ANY_t *any, PyObject *dict, const oid_entry_t *oid);
+static PyObject *_directory_string_to_string(DirectoryString_t *ds, PyObject **encoding);
+static const oid_entry_t *_oid_lookup(const OBJECT_IDENTIFIER_t *oid);
+static int _oid_entry_strings(oid_entry_t *entry, int intern);
+static void _oid_entry_clear(oid_entry_t *entry);
+static int _oid_table_init(void);
+static int _interned_init(void);
+static decoder_f _decoder_for_format(const char *format, int *pem);
+static int _pem_find_certificate(const char *buf, Py_ssize_t size, Py_ssize_t *offset, Py_ssize_t *start, const char **body, Py_ssize_t *body_len);
+static Py_ssize_t _base64_decode(const char *in, Py_ssize_t len, unsigned char *out);
+static Certificate_t *_decode_certificate(decoder_f decode, const void *data, size_t len, cert_spans_t *spans, asn_dec_rval_t *rval, cx509_arena *arena);
+static void _free_certificate(Certificate_t *certificate, cx509_arena *arena);
+static int _arena_owns(const cx509_arena *arena, const void *p);
+static arena_mark _arena_mark(const cx509_arena *arena);
+static void _arena_rewind(cx509_arena *arena, arena_mark mark);
+static void _arena_reset(cx509_arena *arena);
+void *cx509_arena_calloc(size_t nmemb, size_t size);
+static void _sha_init(void);
+static void _sha_digest(int algorithm, const unsigned char *data, size_t len, unsigned char *out);
+static PyObject *_der_encode(cx509 *self, asn_TYPE_descriptor_t *td, void *sptr);
+static void _locate_spans(const uint8_t *buf, size_t size, cert_spans_t *spans);
+static PyObject *_span_to_memoryview(cx509 *self, const span_t *span);
+static int _attach_source(cx509 *obj, Py_buffer *view, size_t consumed, int zero_copy);
+static PyObject *_cx509_from_decoded(Certificate_t *certificate, cx509_arena *arena, const cert_spans_t *spans, Py_buffer *view, size_t consumed, int zero_copy);
+static Certificate_t *_decode_projection(const void *data, size_t len, int wanted, cert_spans_t *spans, asn_dec_rval_t *rval, cx509_arena *arena, int *missing);
+static int _projection_parts(PyObject *fields);
+static int _limits_check(const decode_limits *limits);
+static void _budget_error(int exceeded);
+static Certificate_t *_decode_limited(decoder_f decode, const void *data, size_t len, int wanted, cert_spans_t *spans, asn_dec_rval_t *rval, cx509_arena *arena, int *missing, decode_budget *budget);
+static int _extension_index(cx509 *self);
 
 static PyObject *
 cx509_new(PyTypeObject *type, PyObject *args, PyObject *kw)
@@ -269,957 +760,6779 @@ cx509_init(cx509 *self, PyObject *args, PyObject *kw)
 static PyObject *
 cx509_parse(cx509 *self, PyObject *args, PyObject *kw)
 {
-    static char *kwlist[] = { "data", "format", NULL };
-    PyObject *data = NULL;
-    Py_ssize_t len;
+    static char *kwlist[] = { "data", "format", "zero_copy", "fields", "max_size", "max_depth", "max_elements", "max_ns", NULL };
+    Py_buffer data, previous_source;
     char *format = NULL;
-    Certificate_t *certificate = NULL;
+    PyObject *fields = Py_None;
+    int zero_copy = 0, pem = 0, wanted = -1, missing = 0, i;
+    decode_limits limits = { 0, 0, 0, 0 };
+    decode_budget budget;
+    Certificate_t *certificate = NULL, *previous;
+    PyObject *shared;
+    cert_spans_t spans;
+    decoder_f decode;
     asn_dec_rval_t rval;
+    PyObject *der = NULL;
+    const char *body;
+    Py_ssize_t body_len, offset = 0, start, n = -1, decoded;
+    uint64_t began;
+
+    STAT_START(STAT_PARSE, began);
+    data.obj = NULL;
+    data.len = -1; /* stays -1 if no data was passed */
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "|s*siOnnnL", kwlist, &data, &format, &zero_copy, &fields,
+				     &limits.max_size, &limits.max_depth, &limits.max_elements, &limits.max_ns))
+	return NULL;
+
+    if (_limits_check(&limits) < 0 || !(decode = _decoder_for_format(format, &pem)) || self->parsing || self->busy ||
+	(fields != Py_None && decode == ber_decode && (wanted = _projection_parts(fields)) < 0)) {
+	if (!PyErr_Occurred())
+	    PyErr_Format(PyExc_RuntimeError, "cx509 object is in use by another thread");
+	if (data.len >= 0)
+	    PyBuffer_Release(&data);
+	return NULL;
+    }
 
-    if (!PyArg_ParseTupleAndKeywords(args, kw, "|s#O", kwlist, &data, &len, &format))
+    /* for PEM, find the first certificate block and allocate the string we'll decode it into */
+    if (pem && data.len >= 0 &&
+	_pem_find_certificate(data.buf, data.len, &offset, &start, &body, &body_len) &&
+	!(der = BASE64_DECODED_STRING(body_len))) {
+	PyBuffer_Release(&data);
 	return NULL;
+    }
 
-    /* free existing data (if any) */
-    asn_DEF_Certificate.free_struct(&asn_DEF_Certificate, self->certificate, 0);
+    /* detach existing data (if any); it is freed (or its arena emptied) below along with the decode */
+    previous = self->certificate;
+    previous_source = self->source;
+    shared = self->shared;
+    if (shared)
+	previous = NULL; /* the tree belongs to a ParseCache entry; we just drop our reference */
+    self->shared = NULL;
     self->certificate = NULL;
+    memset(&self->source, 0, sizeof(self->source));
+    memset(&self->spans, 0, sizeof(self->spans));
+    self->digests = 0;
+    self->have_epochs = 0;
+    self->missing = 0;
+    self->limits = limits;
+    Py_CLEAR(self->subject_key);
+    Py_CLEAR(self->issuer_key);
+    Py_CLEAR(self->extension_index);
+    Py_CLEAR(self->extension_cache);
+    for (i = 0; i < ALT_NAMES_COUNT; i++)
+	Py_CLEAR(self->alt_names[i]);
+    for (i = 0; i < MEMO_COUNT; i++)
+	Py_CLEAR(self->memo[i]);
+    budget.limits = limits;
+    budget.exceeded = BUDGET_OK;
 
-    if (data) {
-	/* parse new data */
-	if (format == NULL || 
-	    !strcmp(format, "ber") || !strcmp(format, "BER") ||
-	    !strcmp(format, "cer") || !strcmp(format, "CER") ||
-	    !strcmp(format, "der") || !strcmp(format, "DER")) {
-	    rval = ber_decode(0, &asn_DEF_Certificate, (void **) &certificate, (const void *) data, (size_t) len);
-	}
-	else if (!strcmp(format, "xer") || !strcmp(format, "XER")) {
-	    rval = xer_decode(0, &asn_DEF_Certificate, (void **) &certificate, (const void *) data, (size_t) len);
-	}
-	else {
-	    PyErr_Format(PyExc_ValueError, "unknown format");
+    /*
+     * The decode runs without the GIL. The data buffer stays pinned by the export we hold on it,
+     * and the parsing flag keeps other threads from reparsing this object until we reattach the
+     * result.
+     */
+    self->parsing = 1;
+    Py_BEGIN_ALLOW_THREADS
+    if (previous && _arena_owns(&self->arena, previous))
+	_arena_reset(&self->arena); /* the new tree reuses the old one's largest block */
+    else
+	asn_DEF_Certificate.free_struct(&asn_DEF_Certificate, previous, 0);
+    if (der) {
+	n = _base64_decode(body, body_len, (unsigned char *) PyString_AS_STRING(der));
+	if (n >= 0)
+	    certificate = _decode_limited(decode, PyString_AS_STRING(der), (size_t) n, wanted, &spans, &rval, &self->arena, &missing, &budget);
+    }
+    else if (data.len >= 0 && !pem)
+	certificate = _decode_limited(decode, data.buf, (size_t) data.len, wanted, &spans, &rval, &self->arena, &missing, &budget);
+    Py_END_ALLOW_THREADS
+    self->parsing = 0;
+    PyBuffer_Release(&previous_source);
+    decoded = der ? n : (pem ? -1 : data.len); /* bytes handed to the decoder, or -1 if none */
+    STAT_DONE(STAT_PARSE, began, decoded > 0 ? decoded : 0, decoded < 0 ? -1 : certificate ? RC_OK : (int) rval.code);
+    Py_XDECREF(shared);
+
+    /* for PEM, the decoded string becomes the source */
+    if (der) {
+	PyBuffer_Release(&data);
+	if (certificate && (_PyString_Resize(&der, n) < 0 || PyObject_GetBuffer(der, &data, PyBUF_SIMPLE) < 0)) {
+	    Py_XDECREF(der);
+	    _free_certificate(certificate, &self->arena);
 	    return NULL;
 	}
-	if (rval.code == RC_OK) {
-	    /* decoding succeeded */
-	    self->certificate = certificate;
-	} 
-	else {
-	    /* Free partially decoded certificate */
-	    asn_DEF_Certificate.free_struct(&asn_DEF_Certificate, certificate, 0);
-	    self->certificate = NULL;
+	Py_DECREF(der); /* data holds a reference if we need one */
+    }
+
+    if (certificate) {
+	/* keep the source so we can hand out its components without copying */
+	if (_attach_source(self, &data, rval.consumed, zero_copy) < 0) {
+	    _free_certificate(certificate, &self->arena);
+	    return NULL;
 	}
+	self->certificate = certificate;
+	self->spans = spans;
+	self->missing = missing;
     }
+    else if (data.len >= 0)
+	PyBuffer_Release(&data);
 
+    if (budget.exceeded) {
+	_budget_error(budget.exceeded);
+	return NULL;
+    }
     Py_INCREF(self);
     return (PyObject *) self;
 }
 
-/* count up total number of bytes in string output */
-static int 
-_print2count(const void *buffer, size_t size, void *app_key)
+/*
+ * Hand the buffer a certificate was decoded from over to obj, which keeps it as the source for the
+ * memoryviews it returns. A string (which is immutable), or any new-style buffer when zero_copy is
+ * set, is kept as-is, pinning the exporter for the life of obj. Otherwise we keep a private copy of
+ * just the bytes the decoder consumed, so later changes to a mutable buffer can't affect us. That
+ * includes objects with only an old-style buffer, such as a Python 2 mmap: nothing stops their
+ * owner from unmapping the memory under us, so they are copied even with zero_copy. (iter_file's
+ * own mapping is exported through a buffer_owner no caller can close, so it is kept as-is.)
+ * Consumes view either way.
+ */
+static int
+_attach_source(cx509 *obj, Py_buffer *view, size_t consumed, int zero_copy)
 {
-    *((size_t *) app_key) += size;
-    return 0;
-}
+    PyObject *copy;
+    int result;
 
-/* copy the string output to the specified output buffer */
-static int 
-_print2buffer(const void *buffer, size_t size, void *app_key)
-{
-    char **output = (char **) app_key;
-    memcpy(*output, buffer, size);
-    *output += size;
-    return 0;
+    if (view->obj && PyObject_CheckBuffer(view->obj) &&
+	(PyString_Check(view->obj) || (zero_copy && !PyUnicode_Check(view->obj)))) {
+	obj->source = *view;
+	view->obj = NULL;
+	return 0;
+    }
+
+    copy = PyString_FromStringAndSize(view->buf, (Py_ssize_t) consumed);
+    PyBuffer_Release(view);
+    if (!copy)
+	return -1;
+    result = PyObject_GetBuffer(copy, &obj->source, PyBUF_SIMPLE);
+    Py_DECREF(copy); /* the export holds its own reference */
+    return result;
 }
 
+/*
+ * Wrap a freshly decoded certificate in a new cx509 object, bypassing __init__. Consumes view (see
+ * _attach_source) and arena, and frees certificate if we fail.
+ */
 static PyObject *
-cx509___str__(cx509 *self)
+_cx509_from_decoded(Certificate_t *certificate, cx509_arena *arena, const cert_spans_t *spans, Py_buffer *view, size_t consumed, int zero_copy)
 {
-    size_t count = 0;
-    void *allocated, *output;
-    PyObject *s = NULL;
+    cx509 *obj;
 
-    if (!self->certificate) {
-	PyErr_Format(PyExc_ValueError, "empty certificate");
+    obj = (cx509 *) cx509Type.tp_alloc(&cx509Type, 0);
+    if (!obj || _attach_source(obj, view, consumed, zero_copy) < 0) {
+	PyBuffer_Release(view);
+	Py_XDECREF(obj);
+	_free_certificate(certificate, arena);
 	return NULL;
     }
+    obj->certificate = certificate;
+    obj->arena = *arena;
+    memset(arena, 0, sizeof(*arena));
+    obj->spans = *spans;
+    return (PyObject *) obj;
+}
 
-    /* just count the number of bytes in the output */
-    if (asn_DEF_Certificate.print_struct(&asn_DEF_Certificate, self->certificate, 1, _print2count, (void *) &count))
-	return NULL;
+/*
+ * Map a format name to its decoder; sets ValueError and returns NULL if unknown. PEM is BER under
+ * base64 armor, so it maps to ber_decode with *pem set.
+ */
+static decoder_f
+_decoder_for_format(const char *format, int *pem)
+{
+    *pem = 0;
+    if (format && (!strcmp(format, "pem") || !strcmp(format, "PEM"))) {
+	*pem = 1;
+	return ber_decode;
+    }
+    if (format == NULL || 
+	!strcmp(format, "ber") || !strcmp(format, "BER") ||
+	!strcmp(format, "cer") || !strcmp(format, "CER") ||
+	!strcmp(format, "der") || !strcmp(format, "DER"))
+	return ber_decode;
+    if (!strcmp(format, "xer") || !strcmp(format, "XER"))
+	return xer_decode;
+    PyErr_Format(PyExc_ValueError, "unknown format");
+    return NULL;
+}
 
-    /* allocate and print to allocated buffer */
-    allocated = output = PyMem_Malloc(count);
+/*
+ * Decode a certificate into arena (unless the arena is disabled) and, for BER input, locate its
+ * components within data; pure C, so callers may release the GIL around it.
+ */
+static Certificate_t *
+_decode_certificate(decoder_f decode, const void *data, size_t len, cert_spans_t *spans, asn_dec_rval_t *rval, cx509_arena *arena)
+{
+    Certificate_t *certificate = NULL;
+    cx509_arena *previous_arena = current_arena;
+    arena_mark mark;
 
-    /* write the output */
-    if (asn_DEF_Certificate.print_struct(&asn_DEF_Certificate, self->certificate, 1, _print2buffer, (void *) &output)) {
-	PyMem_Free(output);
-	return NULL;
+    if (arena_enabled) {
+	if (!arena->head)
+	    arena->hint = ARENA_ROUND(len * ARENA_BYTES_PER_INPUT_BYTE);
+	mark = _arena_mark(arena);
+	current_arena = arena;
     }
+    else
+	current_arena = NULL;
 
-    s = PyString_FromStringAndSize(allocated, count);
-    PyMem_Free(allocated);
-    return s;
+    memset(spans, 0, sizeof(*spans));
+    *rval = decode(0, &asn_DEF_Certificate, (void **) &certificate, data, len);
+    if (rval->code != RC_OK) {
+	/* Free partially decoded certificate */
+	if (current_arena)
+	    _arena_rewind(arena, mark);
+	else
+	    asn_DEF_Certificate.free_struct(&asn_DEF_Certificate, certificate, 0);
+	certificate = NULL;
+    }
+    else if (decode == ber_decode)
+	_locate_spans((const uint8_t *) data, rval->consumed, spans);
+
+    current_arena = previous_arena;
+    return certificate;
 }
 
-static PyObject *
-cx509_get_version(cx509 *self)
-{
-    Version_t *version;
-    long v = 0;
+/*
+ * Decode budgets. The asn1c decoders have no limits of their own beyond the input size, so a deeply
+ * nested or enormous encoding can tie up a thread for as long as it likes. _parse, parse_many and
+ * the nested decodes of extensions() and get_public_key() take optional limits on the input size,
+ * the nesting depth and number of BER elements, and the time taken. Size, depth and element count
+ * are checked by a scan of the encoding's headers before the decoder sees it; time is checked in
+ * the scan and, through the allocator (which the decoders call for every element), while decoding.
+ * A decode over budget fails, and the caller raises BudgetExceeded.
+ */
+static PyObject *BudgetExceeded;
+static const char *budget_names[] = { NULL, "max_size", "max_depth", "max_elements", "max_ns" };
 
-    if (!self->certificate) {
-	PyErr_Format(PyExc_ValueError, "empty certificate");
-	return NULL;
+/* ValueError unless limits are valid */
+static int
+_limits_check(const decode_limits *limits)
+{
+    if (limits->max_size < 0 || limits->max_depth < 0 || limits->max_elements < 0 || limits->max_ns < 0) {
+	PyErr_Format(PyExc_ValueError, "decode limits must not be negative");
+	return -1;
     }
-
-    version = self->certificate->tbsCertificate.version;
-    if (version) {
-	if (asn_INTEGER2long(version, &v) != 0) {
-	    PyErr_Format(PyExc_ValueError, "%s", strerror(errno));
-	    return NULL;
-	}
+    if (limits->max_depth > BUDGET_MAX_DEPTH) {
+	PyErr_Format(PyExc_ValueError, "max_depth must be at most %d", BUDGET_MAX_DEPTH);
+	return -1;
     }
+    return 0;
+}
 
-    return PyInt_FromLong(v);
+static void
+_budget_error(int exceeded)
+{
+    PyErr_Format(BudgetExceeded, "decode budget exceeded: %s", budget_names[exceeded]);
 }
 
-/* 
- * Return validity as (start_time, end_time); times are ASN.1 GeneralizedTime stamps; either
- * YYYYMMDDHHMMSS.fff or YYYYMMDDHHMMSS.fffZ. We add the initial two YY values in the UTCTime case.
+/*
+ * Walk the headers of the BER element at the start of buf in order, stepping into constructed
+ * elements and over primitive ones, and count elements and depth against budget. Nesting deeper
+ * than BUDGET_MAX_DEPTH is over budget whatever the limits. Stops quietly at anything malformed,
+ * which the decoder will reject on its own.
  */
-static PyObject *
-cx509_get_validity(cx509 *self)
+static void
+_budget_scan(const uint8_t *buf, size_t size, decode_budget *budget)
 {
-    TBSCertificate_t tbsCertificate;
-    unsigned char *buf;
-    size_t size;
-    int allocated;
-    PyObject *tuple;
+    size_t ends[BUDGET_MAX_DEPTH];	/* end of each open element, or 0 if its length is indefinite */
+    size_t offset = 0, i, length, elements = 0;
+    int depth = 0, n, indefinite;
 
-    if (!self->certificate) {
-	PyErr_Format(PyExc_ValueError, "empty certificate");
-	return NULL;
-    }
+    while (1) {
+	/* close the definite-length elements that end here */
+	while (depth > 0 && ends[depth - 1] && offset >= ends[depth - 1])
+	    depth--;
+	if (depth == 0 && offset > 0)
+	    return;
+	if (size - offset < 2)
+	    return;
 
-    tuple = PyTuple_New(2);
-    tbsCertificate = self->certificate->tbsCertificate;
+	if (!buf[offset] && !buf[offset + 1]) {
+	    /* end-of-contents closes an indefinite-length element */
+	    if (depth == 0 || ends[depth - 1])
+		return;
+	    depth--;
+	    offset += 2;
+	    continue;
+	}
 
-#define GET_TIMESTAMP(N, field) do {							\
-    if (tbsCertificate.validity. field .present == Time_PR_utcTime) {			\
-	size = (size_t) tbsCertificate.validity. field .choice.utcTime.size + 2;	\
-	buf = PyMem_Malloc(size);							\
-	allocated = 1;									\
-	memcpy(&buf[2], tbsCertificate.validity . field .choice.utcTime.buf, size - 2); \
-	if (buf[2] > '5') {								\
-	    buf[0] = '1';								\
-	    buf[1] = '9';								\
-	}										\
-	else {										\
-	    buf[0] = '2';								\
-	    buf[1] = '0';								\
-	}										\
-    }											\
-    else if (tbsCertificate.validity. field .present == Time_PR_generalTime) {		\
-	buf = tbsCertificate.validity. field .choice.generalTime.buf;			\
-	size = (size_t) tbsCertificate.validity. field .choice.generalTime.size; 	\
-	allocated = 0;									\
-    }											\
-    else {										\
-	buf = NULL;									\
-	size = (size_t) 0;								\
-	allocated = 0;									\
-    }											\
-    if (buf) 										\
-        PyTuple_SetItem(tuple, N, PyString_FromStringAndSize((void *) buf, size)); 	\
-    if (allocated)									\
-	PyMem_Free(buf);								\
-} while (0)
+	i = offset + 1;
+	if ((buf[offset] & 0x1f) == 0x1f)
+	    while (i < size && (buf[i++] & 0x80))
+		;
+	if (i >= size)
+	    return;
+	indefinite = buf[i] == 0x80;
+	if (buf[i] & 0x80) {
+	    n = buf[i++] & 0x7f;
+	    if (n > (int) sizeof(size_t) || (size_t) n > size - i)
+		return;
+	    for (length = 0; n > 0; n--)
+		length = (length << 8) | buf[i++];
+	}
+	else
+	    length = buf[i++];
+	if (!indefinite && length > size - i)
+	    return;
 
-    GET_TIMESTAMP(0, notBefore);
-    GET_TIMESTAMP(1, notAfter);
+	elements++;
+	if (budget->limits.max_elements && elements > (size_t) budget->limits.max_elements) {
+	    budget->exceeded = BUDGET_ELEMENTS;
+	    return;
+	}
+	if (budget->limits.max_depth && depth >= budget->limits.max_depth) {
+	    budget->exceeded = BUDGET_DEPTH;
+	    return;
+	}
+	if (budget->deadline && !(elements & 1023) && _now_ns() > budget->deadline) {
+	    budget->exceeded = BUDGET_NS;
+	    return;
+	}
 
-    return tuple;
+	if (buf[offset] & 0x20) {
+	    if (depth == BUDGET_MAX_DEPTH) {
+		/* we can't count what lies deeper, so under any budget it's too deep */
+		budget->exceeded = BUDGET_DEPTH;
+		return;
+	    }
+	    ends[depth++] = indefinite ? 0 : i + length;
+	    offset = i;
+	}
+	else if (indefinite)
+	    return;
+	else
+	    offset = i + length;
+    }
 }
 
-static PyObject *
-cx509_get_issuer(cx509 *self)
+/* start a decode of len bytes at data under budget->limits; -1 if it is over budget already */
+static int
+_budget_start(decode_budget *budget, const void *data, size_t len, int ber)
 {
-    TBSCertificate_t tbsCertificate;
-    PyObject *dict;
+    budget->exceeded = BUDGET_OK;
+    budget->ticks = 0;
+    budget->deadline = budget->limits.max_ns ? _now_ns() + (uint64_t) budget->limits.max_ns : 0;
+    if (budget->limits.max_size && len > (size_t) budget->limits.max_size)
+	budget->exceeded = BUDGET_SIZE;
+    else if (ber && (budget->limits.max_depth || budget->limits.max_elements || budget->deadline))
+	_budget_scan((const uint8_t *) data, len, budget);
+    return budget->exceeded ? -1 : 0;
+}
 
-    if (!self->certificate) {
-	PyErr_Format(PyExc_ValueError, "empty certificate");
-	return NULL;
-    }
-
-    dict = PyDict_New();
-    tbsCertificate = self->certificate->tbsCertificate;
-    if (tbsCertificate.issuer.present == Name_PR_rdnSequence)
-	_populate_dict_from_rdn_sequence(dict, &tbsCertificate.issuer.choice.rdnSequence);
-    return dict;
+/* called by the allocator during a decode with a deadline; -1 (and the allocation fails) once it passes */
+static int
+_budget_tick(decode_budget *budget)
+{
+    if (!budget->exceeded && !(++budget->ticks & 15) && _now_ns() > budget->deadline)
+	budget->exceeded = BUDGET_NS;
+    return budget->exceeded ? -1 : 0;
 }
 
-static PyObject *
-cx509_get_subject(cx509 *self)
+/*
+ * _decode_certificate, or _decode_projection if wanted >= 0, under budget; pure C, like them. Depth
+ * and element limits come from the BER header scan, so XER decodes are bounded by size and time only.
+ * budget->exceeded says which limit stopped the decode, if one did.
+ */
+static Certificate_t *
+_decode_limited(decoder_f decode, const void *data, size_t len, int wanted, cert_spans_t *spans, asn_dec_rval_t *rval, cx509_arena *arena, int *missing, decode_budget *budget)
 {
-    TBSCertificate_t tbsCertificate;
-    PyObject *dict;
+    decode_budget *previous_budget = current_budget;
+    Certificate_t *certificate;
 
-    if (!self->certificate) {
-	PyErr_Format(PyExc_ValueError, "empty certificate");
+    if (_budget_start(budget, data, len, decode == ber_decode) < 0) {
+	memset(spans, 0, sizeof(*spans));
+	rval->code = RC_FAIL;
+	rval->consumed = 0;
 	return NULL;
     }
-
-    dict = PyDict_New();
-    tbsCertificate = self->certificate->tbsCertificate;
-    if (tbsCertificate.subject.present == Name_PR_rdnSequence)
-	_populate_dict_from_rdn_sequence(dict, &tbsCertificate.subject.choice.rdnSequence);
-    return dict;
+    current_budget = budget->deadline ? budget : NULL;
+    if (wanted >= 0)
+	certificate = _decode_projection(data, len, wanted, spans, rval, arena, missing);
+    else
+	certificate = _decode_certificate(decode, data, len, spans, rval, arena);
+    current_budget = previous_budget;
+    return certificate;
 }
 
-static void
-_populate_dict_from_rdn_sequence(PyObject *dict, RDNSequence_t *rdnSequence)
+/*
+ * A ber_decode of a value nested within a certificate (an extension value, say), under limits and
+ * counted under stats site. Sets *exceeded if a limit stopped it.
+ */
+static asn_dec_rval_t
+_nested_decode(const decode_limits *limits, int site, asn_TYPE_descriptor_t *td, void **ptr, const void *buf, size_t size, int *exceeded)
 {
-    AttributeTypeAndValue_t *atv;
-    char *atype = NULL;
-    int i, j;
-    const char *name;
+    decode_budget budget, *previous_budget = current_budget;
+    asn_dec_rval_t rval;
+    uint64_t start = 0;
 
-    for (i = 0; i < rdnSequence->list.count; i++) {
-	for (j = 0; j < rdnSequence->list.array[i]->list.count; j++) {
-	    atv = rdnSequence->list.array[i]->list.array[j];
-	    atype = _oid_to_string(&atv->type);
-	    name = find_oid(atype, /*shortname:*/ 0);
-	    _add_directory_string_to_dict(&atv->value, dict, name ? name : atype, atype);
-	    if (atype)
-		PyMem_Free(atype);
-	}
+    STAT_START(site, start);
+    rval.code = RC_FAIL;
+    rval.consumed = 0;
+    budget.limits = *limits;
+    if (_budget_start(&budget, buf, size, 1) == 0) {
+	current_budget = budget.deadline ? &budget : NULL;
+	rval = ber_decode(0, td, ptr, buf, size);
+	current_budget = previous_budget;
     }
+    if (budget.exceeded)
+	*exceeded = budget.exceeded;
+    STAT_DONE(site, start, size, rval.code);
+    return rval;
 }
 
-static void
-_add_directory_string_to_dict(ANY_t *any, PyObject *dict, const char *key_name, const char *dotted)
+/* one TLV within a BER buffer */
+typedef struct {
+    size_t offset;	/* of the first tag octet */
+    size_t header;	/* number of tag and length octets */
+    size_t length;	/* of the whole TLV, including end-of-contents octets if any */
+    ber_tlv_tag_t tag;
+    int constructed;
+} tlv_t;
+
+/* find the TLV at offset, which must lie entirely before end; returns -1 if it is malformed */
+static int
+_tlv_at(const uint8_t *buf, size_t end, size_t offset, tlv_t *tlv)
 {
-    PyObject *value;
-    DirectoryString_t *ds = NULL;
-    IA5String_t *ia5 = NULL;
-    VisibleString_t *vs = NULL;
-    NumericString_t *ns = NULL;
-    char encoding[16];	
-    char *encoding_key_name;
-    char *oid_key_name;
+    ber_tlv_len_t vlen;
+    ssize_t tl, ll, skip;
 
-#define ADD do {									\
-    /* add key/value */									\
-    PyDict_SetItemString(dict, key_name, value);					\
-    Py_DECREF(value);									\
-    /* add encoding */									\
-    value = PyString_FromString(encoding);						\
-    encoding_key_name = PyMem_Malloc(strlen(key_name) + strlen(":encoding") + 1);	\
-    strcpy(encoding_key_name, key_name);						\
-    strcat(encoding_key_name, ":encoding");						\
-    PyDict_SetItemString(dict, encoding_key_name, value);				\
-    PyMem_Free(encoding_key_name);							\
-    Py_DECREF(value);									\
-    /* add oid string */								\
-    value = PyString_FromString(dotted);						\
-    oid_key_name = PyMem_Malloc(strlen(key_name) + strlen(":oid") + 1);			\
-    strcpy(oid_key_name, key_name);							\
-    strcat(oid_key_name, ":oid");							\
-    PyDict_SetItemString(dict, oid_key_name, value);					\
-    PyMem_Free(oid_key_name);								\
-    Py_DECREF(value);									\
+    if (offset >= end)
+	return -1;
+    tl = ber_fetch_tag(buf + offset, end - offset, &tlv->tag);
+    if (tl <= 0)
+	return -1;
+    tlv->constructed = BER_TLV_CONSTRUCTED(&buf[offset]); /* the macro doesn't parenthesize its argument */
+    ll = ber_fetch_length(tlv->constructed, buf + offset + tl, end - offset - tl, &vlen);
+    if (ll <= 0)
+	return -1;
+    /* this also walks indefinite-length contents to find the end-of-contents octets */
+    skip = ber_skip_length(0, tlv->constructed, buf + offset + tl, end - offset - tl);
+    if (skip <= 0)
+	return -1;
+    tlv->offset = offset;
+    tlv->header = tl + ll;
+    tlv->length = tl + skip;
+    return 0;
+}
+
+/* first child of a constructed TLV */
+#define TLV_FIRST(buf, parent, child) \
+    _tlv_at(buf, (parent)->offset + (parent)->length, (parent)->offset + (parent)->header, child)
+
+/* next sibling of a TLV within its parent */
+#define TLV_NEXT(buf, parent, child) \
+    _tlv_at(buf, (parent)->offset + (parent)->length, (child)->offset + (child)->length, child)
+
+#define SET_SPAN(span, off, len) do { (span).offset = (Py_ssize_t) (off); (span).length = (Py_ssize_t) (len); } while (0)
+
+/* set span to the contents of a primitive BIT STRING, skipping the unused-bits octet */
+#define SET_BIT_STRING_SPAN(span, tlv) do {					\
+    if (!(tlv).constructed && (tlv).length > (tlv).header)			\
+	SET_SPAN(span, (tlv).offset + (tlv).header + 1, (tlv).length - (tlv).header - 1); \
 } while (0)
 
-    if (!ANY_to_type(any, &asn_DEF_DirectoryString, (void *) &ds) && ds) {
-	value = _directory_string_to_string(ds, encoding);
-	if (value)
-	    ADD;
-	asn_DEF_DirectoryString.free_struct(&asn_DEF_DirectoryString, (void *) ds, 0);
-    }
-    else if (!ANY_to_type(any, &asn_DEF_IA5String, (void *) &ia5) && ia5) {
-	strcpy(encoding, "ia5");
-	value = PyString_FromStringAndSize((void *) ia5->buf, (size_t) ia5->size);
-	if (value)
-	    ADD;
-	asn_DEF_IA5String.free_struct(&asn_DEF_IA5String, (void *) ia5, 0);
-    }
-    else if (!ANY_to_type(any, &asn_DEF_VisibleString, (void *) &vs) && vs) {
-	/*
-	 * This type represents a character string with the alphabet which is more or less a subset
-	 * of ASCII between the space and the ''~'' symbol (tilde).
-	 */
-	strcpy(encoding, "ascii");
-	value = PyString_FromStringAndSize((void *) vs->buf, (size_t) vs->size);
-	if (value)
-	    ADD;
-	asn_DEF_VisibleString.free_struct(&asn_DEF_VisibleString, (void *) vs, 0);
-    }
-    else if (!ANY_to_type(any, &asn_DEF_NumericString, (void *) &ns) && ns) {
-	/* 
-	 * This type represents a character string with the alphabet consisting of numbers (''0'' to
-	 * ''9'') and a space.
-	 */
-	strcpy(encoding, "ascii");
-	value = PyString_FromStringAndSize((void *) ns->buf, (size_t) ns->size);
-	if (value)
-	    ADD;
-	asn_DEF_NumericString.free_struct(&asn_DEF_NumericString, (void *) ns, 0);
-    }
+/*
+ * Walk the outer TLVs of an encoded Certificate (which the decoder has already accepted) and record
+ * where its components are, so we can return the original bytes rather than re-encoding them.
+ * Anything we can't find is left with length 0.
+ */
+static void
+_locate_spans(const uint8_t *buf, size_t size, cert_spans_t *spans)
+{
+    tlv_t cert, tbs, tmp, field, spki;
+    int i;
+
+    memset(spans, 0, sizeof(*spans));
+    if (_tlv_at(buf, size, 0, &cert) < 0)
+	return;
+    SET_SPAN(spans->certificate, cert.offset, cert.length);
+
+    /* Certificate ::= SEQUENCE { tbsCertificate, signatureAlgorithm, signature } */
+    if (TLV_FIRST(buf, &cert, &tbs) < 0)
+	return;
+    SET_SPAN(spans->tbs, tbs.offset, tbs.length);
+    tmp = tbs;
+    if (TLV_NEXT(buf, &cert, &tmp) < 0)
+	return;
+    SET_SPAN(spans->signature_algorithm, tmp.offset, tmp.length);
+    if (TLV_NEXT(buf, &cert, &tmp) < 0)
+	return;
+    SET_BIT_STRING_SPAN(spans->signature, tmp);
+
+    /*
+     * TBSCertificate ::= SEQUENCE { version [0] OPTIONAL, serialNumber, signature, issuer, validity,
+     * subject, subjectPublicKeyInfo, ... }
+     */
+    if (TLV_FIRST(buf, &tbs, &field) < 0)
+	return;
+    if (field.tag == (ber_tlv_tag_t) ((0 << 2) | ASN_TAG_CLASS_CONTEXT) && TLV_NEXT(buf, &tbs, &field) < 0)
+	return;
+    for (i = 0; i < 2; i++) /* skip serialNumber and signature */
+	if (TLV_NEXT(buf, &tbs, &field) < 0)
+	    return;
+    SET_SPAN(spans->issuer, field.offset, field.length);
+    for (i = 0; i < 2; i++) /* skip validity */
+	if (TLV_NEXT(buf, &tbs, &field) < 0)
+	    return;
+    SET_SPAN(spans->subject, field.offset, field.length);
+    if (TLV_NEXT(buf, &tbs, &field) < 0)
+	return;
+    spki = field;
+    SET_SPAN(spans->spki, spki.offset, spki.length);
+
+    /* SubjectPublicKeyInfo ::= SEQUENCE { algorithm, subjectPublicKey } */
+    if (TLV_FIRST(buf, &spki, &tmp) < 0 || TLV_NEXT(buf, &spki, &tmp) < 0)
+	return;
+    SET_BIT_STRING_SPAN(spans->key, tmp);
 }
 
 /*
- * From RFC 3280:
- *
- *   This specification requires only a subset of the name comparison functionality specified in the
- *   X.500 series of specifications.  Conforming implementations are REQUIRED to implement the
- *   following name comparison rules:
- *
- *      (a) attribute values encoded in different types (e.g., PrintableString and BMPString) MAY be
- *      assumed to represent different strings;
- *
- *      (b) attribute values in types other than PrintableString are case sensitive (this permits
- *      matching of attribute values as binary objects);
- *
- *      (c) attribute values in PrintableString are not case sensitive (e.g., "Marianne Swanson" is
- *      the same as "MARIANNE SWANSON"); and
- *
- *      (d) attribute values in PrintableString are compared after removing leading and trailing
- *      white space and converting internal substrings of one or more consecutive white space
- *      characters to a single space.
- *
- *   These name comparison rules permit a certificate user to validate certificates issued using
- *   languages or encodings unfamiliar to the certificate user.
- *
- * What this means for us:
- *
- * - we need to return both the string contents and the encoding for each string
- * - we need to normalize PrintableString values as noted above
+ * Projected parses. cx509(data, fields=...) decodes only the top-level components ("parts") of the
+ * certificate that the named fields need, each straight from its TLV, and skips the others by their
+ * lengths; the getters decode whatever else they need from the source on first use (see _need), so
+ * they behave as they do after a full parse. A part that turns out to be malformed makes the getter
+ * that needs it raise ValueError, where a full parse would have left the object empty.
  */
-static PyObject *
-_directory_string_to_string(DirectoryString_t *ds, char encoding[16])
+enum {
+    PART_VERSION, PART_SERIAL_NUMBER, PART_TBS_SIGNATURE, PART_ISSUER, PART_VALIDITY, PART_SUBJECT,
+    PART_PUBLIC_KEY, PART_ISSUER_UID, PART_SUBJECT_UID, PART_EXTENSIONS, PART_SIGNATURE_ALGORITHM,
+    PART_SIGNATURE, PART_COUNT
+};
+#define PART(part) (1 << (part))
+#define PARTS_ALL (PART(PART_COUNT) - 1)
+
+/* a member of Certificate_t: its offset and size */
+#define MEMBER(field) offsetof(Certificate_t, field), sizeof(((Certificate_t *) 0)->field)
+
+static const struct {
+    const char *name;
+    asn_TYPE_descriptor_t *type;
+    size_t offset;		/* of the member within Certificate_t */
+    size_t size;
+    int pointer;		/* the member is an OPTIONAL pointer */
+    int tag_mode;		/* -1 for IMPLICIT tags, as asn1c's member decoders use; EXPLICIT ones are unwrapped first */
+} parts[PART_COUNT] = {
+    { "version", &asn_DEF_Version, MEMBER(tbsCertificate.version), 1, 0 },
+    { "serialNumber", &asn_DEF_CertificateSerialNumber, MEMBER(tbsCertificate.serialNumber), 0, 0 },
+    { "signature", &asn_DEF_AlgorithmIdentifier, MEMBER(tbsCertificate.signature), 0, 0 },
+    { "issuer", &asn_DEF_Name, MEMBER(tbsCertificate.issuer), 0, 0 },
+    { "validity", &asn_DEF_Validity, MEMBER(tbsCertificate.validity), 0, 0 },
+    { "subject", &asn_DEF_Name, MEMBER(tbsCertificate.subject), 0, 0 },
+    { "subjectPublicKeyInfo", &asn_DEF_SubjectPublicKeyInfo, MEMBER(tbsCertificate.subjectPublicKeyInfo), 0, 0 },
+    { "issuerUniqueID", &asn_DEF_UniqueIdentifier, MEMBER(tbsCertificate.issuerUniqueID), 1, -1 },
+    { "subjectUniqueID", &asn_DEF_UniqueIdentifier, MEMBER(tbsCertificate.subjectUniqueID), 1, -1 },
+    { "extensions", &asn_DEF_Extensions, MEMBER(tbsCertificate.extensions), 1, 0 },
+    { "signatureAlgorithm", &asn_DEF_AlgorithmIdentifier, MEMBER(signatureAlgorithm), 0, 0 },
+    { "signature", &asn_DEF_BIT_STRING, MEMBER(signature), 0, 0 },
+};
+
+/* the names fields= accepts, and the parts each needs */
+static const struct {
+    const char *name;
+    int parts;
+} projection_fields[] = {
+    { "version", PART(PART_VERSION) },
+    { "serial_number", PART(PART_SERIAL_NUMBER) },
+    { "issuer", PART(PART_ISSUER) },
+    { "validity", PART(PART_VALIDITY) },
+    { "subject", PART(PART_SUBJECT) },
+    { "public_key", PART(PART_PUBLIC_KEY) },
+    { "extensions", PART(PART_EXTENSIONS) },
+    { "san", PART(PART_EXTENSIONS) },
+    { "signature_algorithm", PART(PART_SIGNATURE_ALGORITHM) },
+    { "signature", PART(PART_SIGNATURE) },
+    { NULL, 0 }
+};
+
+/*
+ * Find the TLV of each part of the encoded Certificate at the start of buf, setting the length of
+ * absent OPTIONAL ones to 0. EXPLICIT tags (version and extensions) are unwrapped. Sets *length to
+ * that of the whole Certificate; returns -1 if the framing is malformed.
+ */
+static int
+_locate_parts(const uint8_t *buf, size_t size, tlv_t tlvs[PART_COUNT], size_t *length)
 {
-    PyObject *retval = NULL;
-    const char *from;
-    char *allocated = NULL, *to;
+    tlv_t cert, tbs, field, outer;
+    int i, more = 0, next = PART_ISSUER_UID;
 
-    if (ds->present == DirectoryString_PR_printableString) {
-	/*
-	 * According to RFC 4517, PrintableString matches:
-	 *
-	 *   [A-Za-z0-9'()+,.=/:? -]+
-	 *
-	 * so we can just set the encoding to ascii here after doing the appropriate normalization.
-	 */
-	allocated = to = PyMem_Malloc(strlen((void *) ds->choice.printableString.buf) + 1);
-	for (from = (const char *) ds->choice.printableString.buf; isspace(*from); ++from)
-	    ; /* skip initial whitespace */
-	for (; *from; ++from)
-	    switch (*from) {
-		case ' ':
-		case '\t':
-		case '\r':
-		case '\n':
-		    /* convert sequence of white space to single space */
-		    while (1) {
-			switch (*from) {
-			    case ' ':
-			    case '\t':
-			    case '\r':
-			    case '\n':
-				++from;
-				break;
-			    default:
-				--from;
-				goto NonWS;
-			}
-		    }
-		NonWS: *to++ = ' ';
-		    break;
+    memset(tlvs, 0, PART_COUNT * sizeof(tlv_t));
+    if (_tlv_at(buf, size, 0, &cert) < 0 || !cert.constructed || TLV_FIRST(buf, &cert, &tbs) < 0 || !tbs.constructed)
+	return -1;
+    *length = cert.length;
 
-		case 'a': case 'b': case 'c': case 'd': case 'e': case 'f': case 'g': case 'h': case 'i': case 'j': case 'k': case 'l': case 'm': 
-		case 'n': case 'o': case 'p': case 'q': case 'r': case 's': case 't': case 'u': case 'v': case 'w': case 'x': case 'y': case 'z':
-		case 'A': case 'B': case 'C': case 'D': case 'E': case 'F': case 'G': case 'H': case 'I': case 'J': case 'K': case 'L': case 'M': 
-		case 'N': case 'O': case 'P': case 'Q': case 'R': case 'S': case 'T': case 'U': case 'V': case 'W': case 'X': case 'Y': case 'Z':
-		    /* 
-		     * NOTE: I don't convert case here, because it seems better to preserve it for
-		     * display purposes, but it's essential to do that when comparing for name
-		     * equality.
-		     */
-		case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
-		case '(': case ')': case '+': case ',': case '.': case '=': case '/': case ':': case '?': case '-':
-		case '\'':
-		    /* other characters we allow, despite the spec: */
-		case '@':
-		    *to++ = *from;
-		    break;
+    /* Certificate ::= SEQUENCE { tbsCertificate, signatureAlgorithm, signature } */
+    tlvs[PART_SIGNATURE_ALGORITHM] = tbs;
+    if (TLV_NEXT(buf, &cert, &tlvs[PART_SIGNATURE_ALGORITHM]) < 0)
+	return -1;
+    tlvs[PART_SIGNATURE] = tlvs[PART_SIGNATURE_ALGORITHM];
+    if (TLV_NEXT(buf, &cert, &tlvs[PART_SIGNATURE]) < 0)
+	return -1;
+    outer = tlvs[PART_SIGNATURE];
+    if (TLV_NEXT(buf, &cert, &outer) == 0)
+	return -1;
 
-		default:
-		    /* illegal char - replace with asterisk */
-		    *to++ = '*';
-		    break;
-	    }	
-	if (to != allocated && to[-1] == ' ')
-	    to[-1] = '\0'; /* strip trailing whitespace and null-terminate */
-	else
-	    *to = '\0'; /* null-terminate */
-	strcpy(encoding, "ascii");
-	retval = PyString_FromString(allocated);
-    }
-    else if (ds->present == DirectoryString_PR_utf8String) {
-	strcpy(encoding, "utf8");
-	retval = PyString_FromStringAndSize((void *) ds->choice.utf8String.buf, (size_t) ds->choice.utf8String.size);
+    /*
+     * TBSCertificate ::= SEQUENCE { version [0] EXPLICIT OPTIONAL, serialNumber, signature, issuer,
+     * validity, subject, subjectPublicKeyInfo, issuerUniqueID [1] IMPLICIT OPTIONAL,
+     * subjectUniqueID [2] IMPLICIT OPTIONAL, extensions [3] EXPLICIT OPTIONAL }
+     */
+    if (TLV_FIRST(buf, &tbs, &field) < 0)
+	return -1;
+    if (field.tag == (ber_tlv_tag_t) ((0 << 2) | ASN_TAG_CLASS_CONTEXT)) {
+	if (!field.constructed || TLV_FIRST(buf, &field, &tlvs[PART_VERSION]) < 0 || TLV_NEXT(buf, &tbs, &field) < 0)
+	    return -1;
     }
-    else if (ds->present == DirectoryString_PR_teletexString) {
-	/* obsolete, but still used (e.g., by Google) */
-	strcpy(encoding, "x500-teletex");
-	retval = PyString_FromStringAndSize((void *) ds->choice.teletexString.buf, (size_t) ds->choice.teletexString.size);
-    }
-    else if (ds->present == DirectoryString_PR_universalString) {
-	/* obsolete */
-	strcpy(encoding, "x500-universal");
-	retval = PyString_FromStringAndSize((void *) ds->choice.universalString.buf, (size_t) ds->choice.universalString.size);
+    for (i = PART_SERIAL_NUMBER; i <= PART_PUBLIC_KEY; i++) {
+	tlvs[i] = field;
+	more = TLV_NEXT(buf, &tbs, &field) == 0;
+	if (!more && i < PART_PUBLIC_KEY)
+	    return -1;
     }
-    else if (ds->present == DirectoryString_PR_bmpString) {
-	/* obsolete */
-	strcpy(encoding, "x500-bmp");
-	retval = PyString_FromStringAndSize((void *) ds->choice.bmpString.buf, (size_t) ds->choice.bmpString.size);
+    while (more) {
+	/* the optional trailing parts, each at most once and in order */
+	for (i = next; i <= PART_EXTENSIONS; i++)
+	    if (field.tag == (ber_tlv_tag_t) (((i - PART_ISSUER_UID + 1) << 2) | ASN_TAG_CLASS_CONTEXT))
+		break;
+	if (i > PART_EXTENSIONS)
+	    return -1;
+	if (i == PART_EXTENSIONS) {
+	    if (!field.constructed || TLV_FIRST(buf, &field, &tlvs[i]) < 0)
+		return -1;
+	}
+	else
+	    tlvs[i] = field;
+	next = i + 1;
+	more = TLV_NEXT(buf, &tbs, &field) == 0;
     }
-    else
-	strcpy(encoding, "x500-unknown");
+    return 0;
+}
 
-    if (allocated)
-	PyMem_Free(allocated);
+/* the PART bits of the parts present in tlvs */
+static int
+_present_parts(const tlv_t tlvs[PART_COUNT])
+{
+    int i, present = 0;
 
-    return retval;
+    for (i = 0; i < PART_COUNT; i++)
+	if (tlvs[i].length)
+	    present |= PART(i);
+    return present;
 }
 
-/* get the list of extensions; note that we only parse the ones we understand, but get the critical flag for all, as required */
-static PyObject *
-cx509_extensions(cx509 *self)
+/*
+ * Decode the parts of certificate named by the PART bits in wanted from their TLVs in buf, into
+ * arena (which must be where the rest of the tree lives) or, if that is NULL, with malloc. Returns
+ * -1 if they all decoded, or else the index of the part that didn't, which is left empty; the parts
+ * before it are kept. Pure C, so callers may release the GIL around it.
+ */
+static int
+_decode_parts(Certificate_t *certificate, const uint8_t *buf, const tlv_t tlvs[PART_COUNT], int wanted, cx509_arena *arena)
 {
-    TBSCertificate_t tbsCertificate;
-    struct Extensions *extensions;
-    struct Extension *ext;
-    PyObject *L;
-    PyObject *dict;
-    PyObject *tmp;
+    cx509_arena *previous_arena = current_arena;
+    asn_TYPE_descriptor_t *type;
     asn_dec_rval_t rval;
-    char *oid;
-    const char *extension_name;
-    int i, j;
-    
-    /* extension types we know about: */
-    BasicConstraints_t *basicConstraints = NULL;
-    long basicConstraints_pathlen = 0;
+    arena_mark mark;
+    void *member, **ptr;
+    int i, failed = -1;
 
-    KeyUsage_t *keyUsage = NULL;
-    PyObject *keyUsageFlags = NULL;
+    current_arena = arena;
+    for (i = 0; i < PART_COUNT && failed < 0; i++) {
+	if (!(wanted & PART(i)) || !tlvs[i].length)
+	    continue;
+	type = parts[i].type;
+	member = (char *) certificate + parts[i].offset;
+	ptr = parts[i].pointer ? (void **) member : &member;
+	if (arena)
+	    mark = _arena_mark(arena);
+	rval = type->ber_decoder(0, type, ptr, buf + tlvs[i].offset, tlvs[i].length, parts[i].tag_mode);
+	if (rval.code == RC_OK && rval.consumed == tlvs[i].length)
+	    continue;
 
-    GeneralNames_t *altName = NULL;
-    GeneralName_t *gn = NULL;
-    PyObject *dNSName, *dNSNames;
+	/* give back whatever the decoder got as far as allocating */
+	if (arena)
+	    _arena_rewind(arena, mark);
+	else if (parts[i].pointer)
+	    type->free_struct(type, *ptr, 0);
+	else
+	    type->free_struct(type, member, 1);
+	memset((char *) certificate + parts[i].offset, 0, parts[i].size);
+	failed = i;
+    }
+    current_arena = previous_arena;
+    return failed;
+}
 
-    if (!self->certificate) {
-	PyErr_Format(PyExc_ValueError, "empty certificate");
+/*
+ * Decode just the wanted parts of the Certificate at the start of data (which must be BER), as
+ * _decode_certificate decodes all of it. Sets *missing to the PART bits of the parts present but
+ * not decoded.
+ */
+static Certificate_t *
+_decode_projection(const void *data, size_t len, int wanted, cert_spans_t *spans, asn_dec_rval_t *rval, cx509_arena *arena, int *missing)
+{
+    cx509_arena *previous_arena = current_arena, *use = arena_enabled ? arena : NULL;
+    Certificate_t *certificate;
+    tlv_t tlvs[PART_COUNT];
+    arena_mark mark;
+    size_t length;
+
+    memset(spans, 0, sizeof(*spans));
+    rval->code = RC_FAIL;
+    rval->consumed = 0;
+    if (_locate_parts((const uint8_t *) data, len, tlvs, &length) < 0)
 	return NULL;
+
+    if (use) {
+	if (!arena->head)
+	    arena->hint = ARENA_ROUND(length * ARENA_BYTES_PER_INPUT_BYTE);
+	mark = _arena_mark(arena);
     }
+    current_arena = use;
+    certificate = cx509_arena_calloc(1, sizeof(Certificate_t));
+    current_arena = previous_arena;
+    if (!certificate)
+	return NULL;
 
-    L = PyList_New(0);
+    if (_decode_parts(certificate, (const uint8_t *) data, tlvs, wanted, use) >= 0) {
+	if (use)
+	    _arena_rewind(arena, mark);
+	else
+	    asn_DEF_Certificate.free_struct(&asn_DEF_Certificate, certificate, 0);
+	return NULL;
+    }
 
+    rval->code = RC_OK;
+    rval->consumed = length;
+    _locate_spans((const uint8_t *) data, length, spans);
+    *missing = _present_parts(tlvs) & ~wanted;
+    return certificate;
+}
+
+/* map a fields= sequence to PART bits; returns -1 with an exception set if a name is unknown */
+static int
+_projection_parts(PyObject *fields)
+{
+    PyObject *seq, *item;
+    Py_ssize_t i;
+    int k, wanted = 0;
+
+    if (!(seq = PySequence_Fast(fields, "fields must be a sequence of field names")))
+	return -1;
+    for (i = 0; i < PySequence_Fast_GET_SIZE(seq); i++) {
+	item = PySequence_Fast_GET_ITEM(seq, i);
+	for (k = 0; projection_fields[k].name; k++)
+	    if (PyString_Check(item) && !strcmp(PyString_AS_STRING(item), projection_fields[k].name))
+		break;
+	if (!projection_fields[k].name) {
+	    PyErr_Format(PyExc_ValueError, "unknown field %s", PyString_Check(item) ? PyString_AS_STRING(item) : "(not a string)");
+	    Py_DECREF(seq);
+	    return -1;
+	}
+	wanted |= projection_fields[k].parts;
+    }
+    Py_DECREF(seq);
+    return wanted;
+}
+
+/*
+ * Make sure the parts of self's tree named by the PART bits in wanted are decoded, decoding any a
+ * projected parse skipped. Returns -1 with an exception set if one doesn't decode.
+ */
+static int
+_need(cx509 *self, int wanted)
+{
+    tlv_t tlvs[PART_COUNT];
+    size_t length;
+    int failed;
+
+    if (!(wanted &= self->missing))
+	return 0;
+    if (self->scratch) {
+	/* the getter we were reentered from is using the arena for temporaries */
+	PyErr_Format(PyExc_RuntimeError, "cx509 object is in use by another thread");
+	return -1;
+    }
+    if (_locate_parts((const uint8_t *) self->source.buf + self->spans.certificate.offset,
+		      (size_t) self->spans.certificate.length, tlvs, &length) < 0) {
+	PyErr_Format(PyExc_ValueError, "malformed certificate");
+	return -1;
+    }
+    failed = _decode_parts(self->certificate, (const uint8_t *) self->source.buf + self->spans.certificate.offset, tlvs, wanted,
+			   _arena_owns(&self->arena, self->certificate) ? &self->arena : NULL);
+    if (failed >= 0) {
+	self->missing &= ~(wanted & (PART(failed) - 1));
+	PyErr_Format(PyExc_ValueError, "malformed certificate %s", parts[failed].name);
+	return -1;
+    }
+    self->missing &= ~wanted;
+    return 0;
+}
+
+/* a read-only proxy for dict, consuming it; NULL (passed through) if dict is */
+static PyObject *
+_frozen(PyObject *dict)
+{
+    PyObject *proxy;
+
+    if (!dict)
+	return NULL;
+    proxy = PyDictProxy_New(dict);
+    Py_DECREF(dict);
+    return proxy;
+}
+
+/*
+ * Keep a getter's result in self->memo[slot] until the next _parse, so later calls just return it.
+ * Results are handed out shared, so dicts are kept (and returned) as read-only proxies; the other
+ * results are tuples of immutable values already. Consumes value; returns a new reference to what
+ * is kept, which is an earlier result if another thread got there first while we were decoding.
+ */
+static PyObject *
+_memo(cx509 *self, int slot, PyObject *value)
+{
+    if (value && PyDict_Check(value))
+	value = _frozen(value);
+    if (!value)
+	return NULL;
+    if (self->memo[slot])
+	Py_DECREF(value);
+    else
+	self->memo[slot] = value;
+    Py_INCREF(self->memo[slot]);
+    return self->memo[slot];
+}
+
+/*
+ * Return a read-only memoryview on part of our source buffer. The view is a plain byte view over
+ * a buffer_owner holding its own export on the source object, so it stays valid even if this
+ * object is reparsed or freed, whatever format and shape the source exports itself.
+ */
+static PyObject *
+_span_to_memoryview(cx509 *self, const span_t *span)
+{
+    buffer_owner *owner;
+    Py_buffer view;
+    PyObject *mv;
+
+    owner = PyObject_New(buffer_owner, &buffer_ownerType);
+    if (!owner)
+	return NULL;
+    owner->view.obj = NULL;
+    if (PyObject_GetBuffer(self->source.obj, &owner->view, PyBUF_SIMPLE) < 0 ||
+	PyBuffer_FillInfo(&view, (PyObject *) owner, (char *) owner->view.buf + span->offset, span->length, 1, PyBUF_FULL_RO) < 0) {
+	Py_DECREF(owner);
+	return NULL;
+    }
+    Py_DECREF(owner); /* view holds its own reference */
+    mv = PyMemoryView_FromBuffer(&view);
+    if (!mv)
+	PyBuffer_Release(&view);
+    return mv;
+}
+
+/* count up total number of bytes in string output */
+static int 
+_print2count(const void *buffer, size_t size, void *app_key)
+{
+    *((size_t *) app_key) += size;
+    return 0;
+}
+
+/* copy the string output to the specified output buffer */
+static int 
+_print2buffer(const void *buffer, size_t size, void *app_key)
+{
+    char **output = (char **) app_key;
+    memcpy(*output, buffer, size);
+    *output += size;
+    return 0;
+}
+
+static PyObject *
+cx509___str__(cx509 *self)
+{
+    size_t count = 0;
+    void *output;
+    PyObject *s = NULL;
+    int failed;
+
+    if (!self->certificate) {
+	PyErr_Format(PyExc_ValueError, "empty certificate");
+	return NULL;
+    }
+    if (_need(self, PARTS_ALL) < 0)
+	return NULL;
+
+    /* just count the number of bytes in the output */
+    BEGIN_ALLOW_THREADS(self);
+    failed = asn_DEF_Certificate.print_struct(&asn_DEF_Certificate, self->certificate, 1, _print2count, (void *) &count);
+    END_ALLOW_THREADS(self);
+    if (failed) {
+	PyErr_Format(PyExc_ValueError, "failed to print certificate");
+	return NULL;
+    }
+
+    /* allocate the result string and print straight into it */
+    s = PyString_FromStringAndSize(NULL, count);
+    if (!s)
+	return NULL;
+    output = PyString_AS_STRING(s);
+
+    /* write the output */
+    BEGIN_ALLOW_THREADS(self);
+    failed = asn_DEF_Certificate.print_struct(&asn_DEF_Certificate, self->certificate, 1, _print2buffer, (void *) &output);
+    END_ALLOW_THREADS(self);
+    if (failed) {
+	Py_DECREF(s);
+	PyErr_Format(PyExc_ValueError, "failed to print certificate");
+	return NULL;
+    }
+
+    return s;
+}
+
+static PyObject *
+cx509_get_version(cx509 *self)
+{
+    Version_t *version;
+    long v = 0;
+
+    if (!self->certificate) {
+	PyErr_Format(PyExc_ValueError, "empty certificate");
+	return NULL;
+    }
+    if (_need(self, PART(PART_VERSION)) < 0)
+	return NULL;
+
+    version = self->certificate->tbsCertificate.version;
+    if (version) {
+	if (asn_INTEGER2long(version, &v) != 0) {
+	    PyErr_Format(PyExc_ValueError, "%s", strerror(errno));
+	    return NULL;
+	}
+    }
+
+    return PyInt_FromLong(v);
+}
+
+static PyObject *
+cx509_get_serial_number(cx509 *self)
+{
+    CertificateSerialNumber_t *serial;
+
+    MEMO_RETURN(self, MEMO_SERIAL_NUMBER);
+    if (!self->certificate) {
+	PyErr_Format(PyExc_ValueError, "empty certificate");
+	return NULL;
+    }
+    if (_need(self, PART(PART_SERIAL_NUMBER)) < 0)
+	return NULL;
+
+    serial = &self->certificate->tbsCertificate.serialNumber;
+    if (!serial->buf || !serial->size) {
+	PyErr_Format(PyExc_ValueError, "missing serial number");
+	return NULL;
+    }
+    return _memo(self, MEMO_SERIAL_NUMBER, _integer_to_long(serial->buf, serial->size, 1));
+}
+
+/* 
+ * Return validity as (start_time, end_time); times are ASN.1 GeneralizedTime stamps; either
+ * YYYYMMDDHHMMSS.fff or YYYYMMDDHHMMSS.fffZ. We add the initial two YY values in the UTCTime case.
+ * A missing time is None. See get_validity_epoch() for the times as numbers.
+ */
+static PyObject *
+cx509_get_validity(cx509 *self)
+{
+    TBSCertificate_t tbsCertificate;
+    const Time_t *time;
+    PyObject *tuple, *stamp;
+    char *buf;
+
+    MEMO_RETURN(self, MEMO_VALIDITY);
+    if (!self->certificate) {
+	PyErr_Format(PyExc_ValueError, "empty certificate");
+	return NULL;
+    }
+    if (_need(self, PART(PART_VALIDITY)) < 0)
+	return NULL;
+
+    tuple = PyTuple_New(2);
     tbsCertificate = self->certificate->tbsCertificate;
-    extensions = tbsCertificate.extensions;
-    if (extensions) {
-	for (i = 0; i < extensions->list.count; i++) {
-	    /* reset values we may set below */
-	    basicConstraints = NULL;
-	    basicConstraints_pathlen = 0;
-	    keyUsage = NULL;
-	    keyUsageFlags = NULL;
-	    altName = NULL;
-	    gn = NULL;
-
-	    dict = PyDict_New();
-	    ext = extensions->list.array[i];
-	    oid = _oid_to_string(&ext->extnID);
-
-	    PyDict_SetItemString(dict, "critical", (ext->critical && *ext->critical) ? Py_True : Py_False); /* does not steal reference */
-
-	    /* parse known extensions */
-	    if (oid) {
-		extension_name = find_oid(oid, /*shortname:*/ 0);
-		if (extension_name) {
-		    tmp = PyString_FromString(extension_name);
-		    PyDict_SetItemString(dict, "name", tmp);
-		    Py_DECREF(tmp);
-		}
-		else {
-		    tmp = PyString_FromString(oid);
-		    PyDict_SetItemString(dict, "name", tmp);
-		    Py_DECREF(tmp);
-		}
 
-		if (extension_name) {
-		    if (!strcmp(extension_name, "keyUsage")) {
-			if (ext->extnValue.size) {
-			    rval = ber_decode(0, &asn_DEF_KeyUsage, (void **) &keyUsage, (const void *) ext->extnValue.buf, (size_t) ext->extnValue.size);
-			    if (rval.code == RC_OK && keyUsage) {
-				keyUsageFlags = PyFrozenSet_New(NULL);
-				if (keyUsage->size > 0) {
-				    if (keyUsage->buf[0] & (1 << (7 - KeyUsage_digitalSignature))) {
-					tmp = PyString_FromString("digitalSignature");
-					PySet_Add(keyUsageFlags, tmp);
-					Py_DECREF(tmp);
-				    }
-				    if (keyUsage->buf[0] & (1 << (7 - KeyUsage_nonRepudiation))) {
-					tmp = PyString_FromString("nonRepudiation");
-					PySet_Add(keyUsageFlags, tmp);
-					Py_DECREF(tmp);
-				    }
-				    if (keyUsage->buf[0] & (1 << (7 - KeyUsage_keyEncipherment))) {
-					tmp = PyString_FromString("keyEncipherment");
-					PySet_Add(keyUsageFlags, tmp);
-					Py_DECREF(tmp);
-				    }
-				    if (keyUsage->buf[0] & (1 << (7 - KeyUsage_dataEncipherment))) {
-					tmp = PyString_FromString("dataEncipherment");
-					PySet_Add(keyUsageFlags, tmp);
-					Py_DECREF(tmp);
-				    }
-				    if (keyUsage->buf[0] & (1 << (7 - KeyUsage_keyAgreement))) {
-					tmp = PyString_FromString("keyAgreement");
-					PySet_Add(keyUsageFlags, tmp);
-					Py_DECREF(tmp);
-				    }
-				    if (keyUsage->buf[0] & (1 << (7 - KeyUsage_keyCertSign))) {
-					tmp = PyString_FromString("keyCertSign");
-					PySet_Add(keyUsageFlags, tmp);
-					Py_DECREF(tmp);
-				    }
-				    if (keyUsage->buf[0] & (1 << (7 - KeyUsage_cRLSign))) {
-					tmp = PyString_FromString("cRLSign");
-					PySet_Add(keyUsageFlags, tmp);
-					Py_DECREF(tmp);
-				    }
-				    if (keyUsage->buf[0] & (1 << (7 - KeyUsage_encipherOnly))) {
-					tmp = PyString_FromString("encipherOnly");
-					PySet_Add(keyUsageFlags, tmp);
-					Py_DECREF(tmp);
-				    }
-				}
-				if (keyUsage->size > 1) {
-				    if (keyUsage->buf[1] & (1 << (7 - (KeyUsage_digitalSignature - 8)))) {
-					tmp = PyString_FromString("decipherOnly");
-					PySet_Add(keyUsageFlags, tmp);
-					Py_DECREF(tmp);
-				    }
-				}
-				PyDict_SetItemString(dict, "keyUsage", keyUsageFlags);
-				Py_DECREF(keyUsageFlags);
-			    }
-			    asn_DEF_KeyUsage.free_struct(&asn_DEF_KeyUsage, (void *) keyUsage, 0);
-			}
-		    }
-		    else if (!strcmp(extension_name, "subjectAltName") || !strcmp(extension_name, "issuerAltName")) {
-			/* NOTE: we only check for the dNSName type here; we just ignore the others */
-			if (ext->extnValue.size) {
-			    rval = ber_decode(0, &asn_DEF_GeneralNames, (void **) &altName, (const void *) ext->extnValue.buf, (size_t) ext->extnValue.size);
-			    if (rval.code == RC_OK && altName) {
-				dNSNames = PyFrozenSet_New(NULL);
-				for (j = 0; j < altName->list.count; j++) {
-				    /* TBD: we should handle the domainComponent type here, as required by RFC 5280, section 7.3 */
-				    gn = altName->list.array[j];
-				    if (gn && gn->present == GeneralName_PR_dNSName && gn->choice.dNSName.buf) {
-					dNSName = PyString_FromStringAndSize((void *) gn->choice.dNSName.buf, (size_t) gn->choice.dNSName.size);
-					PySet_Add(dNSNames, dNSName); /* does not steal reference */
-					Py_DECREF(dNSName);
-				    }
-				}
-				if (PySet_Size(dNSNames))
-				    PyDict_SetItemString(dict, "dNSName", dNSNames);
-				Py_DECREF(dNSNames);
-			    }
-			    asn_DEF_GeneralNames.free_struct(&asn_DEF_GeneralNames, (void *) altName, 0);
-			}
-		    }
-		    else if (!strcmp(extension_name, "basicConstraints")) {
-			if (ext->extnValue.size) {
-			    rval = ber_decode(0, &asn_DEF_BasicConstraints, (void **) &basicConstraints, (const void *) ext->extnValue.buf, (size_t) ext->extnValue.size);
-			    if (rval.code == RC_OK && basicConstraints) {
-				PyDict_SetItemString(dict, "cA", (basicConstraints->cA && *basicConstraints->cA) ? Py_True : Py_False); /* does not steal reference */
-				if (!asn_INTEGER2long(basicConstraints->pathLenConstraint, &basicConstraints_pathlen)) {
-				    tmp = PyInt_FromLong(basicConstraints_pathlen);
-				    PyDict_SetItemString(dict, "pathLenConstraint", tmp);
-				    Py_DECREF(tmp);
-				}
-			    }
-			    else
-				printf("failed to parse basicConstraints\n");
-			    asn_DEF_BasicConstraints.free_struct(&asn_DEF_BasicConstraints, (void *) basicConstraints, 0);
-			}
-		    }
-		    else if (!strcmp(extension_name, "nameConstraints")) {
-			/* TBD */
-		    }
-		    else if (!strcmp(extension_name, "cRLDistributionPoints")) {
-			/* TBD */
-		    }
+    /* the UTCTime case is written straight into the result string, after the century: 19 for YY >= 50, as RFC 5280 has it */
+#define GET_TIMESTAMP(N, field) do {							\
+    time = &tbsCertificate.validity. field;						\
+    if (time->present == Time_PR_utcTime && time->choice.utcTime.size > 0) {		\
+	stamp = PyString_FromStringAndSize(NULL, time->choice.utcTime.size + 2);	\
+	if (stamp) {									\
+	    buf = PyString_AS_STRING(stamp);						\
+	    memcpy(&buf[2], time->choice.utcTime.buf, time->choice.utcTime.size);	\
+	    buf[0] = buf[2] >= '5' ? '1' : '2';						\
+	    buf[1] = buf[2] >= '5' ? '9' : '0';						\
+	}										\
+    }											\
+    else if (time->present == Time_PR_generalTime)					\
+	stamp = PyString_FromStringAndSize((char *) time->choice.generalTime.buf,	\
+					   time->choice.generalTime.size);		\
+    else {										\
+	stamp = Py_None;								\
+	Py_INCREF(stamp);								\
+    }											\
+    if (!stamp) {									\
+	Py_DECREF(tuple);								\
+	return NULL;									\
+    }											\
+    PyTuple_SET_ITEM(tuple, N, stamp); /* steals reference */				\
+} while (0)
+
+    if (!tuple)
+	return NULL;
+    GET_TIMESTAMP(0, notBefore);
+    GET_TIMESTAMP(1, notAfter);
+
+    return _memo(self, MEMO_VALIDITY, tuple);
+}
+
+/* days from 1970-01-01 to the given proleptic Gregorian date (Howard Hinnant's days_from_civil) */
+static int64_t
+_days_from_civil(int64_t y, unsigned m, unsigned d)
+{
+    int64_t era;
+    unsigned yoe, doy, doe;
+
+    y -= m <= 2;
+    era = (y >= 0 ? y : y - 399) / 400;
+    yoe = (unsigned) (y - era * 400);
+    doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t) doe - 719468;
+}
+
+/* the value of n decimal digits at p, or -1 if they aren't all digits */
+static int
+_decimal(const uint8_t *p, int n)
+{
+    int value = 0;
+
+    while (n--) {
+	if (*p < '0' || *p > '9')
+	    return -1;
+	value = 10 * value + (*p++ - '0');
+    }
+    return value;
+}
+
+/*
+ * Convert a Time (UTCTime YYMMDDHHMM[SS] or GeneralizedTime YYYYMMDDHHMM[SS][.fff], followed by Z
+ * or a +/-HHMM offset, or by nothing for local time, which we take as UTC) to seconds since the
+ * epoch. UTCTime years from 50 on are 19YY, as RFC 5280 says. Returns -1 if it doesn't parse.
+ */
+static int
+_time_to_epoch(const Time_t *time, int64_t *epoch)
+{
+    const uint8_t *p, *end;
+    int year, month, day, hour, minute, second = 0, offset = 0;
+
+    if (time->present == Time_PR_utcTime) {
+	p = time->choice.utcTime.buf;
+	end = p + time->choice.utcTime.size;
+	if (!p || end - p < 10 || (year = _decimal(p, 2)) < 0)
+	    return -1;
+	year += year >= 50 ? 1900 : 2000;
+	p += 2;
+    }
+    else if (time->present == Time_PR_generalTime) {
+	p = time->choice.generalTime.buf;
+	end = p + time->choice.generalTime.size;
+	if (!p || end - p < 12 || (year = _decimal(p, 4)) < 0)
+	    return -1;
+	p += 4;
+    }
+    else
+	return -1;
+
+    month = _decimal(p, 2);
+    day = _decimal(p + 2, 2);
+    hour = _decimal(p + 4, 2);
+    minute = _decimal(p + 6, 2);
+    p += 8;
+    if (end - p >= 2 && *p >= '0' && *p <= '9') {
+	second = _decimal(p, 2);
+	p += 2;
+    }
+    if (p < end && (*p == '.' || *p == ',')) /* fractions of a second are dropped */
+	for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+	    ;
+    if (p < end && (*p == '+' || *p == '-')) {
+	if (end - p < 5 || _decimal(p + 1, 2) < 0 || _decimal(p + 3, 2) < 0)
+	    return -1;
+	offset = (*p == '-' ? -1 : 1) * (3600 * _decimal(p + 1, 2) + 60 * _decimal(p + 3, 2));
+	p += 5;
+    }
+    else if (p < end && *p == 'Z')
+	p++;
+
+    if (p != end || month < 1 || month > 12 || day < 1 || day > 31 || hour < 0 || hour > 23 ||
+	minute < 0 || minute > 59 || second < 0 || second > 60)
+	return -1;
+    *epoch = 86400 * _days_from_civil(year, (unsigned) month, (unsigned) day) + 3600 * hour + 60 * minute + second - offset;
+    return 0;
+}
+
+/* fill in self's cached validity epochs (EPOCH_MISSING where a time doesn't parse) if need be */
+static void
+_validity_epochs(cx509 *self)
+{
+    Validity_t *validity = &self->certificate->tbsCertificate.validity;
+
+    if (self->have_epochs)
+	return;
+    if (_time_to_epoch(&validity->notBefore, &self->epochs[0]) < 0)
+	self->epochs[0] = EPOCH_MISSING;
+    if (_time_to_epoch(&validity->notAfter, &self->epochs[1]) < 0)
+	self->epochs[1] = EPOCH_MISSING;
+    self->have_epochs = 1;
+}
+
+/*
+ * Find the validity times in an encoded Certificate without decoding it, and convert them as
+ * _time_to_epoch does (EPOCH_MISSING where they don't parse). Returns -1 if the TLVs leading up to
+ * Validity are malformed.
+ */
+static int
+_scan_validity(const uint8_t *buf, size_t size, int64_t epochs[2])
+{
+    tlv_t cert, tbs, field, time;
+    Time_t t;
+    int i;
+
+    /* Certificate ::= SEQUENCE { TBSCertificate ::= SEQUENCE { version [0] OPTIONAL, serialNumber, signature, issuer, validity, ... } } */
+    if (_tlv_at(buf, size, 0, &cert) < 0 || TLV_FIRST(buf, &cert, &tbs) < 0 || TLV_FIRST(buf, &tbs, &field) < 0)
+	return -1;
+    if (field.tag == (ber_tlv_tag_t) ((0 << 2) | ASN_TAG_CLASS_CONTEXT) && TLV_NEXT(buf, &tbs, &field) < 0)
+	return -1;
+    for (i = 0; i < 3; i++) /* skip serialNumber, signature and issuer */
+	if (TLV_NEXT(buf, &tbs, &field) < 0)
+	    return -1;
+
+    /* Validity ::= SEQUENCE { notBefore Time, notAfter Time }; Time ::= CHOICE { UTCTime, GeneralizedTime } */
+    for (i = 0; i < 2; i++) {
+	epochs[i] = EPOCH_MISSING;
+	if ((i == 0 ? TLV_FIRST(buf, &field, &time) : TLV_NEXT(buf, &field, &time)) < 0)
+	    continue;
+	memset(&t, 0, sizeof(t));
+	if (time.tag == (ber_tlv_tag_t) ((23 << 2) | ASN_TAG_CLASS_UNIVERSAL))
+	    t.present = Time_PR_utcTime;
+	else if (time.tag == (ber_tlv_tag_t) ((24 << 2) | ASN_TAG_CLASS_UNIVERSAL))
+	    t.present = Time_PR_generalTime;
+	if (t.present == Time_PR_NOTHING || time.constructed)
+	    continue;
+	t.choice.utcTime.buf = (uint8_t *) buf + time.offset + time.header;
+	t.choice.utcTime.size = (int) (time.length - time.header);
+	if (_time_to_epoch(&t, &epochs[i]) < 0)
+	    epochs[i] = EPOCH_MISSING;
+    }
+    return 0;
+}
+
+/* Return validity as (start, end) seconds since the epoch, or None for a time that doesn't parse. */
+static PyObject *
+cx509_get_validity_epoch(cx509 *self)
+{
+    PyObject *tuple, *value;
+    int i;
+
+    if (!self->certificate) {
+	PyErr_Format(PyExc_ValueError, "empty certificate");
+	return NULL;
+    }
+    if (_need(self, PART(PART_VALIDITY)) < 0)
+	return NULL;
+
+    _validity_epochs(self);
+    if (!(tuple = PyTuple_New(2)))
+	return NULL;
+    for (i = 0; i < 2; i++) {
+	if (self->epochs[i] == EPOCH_MISSING) {
+	    value = Py_None;
+	    Py_INCREF(value);
+	}
+	else if (!(value = PyLong_FromLongLong(self->epochs[i]))) {
+	    Py_DECREF(tuple);
+	    return NULL;
+	}
+	PyTuple_SET_ITEM(tuple, i, value); /* steals reference */
+    }
+    return tuple;
+}
+
+static PyObject *
+cx509_get_issuer(cx509 *self)
+{
+    TBSCertificate_t tbsCertificate;
+    PyObject *dict;
+
+    MEMO_RETURN(self, MEMO_ISSUER);
+    if (!self->certificate) {
+	PyErr_Format(PyExc_ValueError, "empty certificate");
+	return NULL;
+    }
+    if (_need(self, PART(PART_ISSUER)) < 0)
+	return NULL;
+
+    dict = PyDict_New();
+    tbsCertificate = self->certificate->tbsCertificate;
+    if (tbsCertificate.issuer.present == Name_PR_rdnSequence) {
+	BEGIN_SCRATCH(self);
+	_populate_dict_from_rdn_sequence(dict, &tbsCertificate.issuer.choice.rdnSequence);
+	END_SCRATCH(self);
+    }
+    return _memo(self, MEMO_ISSUER, dict);
+}
+
+static PyObject *
+cx509_get_subject(cx509 *self)
+{
+    TBSCertificate_t tbsCertificate;
+    PyObject *dict;
+
+    MEMO_RETURN(self, MEMO_SUBJECT);
+    if (!self->certificate) {
+	PyErr_Format(PyExc_ValueError, "empty certificate");
+	return NULL;
+    }
+    if (_need(self, PART(PART_SUBJECT)) < 0)
+	return NULL;
+
+    dict = PyDict_New();
+    tbsCertificate = self->certificate->tbsCertificate;
+    if (tbsCertificate.subject.present == Name_PR_rdnSequence) {
+	BEGIN_SCRATCH(self);
+	_populate_dict_from_rdn_sequence(dict, &tbsCertificate.subject.choice.rdnSequence);
+	END_SCRATCH(self);
+    }
+    return _memo(self, MEMO_SUBJECT, dict);
+}
+
+static void
+_populate_dict_from_rdn_sequence(PyObject *dict, RDNSequence_t *rdnSequence)
+{
+    AttributeTypeAndValue_t *atv;
+    int i, j;
+    const oid_entry_t *oid;
+    oid_entry_t unknown;
+
+    for (i = 0; i < rdnSequence->list.count; i++) {
+	for (j = 0; j < rdnSequence->list.array[i]->list.count; j++) {
+	    atv = rdnSequence->list.array[i]->list.array[j];
+	    if ((oid = _oid_lookup(&atv->type)))
+		_add_directory_string_to_dict(&atv->value, dict, oid);
+	    else {
+		/* an attribute type we don't know; its keys are made from the printed OID */
+		memset(&unknown, 0, sizeof(unknown));
+		if ((unknown.dotted = _oid_to_string(&atv->type))) {
+		    if (!_oid_entry_strings(&unknown, /*intern:*/ 0))
+			_add_directory_string_to_dict(&atv->value, dict, &unknown);
+		    _oid_entry_clear(&unknown);
+		    PyMem_Free((void *) unknown.dotted);
+		}
+	    }
+	}
+    }
+}
+
+static void
+_add_directory_string_to_dict(ANY_t *any, PyObject *dict, const oid_entry_t *oid)
+{
+    PyObject *value;
+    PyObject *encoding; /* borrowed */
+    DirectoryString_t *ds = NULL;
+    IA5String_t *ia5 = NULL;
+    VisibleString_t *vs = NULL;
+    NumericString_t *ns = NULL;
+
+#define ADD do {									\
+    /* add key/value */									\
+    PyDict_SetItem(dict, oid->py_key, value);						\
+    Py_DECREF(value);									\
+    /* add encoding */									\
+    PyDict_SetItem(dict, oid->py_encoding_key, encoding);				\
+    /* add oid string */								\
+    PyDict_SetItem(dict, oid->py_oid_key, oid->py_dotted);				\
+} while (0)
+
+    if (!ANY_to_type(any, &asn_DEF_DirectoryString, (void *) &ds) && ds) {
+	value = _directory_string_to_string(ds, &encoding);
+	if (value)
+	    ADD;
+	asn_DEF_DirectoryString.free_struct(&asn_DEF_DirectoryString, (void *) ds, 0);
+    }
+    else if (!ANY_to_type(any, &asn_DEF_IA5String, (void *) &ia5) && ia5) {
+	encoding = INTERNED(ia5);
+	value = PyString_FromStringAndSize((void *) ia5->buf, (size_t) ia5->size);
+	if (value)
+	    ADD;
+	asn_DEF_IA5String.free_struct(&asn_DEF_IA5String, (void *) ia5, 0);
+    }
+    else if (!ANY_to_type(any, &asn_DEF_VisibleString, (void *) &vs) && vs) {
+	/*
+	 * This type represents a character string with the alphabet which is more or less a subset
+	 * of ASCII between the space and the ''~'' symbol (tilde).
+	 */
+	encoding = INTERNED(ascii);
+	value = PyString_FromStringAndSize((void *) vs->buf, (size_t) vs->size);
+	if (value)
+	    ADD;
+	asn_DEF_VisibleString.free_struct(&asn_DEF_VisibleString, (void *) vs, 0);
+    }
+    else if (!ANY_to_type(any, &asn_DEF_NumericString, (void *) &ns) && ns) {
+	/* 
+	 * This type represents a character string with the alphabet consisting of numbers (''0'' to
+	 * ''9'') and a space.
+	 */
+	encoding = INTERNED(ascii);
+	value = PyString_FromStringAndSize((void *) ns->buf, (size_t) ns->size);
+	if (value)
+	    ADD;
+	asn_DEF_NumericString.free_struct(&asn_DEF_NumericString, (void *) ns, 0);
+    }
+}
+
+/*
+ * From RFC 3280:
+ *
+ *   This specification requires only a subset of the name comparison functionality specified in the
+ *   X.500 series of specifications.  Conforming implementations are REQUIRED to implement the
+ *   following name comparison rules:
+ *
+ *      (a) attribute values encoded in different types (e.g., PrintableString and BMPString) MAY be
+ *      assumed to represent different strings;
+ *
+ *      (b) attribute values in types other than PrintableString are case sensitive (this permits
+ *      matching of attribute values as binary objects);
+ *
+ *      (c) attribute values in PrintableString are not case sensitive (e.g., "Marianne Swanson" is
+ *      the same as "MARIANNE SWANSON"); and
+ *
+ *      (d) attribute values in PrintableString are compared after removing leading and trailing
+ *      white space and converting internal substrings of one or more consecutive white space
+ *      characters to a single space.
+ *
+ *   These name comparison rules permit a certificate user to validate certificates issued using
+ *   languages or encodings unfamiliar to the certificate user.
+ *
+ * What this means for us:
+ *
+ * - we need to return both the string contents and the encoding for each string
+ * - we need to normalize PrintableString values as noted above
+ */
+static PyObject *
+_directory_string_to_string(DirectoryString_t *ds, PyObject **encoding)
+{
+    PyObject *retval = NULL;
+    const char *from;
+    char *allocated = NULL, *to;
+
+    if (ds->present == DirectoryString_PR_printableString) {
+	/*
+	 * According to RFC 4517, PrintableString matches:
+	 *
+	 *   [A-Za-z0-9'()+,.=/:? -]+
+	 *
+	 * so we can just set the encoding to ascii here after doing the appropriate normalization.
+	 */
+	allocated = to = PyMem_Malloc(strlen((void *) ds->choice.printableString.buf) + 1);
+	for (from = (const char *) ds->choice.printableString.buf; isspace(*from); ++from)
+	    ; /* skip initial whitespace */
+	for (; *from; ++from)
+	    switch (*from) {
+		case ' ':
+		case '\t':
+		case '\r':
+		case '\n':
+		    /* convert sequence of white space to single space */
+		    while (1) {
+			switch (*from) {
+			    case ' ':
+			    case '\t':
+			    case '\r':
+			    case '\n':
+				++from;
+				break;
+			    default:
+				--from;
+				goto NonWS;
+			}
+		    }
+		NonWS: *to++ = ' ';
+		    break;
+
+		case 'a': case 'b': case 'c': case 'd': case 'e': case 'f': case 'g': case 'h': case 'i': case 'j': case 'k': case 'l': case 'm': 
+		case 'n': case 'o': case 'p': case 'q': case 'r': case 's': case 't': case 'u': case 'v': case 'w': case 'x': case 'y': case 'z':
+		case 'A': case 'B': case 'C': case 'D': case 'E': case 'F': case 'G': case 'H': case 'I': case 'J': case 'K': case 'L': case 'M': 
+		case 'N': case 'O': case 'P': case 'Q': case 'R': case 'S': case 'T': case 'U': case 'V': case 'W': case 'X': case 'Y': case 'Z':
+		    /* 
+		     * NOTE: I don't convert case here, because it seems better to preserve it for
+		     * display purposes, but it's essential to do that when comparing for name
+		     * equality.
+		     */
+		case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
+		case '(': case ')': case '+': case ',': case '.': case '=': case '/': case ':': case '?': case '-':
+		case '\'':
+		    /* other characters we allow, despite the spec: */
+		case '@':
+		    *to++ = *from;
+		    break;
+
+		default:
+		    /* illegal char - replace with asterisk */
+		    *to++ = '*';
+		    break;
+	    }	
+	if (to != allocated && to[-1] == ' ')
+	    to[-1] = '\0'; /* strip trailing whitespace and null-terminate */
+	else
+	    *to = '\0'; /* null-terminate */
+	*encoding = INTERNED(ascii);
+	retval = PyString_FromString(allocated);
+    }
+    else if (ds->present == DirectoryString_PR_utf8String) {
+	*encoding = INTERNED(utf8);
+	retval = PyString_FromStringAndSize((void *) ds->choice.utf8String.buf, (size_t) ds->choice.utf8String.size);
+    }
+    else if (ds->present == DirectoryString_PR_teletexString) {
+	/* obsolete, but still used (e.g., by Google) */
+	*encoding = INTERNED(x500_teletex);
+	retval = PyString_FromStringAndSize((void *) ds->choice.teletexString.buf, (size_t) ds->choice.teletexString.size);
+    }
+    else if (ds->present == DirectoryString_PR_universalString) {
+	/* obsolete */
+	*encoding = INTERNED(x500_universal);
+	retval = PyString_FromStringAndSize((void *) ds->choice.universalString.buf, (size_t) ds->choice.universalString.size);
+    }
+    else if (ds->present == DirectoryString_PR_bmpString) {
+	/* obsolete */
+	*encoding = INTERNED(x500_bmp);
+	retval = PyString_FromStringAndSize((void *) ds->choice.bmpString.buf, (size_t) ds->choice.bmpString.size);
+    }
+    else
+	*encoding = INTERNED(x500_unknown);
+
+    if (allocated)
+	PyMem_Free(allocated);
+
+    return retval;
+}
+
+/*
+ * Canonical name keys. A key is a (hash, encoding) tuple over a Name's RDNSequence, with RDN order
+ * preserved; tuples compare element by element, so two keys are compared by their 64-bit hashes
+ * first and by memcmp of the encodings only when those match. The encoding gives, for each RDN,
+ * the number of attributes, then for each attribute the type OID content octets, the value's tag
+ * and the value's content octets, each length-prefixed with a base-128 varint. PrintableString
+ * values are normalized according to rules (c) and (d) above (case folded, white space trimmed and
+ * collapsed); values of other types compare as binary, and values of different types never match,
+ * as rules (a) and (b) allow.
+ */
+#define FNV64_OFFSET 0xcbf29ce484222325ULL
+#define FNV64_PRIME 0x100000001b3ULL
+#define PRINTABLE_STRING_TAG ((ber_tlv_tag_t) (19 << 2)) /* [UNIVERSAL 19] */
+#define INTEGER_TAG ((ber_tlv_tag_t) (2 << 2)) /* [UNIVERSAL 2] */
+#define OID_TAG ((ber_tlv_tag_t) (6 << 2)) /* [UNIVERSAL 6] */
+#define SEQUENCE_TAG ((ber_tlv_tag_t) (16 << 2)) /* [UNIVERSAL 16] */
+
+/* write v as a varint at out, if out isn't NULL; returns its length either way */
+static size_t
+_put_varint(uint8_t *out, size_t v)
+{
+    size_t n = 0;
+
+    do {
+	if (out)
+	    out[n] = (uint8_t) ((v & 0x7f) | (v > 0x7f ? 0x80 : 0));
+	n++;
+	v >>= 7;
+    } while (v);
+    return n;
+}
+
+/* write size bytes at out, if out isn't NULL; returns size */
+static size_t
+_put_bytes(uint8_t *out, const uint8_t *from, size_t size)
+{
+    if (out && size)
+	memcpy(out, from, size);
+    return size;
+}
+
+/* write the normalized form of a PrintableString at out, if out isn't NULL; returns its length */
+static size_t
+_fold_printable(uint8_t *out, const uint8_t *from, size_t size)
+{
+    size_t i, n = 0;
+    int space = 0;
+    uint8_t c;
+
+    for (i = 0; i < size; i++) {
+	c = from[i];
+	if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+	    space = n > 0; /* drops leading white space; trailing white space is never written */
+	    continue;
+	}
+	if (space) {
+	    if (out)
+		out[n] = ' ';
+	    n++;
+	    space = 0;
+	}
+	if (out)
+	    out[n] = c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+	n++;
+    }
+    return n;
+}
+
+/*
+ * Write the canonical encoding of rdnSequence at out, or with out NULL, just count it; returns the
+ * length. Like der_encode, we're called once to count and again to write.
+ */
+static size_t
+_canonical_name(RDNSequence_t *rdnSequence, uint8_t *out)
+{
+    RelativeDistinguishedName_t *rdn;
+    AttributeTypeAndValue_t *atv;
+    const uint8_t *value;
+    size_t n = 0, size;
+    tlv_t tlv;
+    int i, j;
+
+#define AT(n) (out ? out + (n) : NULL)
+
+    for (i = 0; i < rdnSequence->list.count; i++) {
+	rdn = rdnSequence->list.array[i];
+	n += _put_varint(AT(n), (size_t) rdn->list.count);
+	for (j = 0; j < rdn->list.count; j++) {
+	    atv = rdn->list.array[j];
+	    n += _put_varint(AT(n), (size_t) atv->type.size);
+	    n += _put_bytes(AT(n), atv->type.buf, (size_t) atv->type.size);
+
+	    /* the value is an ANY, which holds its whole TLV */
+	    if (_tlv_at(atv->value.buf, (size_t) atv->value.size, 0, &tlv) < 0) {
+		/* no sensible TLV; use the raw bytes, with a tag no real value has */
+		tlv.tag = (ber_tlv_tag_t) -1;
+		tlv.constructed = 1;
+		tlv.header = 0;
+		tlv.length = (size_t) atv->value.size;
+	    }
+	    value = atv->value.buf + tlv.header;
+	    size = tlv.length - tlv.header;
+	    n += _put_varint(AT(n), (size_t) tlv.tag);
+	    if (tlv.tag == PRINTABLE_STRING_TAG && !tlv.constructed) {
+		n += _put_varint(AT(n), _fold_printable(NULL, value, size));
+		n += _fold_printable(AT(n), value, size);
+	    }
+	    else {
+		n += _put_varint(AT(n), size);
+		n += _put_bytes(AT(n), value, size);
+	    }
+	}
+    }
+    return n;
+
+#undef AT
+}
+
+/* the (hash, encoding) key for name; see above */
+static PyObject *
+_name_key(Name_t *name)
+{
+    RDNSequence_t empty;
+    RDNSequence_t *rdnSequence = &empty;
+    PyObject *encoding, *hash;
+    uint64_t h = FNV64_OFFSET;
+    const uint8_t *p;
+    size_t size, i;
+
+    memset(&empty, 0, sizeof(empty));
+    if (name->present == Name_PR_rdnSequence)
+	rdnSequence = &name->choice.rdnSequence;
+
+    size = _canonical_name(rdnSequence, NULL);
+    if (!(encoding = PyString_FromStringAndSize(NULL, size)))
+	return NULL;
+    p = (const uint8_t *) PyString_AS_STRING(encoding);
+    _canonical_name(rdnSequence, (uint8_t *) p);
+
+    /* 64-bit FNV-1a */
+    for (i = 0; i < size; i++) {
+	h ^= p[i];
+	h *= FNV64_PRIME;
+    }
+
+    if (!(hash = PyLong_FromUnsignedLongLong((unsigned PY_LONG_LONG) h))) {
+	Py_DECREF(encoding);
+	return NULL;
+    }
+    return Py_BuildValue("(NN)", hash, encoding);
+}
+
+static PyObject *
+cx509_get_issuer_key(cx509 *self)
+{
+    if (!self->certificate) {
+	PyErr_Format(PyExc_ValueError, "empty certificate");
+	return NULL;
+    }
+    if (_need(self, PART(PART_ISSUER)) < 0)
+	return NULL;
+
+    if (!self->issuer_key && !(self->issuer_key = _name_key(&self->certificate->tbsCertificate.issuer)))
+	return NULL;
+    Py_INCREF(self->issuer_key);
+    return self->issuer_key;
+}
+
+static PyObject *
+cx509_get_subject_key(cx509 *self)
+{
+    if (!self->certificate) {
+	PyErr_Format(PyExc_ValueError, "empty certificate");
+	return NULL;
+    }
+    if (_need(self, PART(PART_SUBJECT)) < 0)
+	return NULL;
+
+    if (!self->subject_key && !(self->subject_key = _name_key(&self->certificate->tbsCertificate.subject)))
+	return NULL;
+    Py_INCREF(self->subject_key);
+    return self->subject_key;
+}
+
+/*
+ * Extension decoders. Each extension type we understand has an entry in extension_decoders[]
+ * giving the asn1c type its extnValue decodes as and a function that adds the fields of the
+ * decoded value to the extension's dict. _extension_decoders_init() hangs each entry off the OID
+ * table slot for its OID, so finding the decoder for an extension is the same hash lookup that
+ * finds its name.
+ */
+typedef struct extension_decoder {
+    const char *dotted;		/* as in OIDs[] */
+    asn_TYPE_descriptor_t *td;
+    int (*build)(void *value, PyObject *dict);	/* -1 with an exception set on failure */
+} extension_decoder_t;
+
+/* the name of a decoded OID if we know it, else its dotted string (None if it won't print); new reference */
+static PyObject *
+_oid_key(OBJECT_IDENTIFIER_t *oid)
+{
+    const oid_entry_t *entry = _oid_lookup(oid);
+    PyObject *key;
+    char *dotted;
+
+    if (entry) {
+	Py_INCREF(entry->py_key);
+	return entry->py_key;
+    }
+    if (!(dotted = _oid_to_string(oid))) {
+	Py_INCREF(Py_None);
+	return Py_None;
+    }
+    key = PyString_FromString(dotted);
+    PyMem_Free(dotted);
+    return key;
+}
+
+/* a frozenset of the names of the bits set in bits; names[i] indexes interned[] for bit i */
+static PyObject *
+_bit_flags(BIT_STRING_t *bits, const int *names, int count)
+{
+    PyObject *flags = PyFrozenSet_New(NULL);
+    int i;
+
+    for (i = 0; flags && i < count && i < 8 * bits->size; i++)
+	if ((bits->buf[i / 8] & (0x80 >> (i % 8))) && PySet_Add(flags, interned[names[i]]) < 0)
+	    Py_CLEAR(flags);
+    return flags;
+}
+
+/* set dict[key] to value, consuming value; -1 if value is NULL or the set fails */
+static int
+_set_new(PyObject *dict, PyObject *key, PyObject *value)
+{
+    int result;
+
+    if (!value)
+	return -1;
+    result = PyDict_SetItem(dict, key, value);
+    Py_DECREF(value);
+    return result;
+}
+
+/* GeneralName forms, indexed by GeneralName_PR */
+static const int general_name_strings[] = {
+    S_COUNT, S_otherName, S_rfc822Name, S_dNSName, S_x400Address, S_directoryName, S_ediPartyName,
+    S_uniformResourceIdentifier, S_iPAddress, S_registeredID
+};
+
+/* a DER encoding of a decoded value, or None if it won't encode; for the rare GeneralName forms we don't pick apart */
+static PyObject *
+_encoded_value(asn_TYPE_descriptor_t *td, void *sptr)
+{
+    asn_enc_rval_t er = der_encode(td, sptr, NULL, NULL);
+    PyObject *s;
+    void *output;
+
+    if (er.encoded < 0) {
+	Py_INCREF(Py_None);
+	return Py_None;
+    }
+    if (!(s = PyString_FromStringAndSize(NULL, er.encoded)))
+	return NULL;
+    output = PyString_AS_STRING(s);
+    if (der_encode(td, sptr, _print2buffer, (void *) &output).encoded != er.encoded) {
+	Py_DECREF(s);
+	Py_INCREF(Py_None);
+	return Py_None;
+    }
+    return s;
+}
+
+/* an ediPartyName as a dict of its nameAssigner (if present) and partyName strings */
+static PyObject *
+_edi_party_name(EDIPartyName_t *edi)
+{
+    PyObject *dict = PyDict_New(), *encoding;
+
+    if (dict && edi->nameAssigner &&
+	_set_new(dict, INTERNED(nameAssigner), _directory_string_to_string(edi->nameAssigner, &encoding)) < 0)
+	Py_CLEAR(dict);
+    if (dict && edi->partyName &&
+	_set_new(dict, INTERNED(partyName), _directory_string_to_string(edi->partyName, &encoding)) < 0)
+	Py_CLEAR(dict);
+    return _frozen(dict);
+}
+
+/*
+ * The value of a GeneralName: a string for the IA5String forms, the packed 4- or 16-byte address
+ * (or address and mask, in name constraints) for iPAddress, a dict like get_subject()'s for
+ * directoryName, a dict of nameAssigner and partyName for ediPartyName, the name or dotted string
+ * of the OID for registeredID, a (type-id, DER value) pair for otherName and the DER encoding of
+ * an x400Address. None for a GeneralName with no form.
+ */
+static PyObject *
+_general_name_value(GeneralName_t *gn)
+{
+    PyObject *value;
+
+    switch (gn->present) {
+    case GeneralName_PR_rfc822Name:
+    case GeneralName_PR_dNSName:
+    case GeneralName_PR_uniformResourceIdentifier:
+    case GeneralName_PR_iPAddress:
+	/* rfc822Name, dNSName and uniformResourceIdentifier are IA5Strings, iPAddress an OCTET STRING */
+	return PyString_FromStringAndSize((const char *) gn->choice.iPAddress.buf, gn->choice.iPAddress.size);
+    case GeneralName_PR_directoryName:
+	if ((value = PyDict_New()) && gn->choice.directoryName.present == Name_PR_rdnSequence)
+	    _populate_dict_from_rdn_sequence(value, &gn->choice.directoryName.choice.rdnSequence);
+	return _frozen(value);
+    case GeneralName_PR_registeredID:
+	return _oid_key(&gn->choice.registeredID);
+    case GeneralName_PR_otherName:
+	return Py_BuildValue("(Ns#)", _oid_key(&gn->choice.otherName.type_id),
+			     (const char *) gn->choice.otherName.value.buf, (int) gn->choice.otherName.value.size);
+    case GeneralName_PR_ediPartyName:
+	return _edi_party_name(&gn->choice.ediPartyName);
+    case GeneralName_PR_x400Address:
+	return _encoded_value(&asn_DEF_ORAddress, &gn->choice.x400Address);
+    default:
+	Py_INCREF(Py_None);
+	return Py_None;
+    }
+}
+
+/* a GeneralName as a (form, value) pair; see _general_name_value */
+static PyObject *
+_general_name(GeneralName_t *gn)
+{
+    if (gn->present <= GeneralName_PR_NOTHING || gn->present > GeneralName_PR_registeredID)
+	return Py_BuildValue("(OO)", Py_None, Py_None);
+    return Py_BuildValue("(ON)", interned[general_name_strings[gn->present]], _general_name_value(gn));
+}
+
+/* a tuple of _general_name() pairs */
+static PyObject *
+_general_names(GeneralNames_t *names)
+{
+    PyObject *tuple, *item;
+    int i;
+
+    if (!(tuple = PyTuple_New(names ? names->list.count : 0)))
+	return NULL;
+    for (i = 0; names && i < names->list.count; i++) {
+	if (!(item = _general_name(names->list.array[i]))) {
+	    Py_DECREF(tuple);
+	    return NULL;
+	}
+	PyTuple_SET_ITEM(tuple, i, item); /* steals reference */
+    }
+    return tuple;
+}
+
+static int
+_build_key_usage(void *value, PyObject *dict)
+{
+    return _set_new(dict, INTERNED(keyUsage), _bit_flags((KeyUsage_t *) value, key_usage_strings,
+							    sizeof(key_usage_strings) / sizeof(key_usage_strings[0])));
+}
+
+/*
+ * GeneralNames as one tuple of (type-id, value) pairs, the type-id being the GeneralName's context
+ * tag number (0 for otherName through 8 for registeredID, -1 for none) and the value as for
+ * _general_name_value.
+ */
+static PyObject *
+_alt_names_flat(GeneralNames_t *names)
+{
+    PyObject *tuple, *item;
+    GeneralName_t *gn;
+    int i;
+
+    if (!(tuple = PyTuple_New(names->list.count)))
+	return NULL;
+    for (i = 0; i < names->list.count; i++) {
+	gn = names->list.array[i];
+	if (!(item = Py_BuildValue("(iN)", gn->present > GeneralName_PR_NOTHING && gn->present <= GeneralName_PR_registeredID ?
+				   (int) gn->present - 1 : -1, _general_name_value(gn)))) {
+	    Py_DECREF(tuple);
+	    return NULL;
+	}
+	PyTuple_SET_ITEM(tuple, i, item); /* steals reference */
+    }
+    return tuple;
+}
+
+/*
+ * Group a flat alt name tuple by form: a dict from each form present to a frozenset of its values,
+ * or (for directoryName and ediPartyName, whose values are dicts) a tuple of them in order.
+ */
+static PyObject *
+_alt_names_grouped(PyObject *flat)
+{
+    PyObject *groups[GeneralName_PR_registeredID + 1] = { NULL }, *dict, *value, *group;
+    Py_ssize_t i;
+    long type_id;
+    int form, result = 0;
+
+    if (!(dict = PyDict_New()))
+	return NULL;
+    for (i = 0; i < PyTuple_GET_SIZE(flat) && !result; i++) {
+	type_id = PyInt_AS_LONG(PyTuple_GET_ITEM(PyTuple_GET_ITEM(flat, i), 0));
+	value = PyTuple_GET_ITEM(PyTuple_GET_ITEM(flat, i), 1);
+	if (type_id < 0)
+	    continue;
+	form = (int) type_id + 1;
+	if (!groups[form] && !(groups[form] = PyList_New(0)))
+	    result = -1;
+	else
+	    result = PyList_Append(groups[form], value); /* does not steal reference */
+    }
+    for (form = GeneralName_PR_NOTHING + 1; form <= GeneralName_PR_registeredID; form++) {
+	if (!groups[form])
+	    continue;
+	if (!result) {
+	    if (form == GeneralName_PR_directoryName || form == GeneralName_PR_ediPartyName)
+		group = PyList_AsTuple(groups[form]);
+	    else
+		group = PyFrozenSet_New(groups[form]);
+	    result = _set_new(dict, interned[general_name_strings[form]], group);
+	}
+	Py_DECREF(groups[form]);
+    }
+    if (result < 0)
+	Py_CLEAR(dict);
+    return dict;
+}
+
+static int
+_build_alt_name(void *value, PyObject *dict)
+{
+    PyObject *flat, *grouped;
+    int result;
+
+    if (!(flat = _alt_names_flat((GeneralNames_t *) value)))
+	return -1;
+    grouped = _alt_names_grouped(flat);
+    Py_DECREF(flat);
+    if (!grouped)
+	return -1;
+    result = PyDict_Update(dict, grouped);
+    Py_DECREF(grouped);
+    return result;
+}
+
+static int
+_build_basic_constraints(void *value, PyObject *dict)
+{
+    BasicConstraints_t *basicConstraints = (BasicConstraints_t *) value;
+    long pathlen = 0;
+
+    if (PyDict_SetItem(dict, INTERNED(cA), (basicConstraints->cA && *basicConstraints->cA) ? Py_True : Py_False) < 0)
+	return -1;
+    if (!asn_INTEGER2long(basicConstraints->pathLenConstraint, &pathlen))
+	return _set_new(dict, INTERNED(pathLenConstraint), PyInt_FromLong(pathlen));
+    return 0;
+}
+
+static int
+_build_subject_key_identifier(void *value, PyObject *dict)
+{
+    SubjectKeyIdentifier_t *ski = (SubjectKeyIdentifier_t *) value;
+
+    return _set_new(dict, INTERNED(keyIdentifier), PyString_FromStringAndSize((const char *) ski->buf, ski->size));
+}
+
+static int
+_build_authority_key_identifier(void *value, PyObject *dict)
+{
+    AuthorityKeyIdentifier_t *aki = (AuthorityKeyIdentifier_t *) value;
+
+    if (aki->keyIdentifier &&
+	_set_new(dict, INTERNED(keyIdentifier), PyString_FromStringAndSize((const char *) aki->keyIdentifier->buf, aki->keyIdentifier->size)) < 0)
+	return -1;
+    if (aki->authorityCertIssuer && _set_new(dict, INTERNED(authorityCertIssuer), _general_names(aki->authorityCertIssuer)) < 0)
+	return -1;
+    /* signed, like get_serial_number(), so it compares equal to the issuer's */
+    if (aki->authorityCertSerialNumber && aki->authorityCertSerialNumber->size &&
+	_set_new(dict, INTERNED(authorityCertSerialNumber),
+		 _integer_to_long(aki->authorityCertSerialNumber->buf, aki->authorityCertSerialNumber->size, 1)) < 0)
+	return -1;
+    return 0;
+}
+
+static int
+_build_ext_key_usage(void *value, PyObject *dict)
+{
+    ExtKeyUsageSyntax_t *eku = (ExtKeyUsageSyntax_t *) value;
+    PyObject *purposes, *purpose;
+    int i;
+
+    if (!(purposes = PyTuple_New(eku->list.count)))
+	return -1;
+    for (i = 0; i < eku->list.count; i++) {
+	if (!(purpose = _oid_key(eku->list.array[i]))) {
+	    Py_DECREF(purposes);
+	    return -1;
+	}
+	PyTuple_SET_ITEM(purposes, i, purpose); /* steals reference */
+    }
+    return _set_new(dict, INTERNED(extendedKeyUsage), purposes);
+}
+
+/* ReasonFlags names, indexed by bit number */
+static const int reason_strings[] = {
+    S_unused, S_keyCompromise, S_cACompromise, S_affiliationChanged, S_superseded,
+    S_cessationOfOperation, S_certificateHold, S_privilegeWithdrawn, S_aACompromise
+};
+
+/* a DistributionPoint as a dict with whichever of fullName, nameRelativeToCRLIssuer, reasons and cRLIssuer it has */
+static PyObject *
+_distribution_point(DistributionPoint_t *dp)
+{
+    PyObject *point = PyDict_New(), *rdn;
+    RDNSequence_t name;
+    RelativeDistinguishedName_t *rdns[1];
+
+    if (!point)
+	return NULL;
+    if (dp->distributionPoint && dp->distributionPoint->present == DistributionPointName_PR_fullName &&
+	_set_new(point, INTERNED(fullName), _general_names(&dp->distributionPoint->choice.fullName)) < 0)
+	goto fail;
+    if (dp->distributionPoint && dp->distributionPoint->present == DistributionPointName_PR_nameRelativeToCRLIssuer) {
+	/* render the lone RDN as a one-element RDNSequence */
+	memset(&name, 0, sizeof(name));
+	rdns[0] = &dp->distributionPoint->choice.nameRelativeToCRLIssuer;
+	name.list.array = rdns;
+	name.list.count = name.list.size = 1;
+	if (!(rdn = PyDict_New()))
+	    goto fail;
+	_populate_dict_from_rdn_sequence(rdn, &name);
+	if (_set_new(point, INTERNED(nameRelativeToCRLIssuer), _frozen(rdn)) < 0)
+	    goto fail;
+    }
+    if (dp->reasons &&
+	_set_new(point, INTERNED(reasons), _bit_flags(dp->reasons, reason_strings, sizeof(reason_strings) / sizeof(reason_strings[0]))) < 0)
+	goto fail;
+    if (dp->cRLIssuer && _set_new(point, INTERNED(cRLIssuer), _general_names(dp->cRLIssuer)) < 0)
+	goto fail;
+    return _frozen(point);
+
+  fail:
+    Py_DECREF(point);
+    return NULL;
+}
+
+static int
+_build_crl_distribution_points(void *value, PyObject *dict)
+{
+    CRLDistributionPoints_t *crldp = (CRLDistributionPoints_t *) value;
+    PyObject *points, *point;
+    int i;
+
+    if (!(points = PyTuple_New(crldp->list.count)))
+	return -1;
+    for (i = 0; i < crldp->list.count; i++) {
+	if (!(point = _distribution_point(crldp->list.array[i]))) {
+	    Py_DECREF(points);
+	    return -1;
+	}
+	PyTuple_SET_ITEM(points, i, point); /* steals reference */
+    }
+    return _set_new(dict, INTERNED(distributionPoints), points);
+}
+
+static int
+_build_authority_info_access(void *value, PyObject *dict)
+{
+    AuthorityInfoAccessSyntax_t *aia = (AuthorityInfoAccessSyntax_t *) value;
+    PyObject *descriptions, *description;
+    int i;
+
+    if (!(descriptions = PyTuple_New(aia->list.count)))
+	return -1;
+    for (i = 0; i < aia->list.count; i++) {
+	/* (accessMethod, accessLocation) */
+	if (!(description = Py_BuildValue("(NN)", _oid_key(&aia->list.array[i]->accessMethod),
+					  _general_name(&aia->list.array[i]->accessLocation)))) {
+	    Py_DECREF(descriptions);
+	    return -1;
+	}
+	PyTuple_SET_ITEM(descriptions, i, description); /* steals reference */
+    }
+    return _set_new(dict, INTERNED(accessDescriptions), descriptions);
+}
+
+/*
+ * A policy qualifier's value: the URI for a CPS pointer (an IA5String), otherwise the qualifier's
+ * DER encoding as is.
+ */
+static PyObject *
+_policy_qualifier_value(PolicyQualifierInfo_t *pqi)
+{
+    const oid_entry_t *oid = _oid_lookup(&pqi->policyQualifierId);
+    ber_tlv_len_t length;
+    ssize_t ll;
+
+    if (oid && oid->name && !strcmp(oid->name, "cps") && pqi->qualifier.size > 1 && pqi->qualifier.buf[0] == 0x16 &&
+	(ll = ber_fetch_length(0, pqi->qualifier.buf + 1, pqi->qualifier.size - 1, &length)) > 0 &&
+	length >= 0 && length <= pqi->qualifier.size - 1 - ll)
+	return PyString_FromStringAndSize((const char *) pqi->qualifier.buf + 1 + ll, length);
+    return PyString_FromStringAndSize((const char *) pqi->qualifier.buf, pqi->qualifier.size);
+}
+
+static int
+_build_certificate_policies(void *value, PyObject *dict)
+{
+    CertificatePolicies_t *policies = (CertificatePolicies_t *) value;
+    PolicyInformation_t *pi;
+    PyObject *L, *qualifiers, *item;
+    int i, j, n;
+
+    if (!(L = PyTuple_New(policies->list.count)))
+	return -1;
+    for (i = 0; i < policies->list.count; i++) {
+	/* (policyIdentifier, ((policyQualifierId, qualifier), ...)) */
+	pi = policies->list.array[i];
+	n = pi->policyQualifiers ? pi->policyQualifiers->list.count : 0;
+	if (!(qualifiers = PyTuple_New(n)))
+	    goto fail;
+	for (j = 0; j < n; j++) {
+	    if (!(item = Py_BuildValue("(NN)", _oid_key(&pi->policyQualifiers->list.array[j]->policyQualifierId),
+				       _policy_qualifier_value(pi->policyQualifiers->list.array[j])))) {
+		Py_DECREF(qualifiers);
+		goto fail;
+	    }
+	    PyTuple_SET_ITEM(qualifiers, j, item); /* steals reference */
+	}
+	if (!(item = Py_BuildValue("(NN)", _oid_key(&pi->policyIdentifier), qualifiers)))
+	    goto fail;
+	PyTuple_SET_ITEM(L, i, item); /* steals reference */
+    }
+    return _set_new(dict, INTERNED(policies), L);
+
+  fail:
+    Py_DECREF(L);
+    return -1;
+}
+
+/* the base names of a set of subtrees (RFC 5280 forbids minimum and maximum here) */
+static PyObject *
+_general_subtrees(GeneralSubtrees_t *subtrees)
+{
+    PyObject *tuple, *item;
+    int i;
+
+    if (!(tuple = PyTuple_New(subtrees->list.count)))
+	return NULL;
+    for (i = 0; i < subtrees->list.count; i++) {
+	if (!(item = _general_name(&subtrees->list.array[i]->base))) {
+	    Py_DECREF(tuple);
+	    return NULL;
+	}
+	PyTuple_SET_ITEM(tuple, i, item); /* steals reference */
+    }
+    return tuple;
+}
+
+static int
+_build_name_constraints(void *value, PyObject *dict)
+{
+    NameConstraints_t *nc = (NameConstraints_t *) value;
+
+    if (nc->permittedSubtrees && _set_new(dict, INTERNED(permittedSubtrees), _general_subtrees(nc->permittedSubtrees)) < 0)
+	return -1;
+    if (nc->excludedSubtrees && _set_new(dict, INTERNED(excludedSubtrees), _general_subtrees(nc->excludedSubtrees)) < 0)
+	return -1;
+    return 0;
+}
+
+static const extension_decoder_t extension_decoders[] = {
+    { "{ 2.5.29.14 }", &asn_DEF_SubjectKeyIdentifier, _build_subject_key_identifier },
+    { "{ 2.5.29.15 }", &asn_DEF_KeyUsage, _build_key_usage },
+    { "{ 2.5.29.17 }", &asn_DEF_GeneralNames, _build_alt_name },		/* subjectAltName */
+    { "{ 2.5.29.18 }", &asn_DEF_GeneralNames, _build_alt_name },		/* issuerAltName */
+    { "{ 2.5.29.19 }", &asn_DEF_BasicConstraints, _build_basic_constraints },
+    { "{ 2.5.29.30 }", &asn_DEF_NameConstraints, _build_name_constraints },
+    { "{ 2.5.29.31 }", &asn_DEF_CRLDistributionPoints, _build_crl_distribution_points },
+    { "{ 2.5.29.32 }", &asn_DEF_CertificatePolicies, _build_certificate_policies },
+    { "{ 2.5.29.35 }", &asn_DEF_AuthorityKeyIdentifier, _build_authority_key_identifier },
+    { "{ 2.5.29.37 }", &asn_DEF_ExtKeyUsageSyntax, _build_ext_key_usage },
+    { "{ 1.3.6.1.5.5.7.1.1 }", &asn_DEF_AuthorityInfoAccessSyntax, _build_authority_info_access },
+
+    /* sentinel */
+    { NULL, NULL, NULL }
+};
+
+/*
+ * The dict for one extension: its name and critical flag, and the decoded fields if we have a
+ * decoder for its type. Call between BEGIN_SCRATCH and END_SCRATCH; sets *exceeded if a decode
+ * budget stopped the decode. Returns NULL with an exception set on failure.
+ */
+static PyObject *
+_extension_dict(cx509 *self, struct Extension *ext, int *exceeded)
+{
+    PyObject *dict, *name;
+    const oid_entry_t *oid = _oid_lookup(&ext->extnID);
+    const extension_decoder_t *decoder = oid ? oid->decoder : NULL;
+    asn_dec_rval_t rval;
+    void *value = NULL;
+    int result = 0;
+
+    if (!(dict = PyDict_New()))
+	return NULL;
+
+    if (PyDict_SetItem(dict, INTERNED(critical), (ext->critical && *ext->critical) ? Py_True : Py_False) < 0 || /* does not steal reference */
+	!(name = _oid_key(&ext->extnID)) || _set_new(dict, INTERNED(name), name) < 0) {
+	Py_DECREF(dict);
+	return NULL;
+    }
+
+    /* decode known extensions */
+    if (decoder && ext->extnValue.size) {
+	rval = _nested_decode(&self->limits, STAT_EXTENSIONS_DECODE, decoder->td, &value, (const void *) ext->extnValue.buf, (size_t) ext->extnValue.size, exceeded);
+	if (rval.code == RC_OK && value)
+	    result = decoder->build(value, dict);
+	decoder->td->free_struct(decoder->td, value, 0);
+    }
+    if (result < 0) {
+	Py_DECREF(dict);
+	return NULL;
+    }
+    return dict;
+}
+
+/*
+ * The (read-only) dict for the extension at position in the extensions list, from the cache
+ * _extension_index() made, decoding it first if no one has asked for it yet; a borrowed reference.
+ * Call between BEGIN_SCRATCH and END_SCRATCH. Sets *exceeded (and returns NULL without an
+ * exception) if a decode budget stopped the decode.
+ */
+static PyObject *
+_cached_extension(cx509 *self, int position, int *exceeded)
+{
+    PyObject *dict = PyList_GET_ITEM(self->extension_cache, position);
+
+    if (dict != Py_None)
+	return dict;
+    dict = _frozen(_extension_dict(self, self->certificate->tbsCertificate.extensions->list.array[position], exceeded));
+    if (dict && *exceeded)
+	Py_CLEAR(dict);
+    if (!dict)
+	return NULL;
+    PyList_SetItem(self->extension_cache, position, dict); /* steals reference */
+    return dict;
+}
+
+/* get the extensions, in order; note that we only parse the ones we understand, but get the critical flag for all, as required */
+static PyObject *
+cx509_extensions(cx509 *self)
+{
+    PyObject *tuple, *dict;
+    int i, exceeded = 0;
+
+    MEMO_RETURN(self, MEMO_EXTENSIONS);
+    if (!self->certificate) {
+	PyErr_Format(PyExc_ValueError, "empty certificate");
+	return NULL;
+    }
+    if (_need(self, PART(PART_EXTENSIONS)) < 0 || _extension_index(self) < 0)
+	return NULL;
+
+    if (!(tuple = PyTuple_New(PyList_GET_SIZE(self->extension_cache))))
+	return NULL;
+
+    BEGIN_SCRATCH(self);
+    for (i = 0; i < PyTuple_GET_SIZE(tuple); i++) {
+	if (!(dict = _cached_extension(self, i, &exceeded))) {
+	    Py_CLEAR(tuple);
+	    break;
+	}
+	Py_INCREF(dict);
+	PyTuple_SET_ITEM(tuple, i, dict); /* steals reference */
+    }
+    END_SCRATCH(self);
+
+    if (exceeded)
+	_budget_error(exceeded);
+    return _memo(self, MEMO_EXTENSIONS, tuple);
+}
+
+/*
+ * Map each extension's name (or dotted OID, for those we can't name) and its dotted OID to its
+ * position in the extensions list, and make the list that caches get_extension() results; done
+ * once per _parse, the first time get_extension() or has_extension() is called.
+ */
+static int
+_extension_index(cx509 *self)
+{
+    struct Extensions *extensions = self->certificate->tbsCertificate.extensions;
+    PyObject *index, *cache, *key, *position;
+    const oid_entry_t *oid;
+    int i, n = extensions ? extensions->list.count : 0, result = 0;
+
+    if (self->extension_index)
+	return 0;
+    if (!(index = PyDict_New()) || !(cache = PyList_New(n))) {
+	Py_XDECREF(index);
+	return -1;
+    }
+    for (i = 0; i < n; i++) {
+	Py_INCREF(Py_None);
+	PyList_SET_ITEM(cache, i, Py_None); /* steals reference */
+    }
+    /* walk backwards so the first of any duplicates wins, as in _find_extension */
+    for (i = n - 1; i >= 0 && !result; i--) {
+	if (!(position = PyInt_FromLong(i)) || !(key = _oid_key(&extensions->list.array[i]->extnID))) {
+	    Py_XDECREF(position);
+	    result = -1;
+	    break;
+	}
+	if (key != Py_None)
+	    result = PyDict_SetItem(index, key, position);
+	oid = _oid_lookup(&extensions->list.array[i]->extnID);
+	if (!result && oid && oid->py_dotted != key)
+	    result = PyDict_SetItem(index, oid->py_dotted, position);
+	Py_DECREF(key);
+	Py_DECREF(position);
+    }
+    if (result < 0) {
+	Py_DECREF(index);
+	Py_DECREF(cache);
+	return -1;
+    }
+    self->extension_index = index;
+    self->extension_cache = cache;
+    return 0;
+}
+
+/* the position of the extension named (or with the OID) name, -1 if there is none, or -2 on error */
+static int
+_extension_position(cx509 *self, PyObject *name)
+{
+    PyObject *position, *dotted;
+
+    if (!self->certificate) {
+	PyErr_Format(PyExc_ValueError, "empty certificate");
+	return -2;
+    }
+    if (_need(self, PART(PART_EXTENSIONS)) < 0 || _extension_index(self) < 0)
+	return -2;
+
+    if (!(position = PyDict_GetItem(self->extension_index, name)) && PyString_Check(name) &&
+	PyString_GET_SIZE(name) && isdigit((unsigned char) PyString_AS_STRING(name)[0])) {
+	/* "2.5.29.19" for "{ 2.5.29.19 }" */
+	if (!(dotted = PyString_FromFormat("{ %s }", PyString_AS_STRING(name))))
+	    return -2;
+	position = PyDict_GetItem(self->extension_index, dotted);
+	Py_DECREF(dotted);
+    }
+    return position ? (int) PyInt_AS_LONG(position) : -1;
+}
+
+/* one extension's dict, as extensions() would give it, decoded the first time it is asked for */
+static PyObject *
+cx509_get_extension(cx509 *self, PyObject *name)
+{
+    PyObject *dict;
+    int position, exceeded = 0;
+
+    if ((position = _extension_position(self, name)) < 0) {
+	if (position == -2)
+	    return NULL;
+	Py_RETURN_NONE;
+    }
+
+    BEGIN_SCRATCH(self);
+    dict = _cached_extension(self, position, &exceeded);
+    END_SCRATCH(self);
+    if (exceeded)
+	_budget_error(exceeded);
+    Py_XINCREF(dict);
+    return dict;
+}
+
+static PyObject *
+cx509_has_extension(cx509 *self, PyObject *name)
+{
+    int position = _extension_position(self, name);
+
+    if (position == -2)
+	return NULL;
+    return PyBool_FromLong(position >= 0);
+}
+
+/* the first extension of cert named extension_name (in our OID table) with a non-empty value, or NULL */
+static struct Extension *
+_find_extension(cx509 *cert, const char *extension_name)
+{
+    struct Extensions *extensions = cert->certificate->tbsCertificate.extensions;
+    struct Extension *ext;
+    const oid_entry_t *oid;
+    int i;
+
+    for (i = 0; extensions && i < extensions->list.count; i++) {
+	ext = extensions->list.array[i];
+	if ((oid = _oid_lookup(&ext->extnID)) && oid->name && !strcmp(oid->name, extension_name) && ext->extnValue.size)
+	    return ext;
+    }
+    return NULL;
+}
+
+/*
+ * The subject's (or, with issuer=True, the issuer's) alternative names, or None if the certificate
+ * has none: grouped by form as in extensions(), or with flat=True as one tuple of (type-id, value)
+ * pairs. Decoded once per _parse; both shapes are cached.
+ */
+static PyObject *
+cx509_get_alt_names(cx509 *self, PyObject *args, PyObject *kw)
+{
+    static char *kwlist[] = { "flat", "issuer", NULL };
+    int flat = 0, issuer = 0, exceeded = 0;
+    PyObject **cached, **cached_flat;
+    struct Extension *ext;
+    GeneralNames_t *names = NULL;
+    asn_dec_rval_t rval;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "|ii", kwlist, &flat, &issuer))
+	return NULL;
+    if (!self->certificate) {
+	PyErr_Format(PyExc_ValueError, "empty certificate");
+	return NULL;
+    }
+    if (_need(self, PART(PART_EXTENSIONS)) < 0)
+	return NULL;
+
+    cached_flat = &self->alt_names[issuer ? ALT_NAMES_ISSUER_FLAT : ALT_NAMES_SUBJECT_FLAT];
+    cached = flat ? cached_flat : &self->alt_names[issuer ? ALT_NAMES_ISSUER : ALT_NAMES_SUBJECT];
+    if (!*cached_flat) {
+	if (!(ext = _find_extension(self, issuer ? "issuerAltName" : "subjectAltName"))) {
+	    Py_INCREF(Py_None);
+	    *cached_flat = Py_None;
+	}
+	else {
+	    BEGIN_SCRATCH(self);
+	    rval = _nested_decode(&self->limits, STAT_EXTENSIONS_DECODE, &asn_DEF_GeneralNames, (void **) &names,
+				  (const void *) ext->extnValue.buf, (size_t) ext->extnValue.size, &exceeded);
+	    if (rval.code == RC_OK && names)
+		*cached_flat = _alt_names_flat(names);
+	    else if (!exceeded)
+		PyErr_Format(PyExc_ValueError, "failed to decode %s", issuer ? "issuerAltName" : "subjectAltName");
+	    asn_DEF_GeneralNames.free_struct(&asn_DEF_GeneralNames, (void *) names, 0);
+	    END_SCRATCH(self);
+	    if (exceeded) {
+		Py_CLEAR(*cached_flat);
+		_budget_error(exceeded);
+	    }
+	    if (!*cached_flat)
+		return NULL;
+	}
+    }
+    if (!*cached) {
+	if (*cached_flat == Py_None) {
+	    Py_INCREF(Py_None);
+	    *cached = Py_None;
+	}
+	else if (!(*cached = _frozen(_alt_names_grouped(*cached_flat))))
+	    return NULL;
+    }
+    Py_INCREF(*cached);
+    return *cached;
+}
+
+/*
+ * Find the most specific (last) commonName in name, if its value is one of the string types a
+ * hostname can be spelled in; sets value and len to its contents and returns 0, or returns -1.
+ */
+static int
+_last_common_name(Name_t *name, const uint8_t **value, size_t *len)
+{
+    RDNSequence_t *rdnSequence;
+    AttributeTypeAndValue_t *atv, *cn = NULL;
+    const oid_entry_t *oid;
+    tlv_t tlv;
+    int i, j;
+
+    if (name->present != Name_PR_rdnSequence)
+	return -1;
+    rdnSequence = &name->choice.rdnSequence;
+    for (i = 0; i < rdnSequence->list.count; i++)
+	for (j = 0; j < rdnSequence->list.array[i]->list.count; j++) {
+	    atv = rdnSequence->list.array[i]->list.array[j];
+	    if ((oid = _oid_lookup(&atv->type)) && oid->name && !strcmp(oid->name, "commonName"))
+		cn = atv;
+	}
+    if (!cn || _tlv_at(cn->value.buf, (size_t) cn->value.size, 0, &tlv) < 0 || tlv.constructed ||
+	!(tlv.tag == PRINTABLE_STRING_TAG || tlv.tag == (ber_tlv_tag_t) (12 << 2) /* UTF8String */ ||
+	  tlv.tag == (ber_tlv_tag_t) (20 << 2) /* TeletexString */ || tlv.tag == (ber_tlv_tag_t) (22 << 2) /* IA5String */))
+	return -1;
+    *value = cn->value.buf + tlv.header;
+    *len = tlv.length - tlv.header;
+    return 0;
+}
+
+/*
+ * Set key to a long from the primitive INTEGER TLV at tlv in buf; malformed INTEGERs are left out.
+ * Returns -1 on a Python error.
+ */
+static int
+_set_integer(PyObject *dict, PyObject *key, const uint8_t *buf, const tlv_t *tlv)
+{
+    if (tlv->tag != INTEGER_TAG || tlv->constructed || tlv->length <= tlv->header)
+	return 0;
+    return _set_new(dict, key, _integer_to_long(buf + tlv->offset + tlv->header, tlv->length - tlv->header, 0));
+}
+
+/* set curve and curve_oid for the curve OID with the given content octets */
+static int
+_set_curve(PyObject *dict, const uint8_t *buf, size_t size)
+{
+    OBJECT_IDENTIFIER_t curve;
+    const oid_entry_t *oid;
+    PyObject *dotted;
+    char *printed;
+
+    int result;
+
+    curve.buf = (uint8_t *) buf;
+    curve.size = (int) size;
+    if ((oid = _oid_lookup(&curve))) {
+	if (PyDict_SetItem(dict, INTERNED(curve), oid->py_key) < 0)
+	    return -1;
+	return PyDict_SetItem(dict, INTERNED(curve_oid), oid->py_dotted);
+    }
+    if (!(printed = _oid_to_string(&curve)))
+	return 0;
+    dotted = PyString_FromString(printed);
+    PyMem_Free(printed);
+    if (!dotted)
+	return -1;
+    result = PyDict_SetItem(dict, INTERNED(curve), dotted) < 0 ? -1 : PyDict_SetItem(dict, INTERNED(curve_oid), dotted);
+    Py_DECREF(dotted);
+    return result;
+}
+
+/*
+ * An EC key (RFC 5480): the named curve from ECParameters ::= CHOICE { namedCurve OBJECT IDENTIFIER,
+ * implicitCurve NULL, specifiedCurve SEQUENCE }, and the coordinates from the ECPoint, which is
+ * 04 || x || y uncompressed, 02 or 03 (for odd y) || x compressed, or 06 or 07 || x || y hybrid.
+ * Explicit curve parameters and malformed points are left undecoded. Returns -1 on a Python error.
+ */
+static int
+_ec_public_key(PyObject *dict, SubjectPublicKeyInfo_t *spki)
+{
+    ANY_t *params = spki->algorithm.parameters;
+    const uint8_t *point = spki->subjectPublicKey.buf;
+    size_t size = (size_t) spki->subjectPublicKey.size, n;
+    tlv_t tlv;
+
+    if (params && _tlv_at(params->buf, (size_t) params->size, 0, &tlv) == 0 && tlv.tag == OID_TAG && !tlv.constructed &&
+	tlv.length > tlv.header && _set_curve(dict, params->buf + tlv.header, tlv.length - tlv.header) < 0)
+	return -1;
+
+    if (!point || size < 2 || spki->subjectPublicKey.bits_unused)
+	return 0;
+    switch (point[0]) {
+    case 0x02:
+    case 0x03:
+	n = size - 1;
+	if (PyDict_SetItem(dict, INTERNED(point_format), INTERNED(compressed)) < 0 ||
+	    _set_new(dict, INTERNED(x), _integer_to_long(point + 1, n, 0)) < 0 ||
+	    _set_new(dict, INTERNED(y_parity), PyInt_FromLong(point[0] & 1)) < 0)
+	    return -1;
+	break;
+    case 0x04:
+    case 0x06:
+    case 0x07:
+	if (!(size & 1))
+	    return 0;
+	n = (size - 1) / 2;
+	if (PyDict_SetItem(dict, INTERNED(point_format), point[0] == 0x04 ? INTERNED(uncompressed) : INTERNED(hybrid)) < 0 ||
+	    _set_new(dict, INTERNED(x), _integer_to_long(point + 1, n, 0)) < 0 ||
+	    _set_new(dict, INTERNED(y), _integer_to_long(point + 1 + n, n, 0)) < 0)
+	    return -1;
+	break;
+    }
+    return 0;
+}
+
+/*
+ * A DSA key (RFC 3279): p, q and g from Dss-Parms ::= SEQUENCE { p INTEGER, q INTEGER, g INTEGER },
+ * when present (they may be inherited from the issuer), and y from DSAPublicKey ::= INTEGER.
+ * Returns -1 on a Python error.
+ */
+static int
+_dsa_public_key(PyObject *dict, SubjectPublicKeyInfo_t *spki)
+{
+    static const int names[3] = { S_p, S_q, S_g };
+    ANY_t *params = spki->algorithm.parameters;
+    tlv_t seq, pqg[3], tlv;
+    int i;
+
+    if (params && _tlv_at(params->buf, (size_t) params->size, 0, &seq) == 0 && seq.tag == SEQUENCE_TAG && seq.constructed) {
+	for (i = 0; i < 3; i++) {
+	    if (i)
+		pqg[i] = pqg[i - 1];
+	    if ((i ? TLV_NEXT(params->buf, &seq, &pqg[i]) : TLV_FIRST(params->buf, &seq, &pqg[i])) < 0)
+		break;
+	}
+	for (i = (i == 3 ? 0 : 3); i < 3; i++) /* all three, or none */
+	    if (_set_integer(dict, interned[names[i]], params->buf, &pqg[i]) < 0)
+		return -1;
+    }
+
+    if (spki->subjectPublicKey.buf && !spki->subjectPublicKey.bits_unused &&
+	_tlv_at(spki->subjectPublicKey.buf, (size_t) spki->subjectPublicKey.size, 0, &tlv) == 0)
+	return _set_integer(dict, INTERNED(y), spki->subjectPublicKey.buf, &tlv);
+    return 0;
+}
+
+/*
+ * An Ed25519 or Ed448 key (RFC 8410, RFC 8032): the 32- or 57-octet encoded point, which is y
+ * little-endian with the low bit of x in the top bit of the last octet.
+ * Returns -1 on a Python error.
+ */
+static int
+_eddsa_public_key(PyObject *dict, SubjectPublicKeyInfo_t *spki, const oid_entry_t *oid, size_t size)
+{
+    uint8_t y[57];
+
+    if (PyDict_SetItem(dict, INTERNED(curve), oid->py_key) < 0 || PyDict_SetItem(dict, INTERNED(curve_oid), oid->py_dotted) < 0)
+	return -1;
+    if (!spki->subjectPublicKey.buf || (size_t) spki->subjectPublicKey.size != size || spki->subjectPublicKey.bits_unused)
+	return 0;
+    memcpy(y, spki->subjectPublicKey.buf, size);
+    y[size - 1] &= 0x7f;
+    if (_set_new(dict, INTERNED(y), _PyLong_FromByteArray(y, size, 1 /* little-endian */, 0)) < 0 ||
+	_set_new(dict, INTERNED(x_parity), PyInt_FromLong(spki->subjectPublicKey.buf[size - 1] >> 7)) < 0)
+	return -1;
+    return 0;
+}
+
+static PyObject *
+cx509_get_public_key(cx509 *self)
+{
+    PyObject *dict, *tmp;
+    char *printed = NULL;
+    const char *algorithm_name = NULL;
+    const oid_entry_t *oid;
+    SubjectPublicKeyInfo_t *spki;
+    RSAPublicKey_t *rsapk = NULL;
+    asn_dec_rval_t rval;
+    int exceeded = 0, result = 0;
+
+    MEMO_RETURN(self, MEMO_PUBLIC_KEY);
+    if (!self->certificate) {
+	PyErr_Format(PyExc_ValueError, "empty certificate");
+	return NULL;
+    }
+    if (_need(self, PART(PART_PUBLIC_KEY)) < 0)
+	return NULL;
+
+    dict = PyDict_New();
+    spki = &self->certificate->tbsCertificate.subjectPublicKeyInfo;
+
+    /* TBD: make sure spki->algorithm.parameters is empty, otherwise fail */
+    if ((oid = _oid_lookup(&spki->algorithm.algorithm))) {
+	algorithm_name = oid->name;
+	PyDict_SetItem(dict, INTERNED(algorithm_oid), oid->py_dotted);
+	PyDict_SetItem(dict, INTERNED(algorithm), oid->py_key);
+    }
+    else if ((printed = _oid_to_string(&spki->algorithm.algorithm))) {
+	tmp = PyString_FromString(printed);
+	PyDict_SetItem(dict, INTERNED(algorithm_oid), tmp);
+	PyDict_SetItem(dict, INTERNED(algorithm), tmp);
+	Py_DECREF(tmp);
+    }
+
+    if (self->spans.key.length)
+	tmp = _span_to_memoryview(self, &self->spans.key);
+    else
+	tmp = PyString_FromStringAndSize((void *) spki->subjectPublicKey.buf, spki->subjectPublicKey.size);
+    if (tmp) {
+	PyDict_SetItem(dict, INTERNED(key), tmp);
+	Py_DECREF(tmp);
+    }
+    else
+	PyErr_Clear();
+
+    tmp = PyInt_FromLong(8 * spki->subjectPublicKey.size - spki->subjectPublicKey.bits_unused);
+    PyDict_SetItem(dict, INTERNED(keylen), tmp);
+    Py_DECREF(tmp);
+
+    /* if we know about this algorithm, decode the key */
+    if (algorithm_name && !strcmp(algorithm_name, "rsaEncryption")) {
+	BEGIN_SCRATCH(self);
+	rval = _nested_decode(&self->limits, STAT_PUBLIC_KEY_DECODE, &asn_DEF_RSAPublicKey,
+			  (void **) &rsapk,
+			  (const void *) spki->subjectPublicKey.buf, 
+			  (size_t) spki->subjectPublicKey.size, &exceeded);
+	if (rval.code == RC_OK) {
+	    /* the modulus is usually huge; the public exponent usually small (e.g., 3 or 65537), but we make no assumptions here */
+	    if (rsapk->modulus.buf && rsapk->modulus.size &&
+		_set_new(dict, INTERNED(modulus), _integer_to_long(rsapk->modulus.buf, rsapk->modulus.size, 0)) < 0)
+		result = -1;
+	    if (!result && rsapk->publicExponent.buf && rsapk->publicExponent.size &&
+		_set_new(dict, INTERNED(public_exponent), _integer_to_long(rsapk->publicExponent.buf, rsapk->publicExponent.size, 0)) < 0)
+		result = -1;
+	}
+	asn_DEF_RSAPublicKey.free_struct(&asn_DEF_RSAPublicKey, rsapk, 0);
+	END_SCRATCH(self);
+    }
+    else if (algorithm_name && !strcmp(algorithm_name, "id-ecPublicKey"))
+	result = _ec_public_key(dict, spki);
+    else if (algorithm_name && (!strcmp(algorithm_name, "id-dsa") || !strcmp(algorithm_name, "dsa")))
+	result = _dsa_public_key(dict, spki);
+    else if (algorithm_name && !strcmp(algorithm_name, "Ed25519"))
+	result = _eddsa_public_key(dict, spki, oid, 32);
+    else if (algorithm_name && !strcmp(algorithm_name, "Ed448"))
+	result = _eddsa_public_key(dict, spki, oid, 57);
+
+    if (printed)
+	PyMem_Free(printed);
+
+    if (exceeded || result < 0) {
+	Py_DECREF(dict);
+	if (exceeded)
+	    _budget_error(exceeded);
+	return NULL;
+    }
+    return _memo(self, MEMO_PUBLIC_KEY, dict);
+}
+
+static PyObject *
+cx509_parse_digest_info(cx509 *self, PyObject *args, PyObject *kw)
+{
+    static char *kwlist[] = { "data", NULL };
+    PyObject *dict, *tmp;
+    Py_buffer data;
+    DigestInfo_t *di = NULL;
+    asn_dec_rval_t rval;
+    char *printed;
+    const oid_entry_t *oid;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "s*", kwlist, &data))
+	return NULL;
+
+    BEGIN_SCRATCH(self);
+    rval = ber_decode(0, &asn_DEF_DigestInfo, (void **) &di, data.buf, (size_t) data.len);
+    PyBuffer_Release(&data);
+    if (rval.code == RC_OK) {
+	dict = PyDict_New();
+	if ((oid = _oid_lookup(&di->digestAlgorithm.algorithm))) {
+	    PyDict_SetItem(dict, INTERNED(algorithm_oid), oid->py_dotted);
+	    PyDict_SetItem(dict, INTERNED(algorithm), oid->py_key);
+	}
+	else if ((printed = _oid_to_string(&di->digestAlgorithm.algorithm))) {
+	    tmp = PyString_FromString(printed);
+	    PyDict_SetItem(dict, INTERNED(algorithm_oid), tmp);
+	    PyDict_SetItem(dict, INTERNED(algorithm), tmp);
+	    Py_DECREF(tmp);
+	    PyMem_Free(printed);
+	}
+	if (di->digest.buf && di->digest.size) {
+	    tmp = PyString_FromStringAndSize((void *) di->digest.buf, (size_t) di->digest.size);
+	    PyDict_SetItem(dict, INTERNED(digest), tmp);
+	    Py_DECREF(tmp);
+	}
+    }
+    else {
+	PyErr_Format(PyExc_ValueError, "failed to parse DigestInfo");
+	dict = NULL;
+    }
+    asn_DEF_DigestInfo.free_struct(&asn_DEF_DigestInfo, di, 0);
+    END_SCRATCH(self);
+    return dict;
+}
+
+static PyObject *
+cx509_get_signature_algorithm(cx509 *self, PyObject *args, PyObject *kw)
+{
+    static char *kwlist[] = { "as_oid", NULL };
+    PyObject *as_oid = NULL;
+    char *dotted = NULL;
+    const oid_entry_t *oid;
+    PyObject *retval;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "O", kwlist, &as_oid))
+	return NULL;
+
+    if (!self->certificate) {
+	PyErr_Format(PyExc_ValueError, "empty certificate");
+	return NULL;
+    }
+    if (_need(self, PART(PART_SIGNATURE_ALGORITHM)) < 0)
+	return NULL;
+
+    if ((oid = _oid_lookup(&self->certificate->signatureAlgorithm.algorithm))) {
+	retval = as_oid == Py_True ? oid->py_dotted : oid->py_key;
+	Py_INCREF(retval);
+	return retval;
+    }
+
+    /* an algorithm we don't know, so all we have is the dotted string */
+    if (!(dotted = _oid_to_string(&self->certificate->signatureAlgorithm.algorithm))) {
+	PyErr_Format(PyExc_ValueError, "bad signature algorithm OID");
+	return NULL;
+    }
+    retval = PyString_FromString(dotted);
+    PyMem_Free(dotted);
+    return retval;
+}
+
+static PyObject *
+cx509_get_signature_value(cx509 *self)
+{
+    const unsigned char *signature;
+    size_t len;
+
+    if (!self->certificate) {
+	PyErr_Format(PyExc_ValueError, "empty certificate");
+	return NULL;
+    }
+
+    if (self->spans.signature.length)
+	return _span_to_memoryview(self, &self->spans.signature);
+    if (_need(self, PART(PART_SIGNATURE)) < 0)
+	return NULL;
+
+    signature = self->certificate->signature.buf;
+    len = self->certificate->signature.size;
+    if (!signature || !len) {
+	PyErr_Format(PyExc_ValueError, "missing signature value");
+	return NULL;
+    }
+
+    return PyString_FromStringAndSize((void *) signature, len);
+}
+
+/*
+ * For BER input we return a memoryview on the exact tbsCertificate bytes we decoded, which is what
+ * the signature covers. For XER input there are no original bytes, so we encode as DER again from
+ * scratch.
+ */
+static PyObject *
+cx509_get_tbs_certificate_data(cx509 *self)
+{
+    if (!self->certificate) {
+	PyErr_Format(PyExc_ValueError, "empty certificate");
+	return NULL;
+    }
+
+    if (self->spans.tbs.length)
+	return _span_to_memoryview(self, &self->spans.tbs);
+    if (_need(self, PARTS_ALL) < 0)
+	return NULL;
+    return _der_encode(self, &asn_DEF_TBSCertificate, &self->certificate->tbsCertificate);
+}
+
+/* encode sptr, a td within self's tree, as DER into a new string */
+static PyObject *
+_der_encode(cx509 *self, asn_TYPE_descriptor_t *td, void *sptr)
+{
+    asn_enc_rval_t er;  /* Encoder return value */
+    size_t count = 0;
+    void *output;
+    PyObject *s;
+
+    /* count number of bytes */
+    BEGIN_ALLOW_THREADS(self);
+    er = der_encode(td, sptr, NULL, NULL);
+    END_ALLOW_THREADS(self);
+    if (er.encoded == -1) {
+	PyErr_Format(PyExc_ValueError, "failed to encode %s as DER (count)", td->name);
+	return NULL; /* Failed to encode the data. */
+    }
+    else
+        count = er.encoded; /* Return the number of bytes */
+
+    /* allocate the result string and encode straight into it */
+    s = PyString_FromStringAndSize(NULL, count);
+    if (!s)
+	return NULL;
+    output = PyString_AS_STRING(s);
+
+    BEGIN_ALLOW_THREADS(self);
+    er = der_encode(td, sptr, _print2buffer, (void *) &output);
+    END_ALLOW_THREADS(self);
+    if (er.encoded == -1) {
+	Py_DECREF(s);
+	PyErr_Format(PyExc_ValueError, "failed to encode %s as DER (print)", td->name);
+	return NULL; /* Failed to encode the data. */
+    }
+
+    return s;
+}
+
+/*
+ * Compute the SHA-1 or SHA-256 of the certificate's encoding into self, unless it is already
+ * cached there: the exact bytes we decoded for BER input, or a DER encoding for XER input, which
+ * has none. Returns -1 with an exception set on failure.
+ */
+static int
+_fingerprint(cx509 *self, int algorithm)
+{
+    PyObject *der = NULL;
+    const unsigned char *data;
+    size_t len;
+
+    if (self->digests & algorithm)
+	return 0;
+    if (self->spans.certificate.length) {
+	data = (const unsigned char *) self->source.buf + self->spans.certificate.offset;
+	len = (size_t) self->spans.certificate.length;
+    }
+    else {
+	if (_need(self, PARTS_ALL) < 0 || !(der = _der_encode(self, &asn_DEF_Certificate, self->certificate)))
+	    return -1;
+	data = (const unsigned char *) PyString_AS_STRING(der);
+	len = (size_t) PyString_GET_SIZE(der);
+    }
+
+    BEGIN_ALLOW_THREADS(self);
+    _sha_digest(algorithm, data, len, algorithm == DIGEST_SHA1 ? self->sha1 : self->sha256);
+    END_ALLOW_THREADS(self);
+    self->digests |= algorithm;
+    Py_XDECREF(der);
+    return 0;
+}
+
+static PyObject *
+cx509_fingerprint(cx509 *self, PyObject *args, PyObject *kw)
+{
+    static char *kwlist[] = { "algorithm", NULL };
+    const char *name = "sha256";
+    int algorithm;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "|s", kwlist, &name))
+	return NULL;
+
+    if (!strcmp(name, "sha256") || !strcmp(name, "SHA256"))
+	algorithm = DIGEST_SHA256;
+    else if (!strcmp(name, "sha1") || !strcmp(name, "SHA1"))
+	algorithm = DIGEST_SHA1;
+    else {
+	PyErr_Format(PyExc_ValueError, "unknown fingerprint algorithm %s", name);
+	return NULL;
+    }
+
+    if (!self->certificate) {
+	PyErr_Format(PyExc_ValueError, "empty certificate");
+	return NULL;
+    }
+
+    if (_fingerprint(self, algorithm) < 0)
+	return NULL;
+    return PyString_FromStringAndSize((const char *) (algorithm == DIGEST_SHA1 ? self->sha1 : self->sha256),
+				      DIGEST_SIZE(algorithm));
+}
+
+/*
+ * Certificates hash and compare equal by the SHA-256 of their encoding, so the same certificate
+ * parsed twice is one set member or dict key. Empty objects fall back to identity. As with any
+ * mutable key, don't _parse an object while it is in a set or dict.
+ */
+static long
+cx509_hash(cx509 *self)
+{
+    long hash;
+
+    if (!self->certificate)
+	return _Py_HashPointer(self);
+    if (_fingerprint(self, DIGEST_SHA256) < 0)
+	return -1;
+    memcpy(&hash, self->sha256, sizeof(hash));
+    return hash == -1 ? -2 : hash;
+}
+
+static PyObject *
+cx509_richcompare(PyObject *a, PyObject *b, int op)
+{
+    cx509 *x = (cx509 *) a, *y = (cx509 *) b;
+    PyObject *result;
+    int equal;
+
+    if ((op != Py_EQ && op != Py_NE) || !PyObject_TypeCheck(a, &cx509Type) || !PyObject_TypeCheck(b, &cx509Type)) {
+	Py_INCREF(Py_NotImplemented);
+	return Py_NotImplemented;
+    }
+
+    if (a == b)
+	equal = 1;
+    else if (!x->certificate || !y->certificate)
+	equal = 0;
+    else {
+	if (_fingerprint(x, DIGEST_SHA256) < 0 || _fingerprint(y, DIGEST_SHA256) < 0)
+	    return NULL;
+	equal = !memcmp(x->sha256, y->sha256, sizeof(x->sha256));
+    }
+    result = equal == (op == Py_EQ) ? Py_True : Py_False;
+    Py_INCREF(result);
+    return result;
+}
+
+static char *
+_oid_to_string(OBJECT_IDENTIFIER_t *oid)
+{
+    size_t count = 0;
+    void *allocated, *output;
+
+    if (!oid)
+	return NULL;
+
+    if (OBJECT_IDENTIFIER_print(NULL, (const void *) oid, 0, _print2count, (void *) &count))
+	return NULL;
+
+    /* allocate and print to allocated buffer */
+    allocated = output = PyMem_Malloc(count + 1);
+
+    /* write the output */
+    if (OBJECT_IDENTIFIER_print(NULL, (const void *) oid, 0, _print2buffer, (void *) &output)) {
+	PyMem_Free(output);
+	return NULL;
+    }
+    
+    *((char *) output) = 0; /* null-terminate */
+
+    return allocated;
+}
+
+/* FNV-1a over the DER content octets of an OID */
+static uint32_t
+_oid_hash(const uint8_t *buf, size_t size)
+{
+    uint32_t hash = 2166136261u;
+
+    while (size--) {
+	hash ^= *buf++;
+	hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * Encode a dotted OID string (with or without the "{ ... }" that OBJECT_IDENTIFIER_print adds) as
+ * DER content octets. Returns the encoded length, or -1 if the string is malformed or the encoding
+ * doesn't fit in room bytes.
+ */
+static Py_ssize_t
+_oid_encode_dotted(const char *dotted, uint8_t *out, size_t room)
+{
+    unsigned long arcs[OID_MAX_DER], arc;
+    size_t narcs = 0, len = 0, i, n;
+    const char *p = dotted;
+
+    while (*p == '{' || *p == ' ')
+	p++;
+    for (;;) {
+	if (!isdigit((unsigned char) *p) || narcs == OID_MAX_DER)
+	    return -1;
+	for (arc = 0; isdigit((unsigned char) *p); p++) {
+	    if (arc > (~0UL - 9) / 10)
+		return -1;
+	    arc = arc * 10 + (*p - '0');
+	}
+	arcs[narcs++] = arc;
+	if (*p != '.')
+	    break;
+	p++;
+    }
+    while (*p == ' ' || *p == '}')
+	p++;
+    if (*p || narcs < 2 || arcs[0] > 2 || (arcs[0] < 2 && arcs[1] > 39) || arcs[1] > ~0UL - 80)
+	return -1;
+
+    /* the first two arcs share a subidentifier */
+    arcs[1] += 40 * arcs[0];
+    for (i = 1; i < narcs; i++) {
+	/* base 128, most significant group first, high bit set on all but the last */
+	for (n = 1, arc = arcs[i] >> 7; arc; arc >>= 7)
+	    n++;
+	if (len + n > room)
+	    return -1;
+	len += n;
+	out[len - 1] = arcs[i] & 0x7f;
+	for (n = len - 1, arc = arcs[i] >> 7; arc; arc >>= 7)
+	    out[--n] = 0x80 | (arc & 0x7f);
+    }
+    return (Py_ssize_t) len;
+}
+
+/* find the slot for the given content octets: either the matching entry or the empty slot where it would go */
+static oid_entry_t *
+_oid_slot(const uint8_t *buf, size_t size, uint32_t hash)
+{
+    size_t i;
+
+    for (i = hash & oid_table_mask; oid_table[i].len; i = (i + 1) & oid_table_mask)
+	if (oid_table[i].hash == hash && oid_table[i].len == size && !memcmp(oid_table[i].der, buf, size))
+	    break;
+    return &oid_table[i];
+}
+
+/* add a name from one of the static tables; returns -1 with ValueError if the dotted string is malformed */
+static int
+_oid_table_add(const oid_t *oid, int shortname)
+{
+    uint8_t der[OID_MAX_DER];
+    Py_ssize_t len;
+    uint32_t hash;
+    oid_entry_t *entry;
+
+    if ((len = _oid_encode_dotted(oid->dotted, der, sizeof(der))) <= 0) {
+	PyErr_Format(PyExc_ValueError, "bad OID in table: %s", oid->dotted);
+	return -1;
+    }
+    hash = _oid_hash(der, (size_t) len);
+    entry = _oid_slot(der, (size_t) len, hash);
+    if (!entry->len) {
+	memcpy(entry->der, der, (size_t) len);
+	entry->len = (size_t) len;
+	entry->hash = hash;
+	entry->dotted = oid->dotted;
+    }
+    if (shortname)
+	entry->short_name = oid->name;
+    else
+	entry->name = oid->name;
+    return 0;
+}
+
+/* build oid_table from OIDs[] and OID_short_names[]; called once from module init */
+static int
+_oid_table_init(void)
+{
+    size_t count = 0, size;
+    int i;
+
+    for (i = 0; OIDs[i].dotted; i++)
+	count++;
+    for (i = 0; OID_short_names[i].dotted; i++)
+	count++;
+    /* at most half full, so probe sequences stay short */
+    for (size = 16; size < 2 * count; size <<= 1)
+	;
+    if (!(oid_table = PyMem_Malloc(size * sizeof(oid_entry_t)))) {
+	PyErr_NoMemory();
+	return -1;
+    }
+    memset(oid_table, 0, size * sizeof(oid_entry_t));
+    oid_table_mask = size - 1;
+
+    for (i = 0; OIDs[i].dotted; i++)
+	if (_oid_table_add(&OIDs[i], /*shortname:*/ 0) < 0)
+	    return -1;
+    for (i = 0; OID_short_names[i].dotted; i++)
+	if (_oid_table_add(&OID_short_names[i], /*shortname:*/ 1) < 0)
+	    return -1;
+    for (size = 0; size <= oid_table_mask; size++)
+	if (oid_table[size].len && _oid_entry_strings(&oid_table[size], /*intern:*/ 1) < 0)
+	    return -1;
+    return 0;
+}
+
+/* attach extension_decoders[] to the OID table; called once from module init, after _oid_table_init() */
+static int
+_extension_decoders_init(void)
+{
+    uint8_t der[OID_MAX_DER];
+    Py_ssize_t len;
+    oid_entry_t *entry;
+    int i;
+
+    for (i = 0; extension_decoders[i].dotted; i++) {
+	if ((len = _oid_encode_dotted(extension_decoders[i].dotted, der, sizeof(der))) <= 0 ||
+	    !(entry = _oid_slot(der, (size_t) len, _oid_hash(der, (size_t) len)))->len) {
+	    PyErr_Format(PyExc_ValueError, "extension decoder for OID not in table: %s", extension_decoders[i].dotted);
+	    return -1;
+	}
+	entry->decoder = &extension_decoders[i];
+    }
+    return 0;
+}
+
+/**
+ * Look up a decoded OID by its content octets. Returns NULL if we don't know it.
+ */
+static const oid_entry_t *
+_oid_lookup(const OBJECT_IDENTIFIER_t *oid)
+{
+    const oid_entry_t *entry;
+
+    if (!oid || !oid->buf || oid->size <= 0 || oid->size > OID_MAX_DER)
+	return NULL;
+    entry = _oid_slot(oid->buf, (size_t) oid->size, _oid_hash(oid->buf, (size_t) oid->size));
+    return entry->len ? entry : NULL;
+}
+
+/*
+ * Create an entry's Python strings from its dotted string and name; interned for the static table,
+ * plain for the temporary entries we make for OIDs we don't know. Returns -1 on failure.
+ */
+static int
+_oid_entry_strings(oid_entry_t *entry, int intern)
+{
+    const char *key = entry->name ? entry->name : entry->dotted;
+
+    entry->py_dotted = PyString_FromString(entry->dotted);
+    entry->py_key = PyString_FromString(key);
+    entry->py_encoding_key = PyString_FromFormat("%s:encoding", key);
+    entry->py_oid_key = PyString_FromFormat("%s:oid", key);
+    if (!entry->py_dotted || !entry->py_key || !entry->py_encoding_key || !entry->py_oid_key) {
+	_oid_entry_clear(entry);
+	return -1;
+    }
+    if (intern) {
+	PyString_InternInPlace(&entry->py_dotted);
+	PyString_InternInPlace(&entry->py_key);
+	PyString_InternInPlace(&entry->py_encoding_key);
+	PyString_InternInPlace(&entry->py_oid_key);
+    }
+    return 0;
+}
+
+static void
+_oid_entry_clear(oid_entry_t *entry)
+{
+    Py_CLEAR(entry->py_dotted);
+    Py_CLEAR(entry->py_key);
+    Py_CLEAR(entry->py_encoding_key);
+    Py_CLEAR(entry->py_oid_key);
+}
+
+/* create the interned[] strings; called once from module init */
+static int
+_interned_init(void)
+{
+    static const char *text[S_COUNT] = {
+#define X(id, text) text,
+	INTERNED_STRINGS(X)
+#undef X
+    };
+    int i;
+
+    for (i = 0; i < S_COUNT; i++)
+	if (!(interned[i] = PyString_InternFromString(text[i])))
+	    return -1;
+    return 0;
+}
+
+/*
+ * An INTEGER's content octets as a Python long, converted straight from the big-endian bytes.
+ * Serial numbers are two's complement, as DER has it; key values are taken as unsigned, so a
+ * modulus missing its leading zero octet still comes out positive. 0 for an empty INTEGER.
+ */
+static PyObject *
+_integer_to_long(const uint8_t *buf, size_t size, int is_signed)
+{
+    return _PyLong_FromByteArray(buf, size, 0 /* big-endian */, is_signed);
+}
+
+static void
+cx509_free(cx509 *self)
+{
+    int i;
+
+    _free_certificate(self->shared ? NULL : self->certificate, &self->arena);
+    self->certificate = NULL;
+    Py_CLEAR(self->shared);
+    PyBuffer_Release(&self->source);
+    Py_XDECREF(self->subject_key);
+    Py_XDECREF(self->issuer_key);
+    Py_XDECREF(self->extension_index);
+    Py_XDECREF(self->extension_cache);
+    for (i = 0; i < ALT_NAMES_COUNT; i++)
+	Py_XDECREF(self->alt_names[i]);
+    for (i = 0; i < MEMO_COUNT; i++)
+	Py_XDECREF(self->memo[i]);
+    Py_TYPE(self)->tp_free(self);
+}
+
+/* wrappers counting and timing the methods in cx509_methods (and tp_str); see "Instrumentation" */
+#ifdef CX509_STATS
+#define TIMED(method) method##_timed
+#define TIMED_NOARGS(method, site)								\
+    static PyObject *method##_timed(cx509 *self) {						\
+	uint64_t start;										\
+	PyObject *result;									\
+	STAT_START(site, start);								\
+	result = method(self);									\
+	STAT_DONE(site, start, 0, -1);								\
+	return result;										\
+    }
+#define TIMED_ONEARG(method, site)								\
+    static PyObject *method##_timed(cx509 *self, PyObject *arg) {				\
+	uint64_t start;										\
+	PyObject *result;									\
+	STAT_START(site, start);								\
+	result = method(self, arg);								\
+	STAT_DONE(site, start, 0, -1);								\
+	return result;										\
+    }
+#define TIMED_KEYWORDS(method, site)								\
+    static PyObject *method##_timed(cx509 *self, PyObject *args, PyObject *kw) {		\
+	uint64_t start;										\
+	PyObject *result;									\
+	STAT_START(site, start);								\
+	result = method(self, args, kw);							\
+	STAT_DONE(site, start, 0, -1);								\
+	return result;										\
+    }
+TIMED_NOARGS(cx509_get_version, STAT_GET_VERSION)
+TIMED_NOARGS(cx509_get_serial_number, STAT_GET_SERIAL_NUMBER)
+TIMED_NOARGS(cx509_get_validity, STAT_GET_VALIDITY)
+TIMED_NOARGS(cx509_get_validity_epoch, STAT_GET_VALIDITY_EPOCH)
+TIMED_NOARGS(cx509_get_issuer, STAT_GET_ISSUER)
+TIMED_NOARGS(cx509_get_subject, STAT_GET_SUBJECT)
+TIMED_NOARGS(cx509_get_issuer_key, STAT_GET_ISSUER_KEY)
+TIMED_NOARGS(cx509_get_subject_key, STAT_GET_SUBJECT_KEY)
+TIMED_NOARGS(cx509_get_public_key, STAT_GET_PUBLIC_KEY)
+TIMED_KEYWORDS(cx509_get_signature_algorithm, STAT_GET_SIGNATURE_ALGORITHM)
+TIMED_NOARGS(cx509_get_signature_value, STAT_GET_SIGNATURE_VALUE)
+TIMED_NOARGS(cx509_get_tbs_certificate_data, STAT_GET_TBS_CERTIFICATE_DATA)
+TIMED_KEYWORDS(cx509_parse_digest_info, STAT_PARSE_DIGEST_INFO)
+TIMED_NOARGS(cx509_extensions, STAT_EXTENSIONS)
+TIMED_ONEARG(cx509_get_extension, STAT_GET_EXTENSION)
+TIMED_ONEARG(cx509_has_extension, STAT_HAS_EXTENSION)
+TIMED_KEYWORDS(cx509_get_alt_names, STAT_GET_ALT_NAMES)
+TIMED_KEYWORDS(cx509_fingerprint, STAT_FINGERPRINT)
+TIMED_NOARGS(cx509___str__, STAT_STR)
+#else
+#define TIMED(method) method
+#endif
+
+static PyMemberDef cx509_members[] = {
+    {NULL}  /* Sentinel */
+};
+
+static PyMethodDef cx509_methods[] = {
+    {"_parse", (PyCFunction) cx509_parse, METH_VARARGS|METH_KEYWORDS, "Parse the provided BER/DER/CER binary (or the first certificate in PEM text, with format=\"pem\"), from any object supporting the buffer interface. With zero_copy=True the object keeps the buffer itself instead of a copy (except for objects with only an old-style buffer, such as mmap, which can be closed under it and so are always copied). With fields (a sequence of \"version\", \"serial_number\", \"issuer\", \"validity\", \"subject\", \"public_key\", \"extensions\" or \"san\", \"signature_algorithm\" and \"signature\"), BER input decodes only those components up front; the rest are decoded when first needed. max_size (bytes), max_depth (nesting levels, at most 256; with any limit set, input nested deeper than 256 levels is over budget), max_elements (BER elements) and max_ns (nanoseconds) bound the decode, here and in the object's later extension and public key decodes; a decode over budget raises BudgetExceeded, a ValueError. With format=\"xer\" only max_size and max_ns bound the certificate decode itself (max_depth and max_elements count BER headers), though all four still bound the later decodes, which are BER." },
+    {"get_version", (PyCFunction) TIMED(cx509_get_version), METH_NOARGS, "Return the certificate version." },
+    {"get_serial_number", (PyCFunction) TIMED(cx509_get_serial_number), METH_NOARGS, "Return the certificate serial number as a long (negative if the certificate encodes it so). Cached until the next _parse." },
+    {"get_validity", (PyCFunction) TIMED(cx509_get_validity), METH_NOARGS, "Return (earliest, latest) valid date/time. Cached until the next _parse." },
+    {"get_validity_epoch", (PyCFunction) TIMED(cx509_get_validity_epoch), METH_NOARGS, "Return (earliest, latest) valid time as seconds since the epoch (None if missing or malformed)." },
+    {"get_issuer", (PyCFunction) TIMED(cx509_get_issuer), METH_NOARGS, "Return a read-only dict with information about the certificate issuer. Cached until the next _parse." },
+    {"get_subject", (PyCFunction) TIMED(cx509_get_subject), METH_NOARGS, "Return a read-only dict with information about the certificate subject. Cached until the next _parse." },
+    {"get_issuer_key", (PyCFunction) TIMED(cx509_get_issuer_key), METH_NOARGS, "Return a (hash, encoding) tuple for the issuer name, normalized for comparison as RFC 5280 requires; equal names have equal keys." },
+    {"get_subject_key", (PyCFunction) TIMED(cx509_get_subject_key), METH_NOARGS, "Return a (hash, encoding) tuple for the subject name, normalized for comparison as RFC 5280 requires; equal names have equal keys." },
+    {"get_public_key", (PyCFunction) TIMED(cx509_get_public_key), METH_NOARGS, "Return a read-only dict with information about the public key: its algorithm, raw key and keylen in bits, plus modulus and public_exponent for RSA; curve, curve_oid, point_format (uncompressed, compressed or hybrid), x and y (or, compressed, y_parity) for EC keys on a named curve; p, q and g (if present) and y for DSA; curve, y and x_parity for Ed25519 and Ed448. Cached until the next _parse." },
+    {"get_signature_algorithm", (PyCFunction) TIMED(cx509_get_signature_algorithm), METH_VARARGS|METH_KEYWORDS, "Return the name of the signature algorithm." },
+    {"get_signature_value", (PyCFunction) TIMED(cx509_get_signature_value), METH_NOARGS, "Return the raw, encrypted signature data as a memoryview (a string for XER input)." },
+    {"get_tbs_certificate_data", (PyCFunction) TIMED(cx509_get_tbs_certificate_data), METH_NOARGS, "Return the raw ASN.1 data for the tbsCertificate component of the certificate, as a memoryview on the original bytes (a DER string for XER input)." },
+    {"parse_digest_info", (PyCFunction) TIMED(cx509_parse_digest_info), METH_VARARGS|METH_KEYWORDS, "Parse the decrypted signature value and return a dict for the resulting DisgestInfo." },
+    {"extensions", (PyCFunction) TIMED(cx509_extensions), METH_NOARGS, "Return a tuple of the extensions, each a read-only dict with its name and critical flag, plus the decoded fields of keyUsage, subjectAltName, issuerAltName, basicConstraints, subjectKeyIdentifier, authorityKeyIdentifier, extendedKeyUsage, cRLDistributionPoints, authorityInfoAccess, certificatePolicies and nameConstraints. Cached until the next _parse." },
+    {"get_extension", (PyCFunction) TIMED(cx509_get_extension), METH_O, "Return the read-only dict extensions() gives for the extension with the given name or OID (dotted, with or without braces), or None if the certificate has no such extension. Only that extension is decoded, and only the first time it is asked for." },
+    {"has_extension", (PyCFunction) TIMED(cx509_has_extension), METH_O, "Return whether the certificate has the extension with the given name or OID, without decoding it." },
+    {"get_alt_names", (PyCFunction) TIMED(cx509_get_alt_names), METH_VARARGS|METH_KEYWORDS, "Return the subjectAltName (or, with issuer=True, issuerAltName) names, or None if there are none: a read-only dict from each GeneralName form present (dNSName, iPAddress, ...) to a frozenset of its values (a tuple, for directoryName and ediPartyName), or with flat=True one tuple of (type_id, value) pairs, type_id being the form's tag number (2 for dNSName, 7 for iPAddress, ...). iPAddress values are the packed 4- or 16-byte address. Decoded once and cached until the next _parse." },
+    {"fingerprint", (PyCFunction) TIMED(cx509_fingerprint), METH_VARARGS|METH_KEYWORDS, "Return the SHA-256 (or, with algorithm=\"sha1\", SHA-1) digest of the certificate's original encoding, as a string." },
+
+    {NULL}  /* Sentinel */
+};
+
+static PyTypeObject cx509Type = {
+    PyObject_HEAD_INIT(NULL)
+    0,						/*ob_size*/
+    "cx509.cx509",  				/*tp_name*/
+    sizeof(cx509),  				/*tp_basicsize*/
+    0,                         			/*tp_itemsize*/
+    (destructor) cx509_free,   			/*tp_dealloc*/
+    0,                         			/*tp_print*/
+    0,                         			/*tp_getattr*/
+    0,                         			/*tp_setattr*/
+    0,                         			/*tp_compare*/
+    0,                         			/*tp_repr*/
+    0,                         			/*tp_as_number*/
+    0,                         			/*tp_as_sequence*/
+    0,                         			/*tp_as_mapping*/
+    (hashfunc) cx509_hash,			/*tp_hash */
+    0, 	                       			/*tp_call*/
+    (reprfunc) TIMED(cx509___str__),		/*tp_str*/
+    0,                         			/*tp_getattro*/
+    0,                         			/*tp_setattro*/
+    0,                         			/*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,	/*tp_flags*/
+    "cx509 objects",				/* tp_doc */
+    0,		               			/* tp_traverse */
+    0,		               			/* tp_clear */
+    cx509_richcompare,				/* tp_richcompare */
+    0,		               			/* tp_weaklistoffset */
+    0,		               			/* tp_iter */
+    0,		        			/* tp_iternext */
+    cx509_methods,  				/* tp_methods */
+    cx509_members,  				/* tp_members */
+    0,                         			/* tp_getset */
+    0,                         			/* tp_base */
+    0,                         			/* tp_dict */
+    0,                         			/* tp_descr_get */
+    0,                         			/* tp_descr_set */
+    0,                         			/* tp_dictoffset */
+    (initproc)cx509_init,			/* tp_init */
+    0,                        			/* tp_alloc */
+    cx509_new,    				/* tp_new */
+};
+
+
+/*
+ * Arena allocator for asn1c decode trees. The asn1c runtime and the generated PKIX/PKCS1 sources
+ * are built with malloc, calloc, realloc and free redirected to the cx509_arena_* functions below
+ * (see setup.py). While a thread has a current arena, allocations are bumped out of its blocks and
+ * free is a no-op (other than giving back the most recent allocation); otherwise everything goes to
+ * the C library as before. A tree decoded into an arena is freed, or reset for the next _parse, by
+ * dropping the arena's blocks rather than walking it with free_struct.
+ */
+struct arena_block {
+    arena_block *next;	/* the next older block */
+    size_t size;	/* bytes of data following the block header */
+    size_t used;
+};
+#define BLOCK_DATA(block) ((char *) (block) + ARENA_ROUND(sizeof(arena_block)))
+
+/* allocator calls made by this thread, for _alloc_stats() */
+static THREAD_LOCAL struct {
+    unsigned long malloc;	/* C library allocations (including arena blocks) */
+    unsigned long free;		/* C library frees */
+    unsigned long arena;	/* allocations served from an arena */
+} alloc_counts;
+
+static void *
+_arena_alloc(cx509_arena *arena, size_t size)
+{
+    arena_block *block = arena->head;
+    size_t need, block_size;
+    char *p;
+
+    if (size > ((size_t) -1) / 4)
+	return NULL;
+    need = ARENA_HEADER + ARENA_ROUND(size);
+    if (!block || block->size - block->used < need) {
+	/* each block is at least twice the size of the last, so a tree needs only a few */
+	block_size = block ? 2 * block->size : (arena->hint > ARENA_MIN_BLOCK ? arena->hint : ARENA_MIN_BLOCK);
+	if (block_size < need)
+	    block_size = need;
+	if (!(block = malloc(ARENA_ROUND(sizeof(arena_block)) + block_size)))
+	    return NULL;
+	alloc_counts.malloc++;
+	block->next = arena->head;
+	block->size = block_size;
+	block->used = 0;
+	arena->head = block;
+    }
+    p = BLOCK_DATA(block) + block->used;
+    block->used += need;
+    *(size_t *) p = size;
+    alloc_counts.arena++;
+    return arena->last = p + ARENA_HEADER;
+}
+
+/* is p an allocation from arena? */
+static int
+_arena_owns(const cx509_arena *arena, const void *p)
+{
+    const arena_block *block;
+
+    for (block = arena->head; block; block = block->next)
+	if ((const char *) p >= BLOCK_DATA(block) && (const char *) p < BLOCK_DATA(block) + block->used)
+	    return 1;
+    return 0;
+}
+
+static arena_mark
+_arena_mark(const cx509_arena *arena)
+{
+    arena_mark mark;
+
+    mark.head = arena->head;
+    mark.used = arena->head ? arena->head->used : 0;
+    return mark;
+}
+
+/* give back everything allocated from arena since mark was taken */
+static void
+_arena_rewind(cx509_arena *arena, arena_mark mark)
+{
+    arena_block *block;
+
+    while ((block = arena->head) != mark.head) {
+	arena->head = block->next;
+	free(block);
+	alloc_counts.free++;
+    }
+    if (block)
+	block->used = mark.used;
+    arena->last = NULL;
+}
+
+/* empty arena for reuse, keeping only its newest (and largest) block */
+static void
+_arena_reset(cx509_arena *arena)
+{
+    arena_block *block, *next;
+
+    if (!arena->head)
+	return;
+    for (block = arena->head->next; block; block = next) {
+	next = block->next;
+	free(block);
+	alloc_counts.free++;
+    }
+    arena->head->next = NULL;
+    arena->head->used = 0;
+    arena->last = NULL;
+}
+
+static void
+_arena_release(cx509_arena *arena)
+{
+    arena_mark empty = { NULL, 0 };
+
+    _arena_rewind(arena, empty);
+}
+
+/* free a decoded certificate, and the arena it may have been decoded into */
+static void
+_free_certificate(Certificate_t *certificate, cx509_arena *arena)
+{
+    if (certificate && !_arena_owns(arena, certificate))
+	asn_DEF_Certificate.free_struct(&asn_DEF_Certificate, certificate, 0);
+    _arena_release(arena);
+}
+
+/*
+ * The allocator entry points the asn1c sources are built against. These are the only non-static
+ * functions in the module.
+ */
+void *
+cx509_arena_malloc(size_t size)
+{
+    if (current_budget && _budget_tick(current_budget) < 0)
+	return NULL;
+    if (current_arena)
+	return _arena_alloc(current_arena, size);
+    alloc_counts.malloc++;
+    return malloc(size);
+}
+
+void *
+cx509_arena_calloc(size_t nmemb, size_t size)
+{
+    void *p;
+
+    if (current_budget && _budget_tick(current_budget) < 0)
+	return NULL;
+    if (!current_arena) {
+	alloc_counts.malloc++;
+	return calloc(nmemb, size);
+    }
+    if (size && nmemb > ((size_t) -1) / size)
+	return NULL;
+    if ((p = _arena_alloc(current_arena, nmemb * size)))
+	memset(p, 0, nmemb * size);
+    return p;
+}
+
+void *
+cx509_arena_realloc(void *ptr, size_t size)
+{
+    cx509_arena *arena = current_arena;
+    arena_block *block;
+    size_t old, offset;
+    void *p;
+
+    if (current_budget && _budget_tick(current_budget) < 0)
+	return NULL;
+    if (!arena || (ptr && !_arena_owns(arena, ptr))) {
+	alloc_counts.malloc++;
+	return realloc(ptr, size);
+    }
+    if (!ptr)
+	return _arena_alloc(arena, size);
+
+    old = *(size_t *) ((char *) ptr - ARENA_HEADER);
+    block = arena->head;
+    offset = (char *) ptr - BLOCK_DATA(block);
+    if (ptr == arena->last && size <= ((size_t) -1) / 4 && ARENA_ROUND(size) <= block->size - offset) {
+	/* the most recent allocation (typically a growing buffer or list) can be resized in place */
+	block->used = offset + ARENA_ROUND(size);
+	*(size_t *) ((char *) ptr - ARENA_HEADER) = size;
+	return ptr;
+    }
+    if ((p = _arena_alloc(arena, size)))
+	memcpy(p, ptr, old < size ? old : size);
+    return p;
+}
+
+void
+cx509_arena_free(void *ptr)
+{
+    cx509_arena *arena = current_arena;
+
+    if (!ptr)
+	return;
+    if (arena && _arena_owns(arena, ptr)) {
+	if (ptr == arena->last) {
+	    arena->head->used = (char *) ptr - ARENA_HEADER - BLOCK_DATA(arena->head);
+	    arena->last = NULL;
+	}
+	return;
+    }
+    alloc_counts.free++;
+    free(ptr);
+}
+
+static PyObject *
+cx509__use_arena(PyObject *module, PyObject *args)
+{
+    PyObject *previous = arena_enabled ? Py_True : Py_False;
+    int enabled;
+
+    if (!PyArg_ParseTuple(args, "i", &enabled))
+	return NULL;
+    arena_enabled = enabled != 0;
+    Py_INCREF(previous);
+    return previous;
+}
+
+static PyObject *
+cx509__alloc_stats(PyObject *module)
+{
+    return Py_BuildValue("{s:k,s:k,s:k}", "malloc", alloc_counts.malloc, "free", alloc_counts.free,
+			 "arena", alloc_counts.arena);
+}
+
+#ifdef CX509_STATS
+/* the sums of every thread's counts; other threads may be counting as we read */
+static void
+_stat_sum(stat_site *sums)
+{
+    stat_block *block;
+    int i, j;
+
+    memset(sums, 0, STAT_COUNT * sizeof(stat_site));
+    PyThread_acquire_lock(stat_lock, WAIT_LOCK);
+    for (block = stat_blocks; block; block = block->next)
+	for (i = 0; i < STAT_COUNT; i++) {
+	    sums[i].calls += block->sites[i].calls;
+	    sums[i].bytes += block->sites[i].bytes;
+	    sums[i].ns += block->sites[i].ns;
+	    for (j = 0; j <= RC_FAIL; j++)
+		sums[i].failures[j] += block->sites[i].failures[j];
+	    for (j = 0; j < STAT_BUCKETS; j++)
+		sums[i].latency[j] += block->sites[i].latency[j];
+	}
+    PyThread_release_lock(stat_lock);
+}
+#endif
+
+static PyObject *
+cx509_stats(PyObject *module)
+{
+    PyObject *result = PyDict_New();
+#ifdef CX509_STATS
+    stat_site sums[STAT_COUNT], *s, *base;
+    PyObject *latency, *site;
+    int i, j;
+
+    if (!result)
+	return NULL;
+    _stat_sum(sums);
+    for (i = 0; i < STAT_COUNT; i++) {
+	s = &sums[i];
+	base = &stat_baseline[i];
+	if (!(latency = PyList_New(STAT_BUCKETS))) {
+	    Py_DECREF(result);
+	    return NULL;
+	}
+	for (j = 0; j < STAT_BUCKETS; j++)
+	    PyList_SET_ITEM(latency, j, PyLong_FromUnsignedLongLong(s->latency[j] - base->latency[j]));
+	site = Py_BuildValue("{s:K,s:K,s:K,s:{s:K,s:K},s:N}",
+			     "calls", s->calls - base->calls, "bytes", s->bytes - base->bytes, "ns", s->ns - base->ns,
+			     "failures", "wmore", s->failures[RC_WMORE] - base->failures[RC_WMORE],
+			     "fail", s->failures[RC_FAIL] - base->failures[RC_FAIL], "latency", latency);
+	if (!site || PyDict_SetItemString(result, stat_names[i], site) < 0) {
+	    Py_XDECREF(site);
+	    Py_DECREF(result);
+	    return NULL;
+	}
+	Py_DECREF(site);
+    }
+#endif
+    return result;
+}
+
+static PyObject *
+cx509_reset_stats(PyObject *module)
+{
+#ifdef CX509_STATS
+    _stat_sum(stat_baseline);
+#endif
+    Py_RETURN_NONE;
+}
+
+
+/*
+ * SHA-1 and SHA-256 for fingerprint(). The block functions consume whole 64-byte blocks; the
+ * portable versions are used unless the CPU has the SHA extensions, in which case we use SHA-NI
+ * kernels (after the public-domain examples by Sean Gulley and Jeffrey Walton). Both algorithms pad
+ * the same way, so _sha_digest handles the tail for either.
+ */
+typedef void (*sha_blocks_f)(uint32_t *state, const unsigned char *data, size_t nblocks);
+
+static const uint32_t sha1_initial_state[5] = {
+    0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+};
+static const uint32_t sha256_initial_state[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define LOAD32_BE(p) (((uint32_t) (p)[0] << 24) | ((uint32_t) (p)[1] << 16) | ((uint32_t) (p)[2] << 8) | (uint32_t) (p)[3])
+
+static void
+_sha1_blocks_portable(uint32_t *state, const unsigned char *data, size_t nblocks)
+{
+    uint32_t w[80], a, b, c, d, e, f, k, t;
+    int i;
+
+    for (; nblocks; nblocks--, data += 64) {
+	for (i = 0; i < 16; i++)
+	    w[i] = LOAD32_BE(data + 4 * i);
+	for (; i < 80; i++)
+	    w[i] = ROL32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+	a = state[0]; b = state[1]; c = state[2]; d = state[3]; e = state[4];
+	for (i = 0; i < 80; i++) {
+	    if (i < 20) {
+		f = (b & c) | (~b & d);
+		k = 0x5a827999;
+	    }
+	    else if (i < 40) {
+		f = b ^ c ^ d;
+		k = 0x6ed9eba1;
+	    }
+	    else if (i < 60) {
+		f = (b & c) | (b & d) | (c & d);
+		k = 0x8f1bbcdc;
+	    }
+	    else {
+		f = b ^ c ^ d;
+		k = 0xca62c1d6;
+	    }
+	    t = ROL32(a, 5) + f + e + k + w[i];
+	    e = d; d = c; c = ROL32(b, 30); b = a; a = t;
+	}
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d; state[4] += e;
+    }
+}
+
+static void
+_sha256_blocks_portable(uint32_t *state, const unsigned char *data, size_t nblocks)
+{
+    uint32_t w[64], a, b, c, d, e, f, g, h, t1, t2;
+    int i;
+
+    for (; nblocks; nblocks--, data += 64) {
+	for (i = 0; i < 16; i++)
+	    w[i] = LOAD32_BE(data + 4 * i);
+	for (; i < 64; i++)
+	    w[i] = (ROR32(w[i - 2], 17) ^ ROR32(w[i - 2], 19) ^ (w[i - 2] >> 10)) + w[i - 7] +
+		   (ROR32(w[i - 15], 7) ^ ROR32(w[i - 15], 18) ^ (w[i - 15] >> 3)) + w[i - 16];
+
+	a = state[0]; b = state[1]; c = state[2]; d = state[3];
+	e = state[4]; f = state[5]; g = state[6]; h = state[7];
+	for (i = 0; i < 64; i++) {
+	    t1 = h + (ROR32(e, 6) ^ ROR32(e, 11) ^ ROR32(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+	    t2 = (ROR32(a, 2) ^ ROR32(a, 13) ^ ROR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+	    h = g; g = f; f = e; e = d + t1;
+	    d = c; c = b; b = a; a = t1 + t2;
+	}
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+	state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+}
+
+static sha_blocks_f sha1_blocks = _sha1_blocks_portable;
+static sha_blocks_f sha256_blocks = _sha256_blocks_portable;
+static const char *sha_kernel_name = "portable";
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#include <cpuid.h>
+#define HAVE_SHA_NI 1
+
+/*
+ * Four rounds per step. Message words are kept four to a register in msg[], which holds the last
+ * four groups; each new group is derived from those with the sha1msg1/sha1msg2 instructions.
+ */
+__attribute__((target("sha,sse4.1")))
+static void
+_sha1_blocks_shani(uint32_t *state, const unsigned char *data, size_t nblocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+    __m128i abcd, abcd_save, e, e_save, previous, msg[4];
+    int i;
+
+    abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) state), 0x1b);
+    e = _mm_set_epi32((int) state[4], 0, 0, 0);
+
+    for (; nblocks; nblocks--, data += 64) {
+	abcd_save = abcd;
+	e_save = e;
+	for (i = 0; i < 4; i++)
+	    msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + 16 * i)), mask);
+
+	e = _mm_add_epi32(e, msg[0]);
+	previous = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd, e, 0);
+	for (i = 1; i < 20; i++) {
+	    if (i >= 4)
+		msg[i & 3] = _mm_sha1msg2_epu32(_mm_xor_si128(_mm_sha1msg1_epu32(msg[i & 3], msg[(i - 3) & 3]),
+							      msg[(i - 2) & 3]), msg[(i - 1) & 3]);
+	    e = _mm_sha1nexte_epu32(previous, msg[i & 3]);
+	    previous = abcd;
+	    /* the round function selector must be an immediate */
+	    switch (i / 5) {
+		case 0: abcd = _mm_sha1rnds4_epu32(abcd, e, 0); break;
+		case 1: abcd = _mm_sha1rnds4_epu32(abcd, e, 1); break;
+		case 2: abcd = _mm_sha1rnds4_epu32(abcd, e, 2); break;
+		default: abcd = _mm_sha1rnds4_epu32(abcd, e, 3); break;
+	    }
+	}
+	e = _mm_sha1nexte_epu32(previous, e_save);
+	abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+    _mm_storeu_si128((__m128i *) state, _mm_shuffle_epi32(abcd, 0x1b));
+    state[4] = (uint32_t) _mm_extract_epi32(e, 3);
+}
+
+/* as above, with the state held as ABEF/CDGH as the sha256rnds2 instruction wants it */
+__attribute__((target("sha,sse4.1")))
+static void
+_sha256_blocks_shani(uint32_t *state, const unsigned char *data, size_t nblocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i state0, state1, abef_save, cdgh_save, tmp, k, msg[4];
+    int i;
+
+    tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[0]), 0xb1);	/* CDAB */
+    state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[4]), 0x1b);	/* EFGH */
+    state0 = _mm_alignr_epi8(tmp, state1, 8);						/* ABEF */
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0);					/* CDGH */
+
+    for (; nblocks; nblocks--, data += 64) {
+	abef_save = state0;
+	cdgh_save = state1;
+	for (i = 0; i < 4; i++)
+	    msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + 16 * i)), mask);
+
+	for (i = 0; i < 16; i++) {
+	    if (i >= 4) {
+		tmp = _mm_alignr_epi8(msg[(i - 1) & 3], msg[(i - 2) & 3], 4);
+		msg[i & 3] = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(msg[i & 3], msg[(i - 3) & 3]), tmp),
+						  msg[(i - 1) & 3]);
+	    }
+	    k = _mm_add_epi32(msg[i & 3], _mm_loadu_si128((const __m128i *) &sha256_k[4 * i]));
+	    state1 = _mm_sha256rnds2_epu32(state1, state0, k);
+	    state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(k, 0x0e));
+	}
+	state0 = _mm_add_epi32(state0, abef_save);
+	state1 = _mm_add_epi32(state1, cdgh_save);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1b);			/* FEBA */
+    state1 = _mm_shuffle_epi32(state1, 0xb1);			/* DCHG */
+    _mm_storeu_si128((__m128i *) &state[0], _mm_blend_epi16(tmp, state1, 0xf0));	/* DCBA */
+    _mm_storeu_si128((__m128i *) &state[4], _mm_alignr_epi8(state1, tmp, 8));	/* HGFE */
+}
+#endif
+
+static void
+_sha_init(void)
+{
+#ifdef HAVE_SHA_NI
+    unsigned int eax, ebx, ecx, edx;
+
+    /* SHA is CPUID.(EAX=7,ECX=0):EBX bit 29; the kernels also use SSE4.1 */
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSE4_1) &&
+	__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & (1u << 29))) {
+	sha1_blocks = _sha1_blocks_shani;
+	sha256_blocks = _sha256_blocks_shani;
+	sha_kernel_name = "sha-ni";
+    }
+#endif
+}
+
+/* hash len bytes of data with SHA-1 or SHA-256, writing DIGEST_SIZE(algorithm) bytes to out */
+static void
+_sha_digest(int algorithm, const unsigned char *data, size_t len, unsigned char *out)
+{
+    uint32_t state[8];
+    unsigned char tail[128];
+    uint64_t bits = (uint64_t) len * 8;
+    sha_blocks_f blocks;
+    size_t nblocks = len / 64, rest = len % 64, words, i;
+
+    if (algorithm == DIGEST_SHA1) {
+	memcpy(state, sha1_initial_state, sizeof(sha1_initial_state));
+	blocks = sha1_blocks;
+	words = 5;
+    }
+    else {
+	memcpy(state, sha256_initial_state, sizeof(sha256_initial_state));
+	blocks = sha256_blocks;
+	words = 8;
+    }
+    blocks(state, data, nblocks);
+
+    /* the last partial block, a 1 bit, zeros, and the length in bits; one block or two */
+    memset(tail, 0, sizeof(tail));
+    memcpy(tail, data + 64 * nblocks, rest);
+    tail[rest] = 0x80;
+    nblocks = rest < 56 ? 1 : 2;
+    for (i = 0; i < 8; i++)
+	tail[64 * nblocks - 1 - i] = (unsigned char) (bits >> (8 * i));
+    blocks(state, tail, nblocks);
+
+    for (i = 0; i < words; i++) {
+	out[4 * i] = (unsigned char) (state[i] >> 24);
+	out[4 * i + 1] = (unsigned char) (state[i] >> 16);
+	out[4 * i + 2] = (unsigned char) (state[i] >> 8);
+	out[4 * i + 3] = (unsigned char) state[i];
+    }
+}
+
+
+/*
+ * Native worker pool used by the batch APIs. Each worker owns a deque holding a contiguous range of
+ * item indices; it takes work from the front of its own range and, once that is empty, steals the
+ * back half of the largest remaining range. Work functions run without the GIL and must not touch
+ * Python objects.
+ */
+typedef void (*pool_work_f)(void *ctx, Py_ssize_t i);
+
+typedef struct {
+    PyThread_type_lock lock;	/* protects next and end */
+    Py_ssize_t next, end;	/* remaining range [next, end) */
+    PyThread_type_lock exited;	/* held until the worker thread finishes */
+    int started;
+} pool_deque;
+
+typedef struct {
+    pool_work_f work;
+    void *ctx;
+    int nworkers;
+    pool_deque *deques;
+} pool_t;
+
+typedef struct {
+    pool_t *pool;
+    int id;
+} pool_worker_arg;
+
+/* steal the back half of the largest other range into our own deque; returns 0 if nothing is left */
+static int
+_pool_steal(pool_t *pool, int id)
+{
+    pool_deque *mine = &pool->deques[id], *victim;
+    Py_ssize_t best, remaining, mid, end;
+    int i, v;
+
+    while (1) {
+	/* pick the victim with the most work left; it may have shrunk by the time we lock it, so recheck below */
+	best = 0;
+	v = -1;
+	for (i = 0; i < pool->nworkers; i++) {
+	    if (i == id)
+		continue;
+	    PyThread_acquire_lock(pool->deques[i].lock, WAIT_LOCK);
+	    remaining = pool->deques[i].end - pool->deques[i].next;
+	    PyThread_release_lock(pool->deques[i].lock);
+	    if (remaining > best) {
+		best = remaining;
+		v = i;
+	    }
+	}
+	if (v < 0)
+	    return 0;
+
+	victim = &pool->deques[v];
+	PyThread_acquire_lock(victim->lock, WAIT_LOCK);
+	remaining = victim->end - victim->next;
+	mid = victim->next + remaining / 2;
+	end = victim->end;
+	if (remaining > 0)
+	    victim->end = mid;
+	PyThread_release_lock(victim->lock);
+
+	if (remaining > 0) {
+	    PyThread_acquire_lock(mine->lock, WAIT_LOCK);
+	    mine->next = mid;
+	    mine->end = end;
+	    PyThread_release_lock(mine->lock);
+	    return 1;
+	}
+    }
+}
+
+static void
+_pool_run_worker(pool_t *pool, int id)
+{
+    pool_deque *mine = &pool->deques[id];
+    Py_ssize_t i;
+
+    while (1) {
+	PyThread_acquire_lock(mine->lock, WAIT_LOCK);
+	i = mine->next < mine->end ? mine->next++ : -1;
+	PyThread_release_lock(mine->lock);
+
+	if (i >= 0)
+	    pool->work(pool->ctx, i);
+	else if (!_pool_steal(pool, id))
+	    break;
+    }
+}
+
+static void
+_pool_thread(void *arg)
+{
+    pool_worker_arg *worker = (pool_worker_arg *) arg;
+
+    _pool_run_worker(worker->pool, worker->id);
+    _stat_thread_exit();
+    PyThread_release_lock(worker->pool->deques[worker->id].exited);
+}
+
+static int
+_cpu_count(void)
+{
+#if defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 0)
+	return (int) n;
+#endif
+    return 1;
+}
+
+/*
+ * Run work(ctx, i) for every i in [0, n) on up to nthreads threads (0 means one per CPU). The
+ * calling thread is one of the workers. Must be called with the GIL held; releases it while the
+ * pool runs. Returns -1 with MemoryError set if the pool could not be set up.
+ */
+static int
+_pool_map(pool_work_f work, void *ctx, Py_ssize_t n, int nthreads)
+{
+    pool_t pool;
+    pool_worker_arg *args;
+    Py_ssize_t chunk;
+    int i, result = 0;
+
+    if (nthreads <= 0)
+	nthreads = _cpu_count();
+    if (nthreads > n)
+	nthreads = n > 0 ? (int) n : 1;
+
+    pool.work = work;
+    pool.ctx = ctx;
+    pool.nworkers = nthreads;
+    pool.deques = PyMem_New(pool_deque, nthreads);
+    args = PyMem_New(pool_worker_arg, nthreads);
+    if (pool.deques)
+	memset(pool.deques, 0, nthreads * sizeof(pool_deque));
+
+    /* deal out the initial ranges evenly; stealing evens out whatever imbalance remains */
+    chunk = n / nthreads;
+    for (i = 0; pool.deques && args && i < nthreads; i++) {
+	pool.deques[i].next = i * chunk;
+	pool.deques[i].end = (i == nthreads - 1) ? n : (i + 1) * chunk;
+	pool.deques[i].lock = PyThread_allocate_lock();
+	pool.deques[i].exited = PyThread_allocate_lock();
+	if (!pool.deques[i].lock || !pool.deques[i].exited) {
+	    result = -1;
+	    break;
+	}
+	args[i].pool = &pool;
+	args[i].id = i;
+    }
+    if (!pool.deques || !args)
+	result = -1;
+
+    if (result == 0) {
+	Py_BEGIN_ALLOW_THREADS
+	/* a thread that fails to start just leaves its range to be stolen by the others */
+	for (i = 1; i < nthreads; i++) {
+	    PyThread_acquire_lock(pool.deques[i].exited, WAIT_LOCK);
+	    if (PyThread_start_new_thread(_pool_thread, &args[i]) != -1)
+		pool.deques[i].started = 1;
+	    else
+		PyThread_release_lock(pool.deques[i].exited);
+	}
+	_pool_run_worker(&pool, 0);
+	for (i = 1; i < nthreads; i++)
+	    if (pool.deques[i].started)
+		PyThread_acquire_lock(pool.deques[i].exited, WAIT_LOCK);
+	Py_END_ALLOW_THREADS
+    }
+    else
+	PyErr_NoMemory();
+
+    for (i = 0; pool.deques && i < nthreads; i++) {
+	if (pool.deques[i].lock)
+	    PyThread_free_lock(pool.deques[i].lock);
+	if (pool.deques[i].exited)
+	    PyThread_free_lock(pool.deques[i].exited);
+    }
+    PyMem_Free(pool.deques);
+    PyMem_Free(args);
+    return result;
+}
+
+/* one parse_many input and its result */
+typedef struct {
+    Py_buffer data;
+    PyObject *der;		/* for PEM input, the string we base64-decode into */
+    const char *body;		/* and the base64 text within data */
+    Py_ssize_t body_len;
+    Certificate_t *certificate;
+    cx509_arena arena;		/* certificate is decoded into this, then handed to its object */
+    cert_spans_t spans;
+    asn_dec_rval_t rval;
+    int exceeded;		/* the budget that stopped the decode, if any */
+} parse_job;
+
+typedef struct {
+    decoder_f decode;
+    int pem;
+    decode_limits limits;
+    parse_job *jobs;
+} parse_batch;
+
+static void
+_parse_many_work(void *ctx, Py_ssize_t i)
+{
+    parse_batch *batch = (parse_batch *) ctx;
+    parse_job *job = &batch->jobs[i];
+    decode_budget budget;
+    Py_ssize_t n;
+
+    budget.limits = batch->limits;
+    budget.exceeded = BUDGET_OK;
+    if (job->der) {
+	n = _base64_decode(job->body, job->body_len, (unsigned char *) PyString_AS_STRING(job->der));
+	if (n >= 0) {
+	    Py_SIZE(job->der) = n; /* shrunk in place; the terminator is restored once we have the GIL */
+	    job->certificate = _decode_limited(batch->decode, PyString_AS_STRING(job->der), (size_t) n, -1, &job->spans, &job->rval, &job->arena, NULL, &budget);
+	}
+    }
+    else if (!batch->pem)
+	job->certificate = _decode_limited(batch->decode, job->data.buf, (size_t) job->data.len, -1, &job->spans, &job->rval, &job->arena, NULL, &budget);
+    job->exceeded = budget.exceeded;
+}
+
+/*
+ * Get a read-only simple buffer on obj as PyArg_ParseTuple's s* does: through the new-style buffer
+ * interface, or failing that the old-style one (a Python 2 mmap has only that). Returns -1 with an
+ * exception set if obj has neither.
+ */
+static int
+_get_read_buffer(PyObject *obj, Py_buffer *view)
+{
+    const void *buf;
+    Py_ssize_t len;
+
+    if (PyObject_CheckBuffer(obj))
+	return PyObject_GetBuffer(obj, view, PyBUF_SIMPLE);
+    if (PyObject_AsReadBuffer(obj, &buf, &len) < 0)
+	return -1;
+    return PyBuffer_FillInfo(view, obj, (void *) buf, len, 1, PyBUF_SIMPLE);
+}
+
+/*
+ * Decode a batch of certificates on a native thread pool. Returns a list in input order holding a
+ * cx509 object for each item that decoded, or a ValueError instance for each item that did not
+ * (BudgetExceeded for those stopped by a limit).
+ */
+static PyObject *
+cx509_parse_many(PyObject *module, PyObject *args, PyObject *kw)
+{
+    static char *kwlist[] = { "data", "threads", "format", "zero_copy", "max_size", "max_depth", "max_elements", "max_ns", NULL };
+    PyObject *iterable, *seq, *L = NULL, *item;
+    int nthreads = 0, zero_copy = 0;
+    char *format = NULL;
+    parse_batch batch;
+    Py_ssize_t i, n, nbuffers = 0;
+
+    memset(&batch.limits, 0, sizeof(batch.limits));
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "O|isinnnL", kwlist, &iterable, &nthreads, &format, &zero_copy,
+				     &batch.limits.max_size, &batch.limits.max_depth, &batch.limits.max_elements, &batch.limits.max_ns))
+	return NULL;
+
+    if (_limits_check(&batch.limits) < 0 || !(batch.decode = _decoder_for_format(format, &batch.pem)))
+	return NULL;
+
+    if (!(seq = PySequence_Fast(iterable, "parse_many() argument must be iterable")))
+	return NULL;
+
+    n = PySequence_Fast_GET_SIZE(seq);
+    batch.jobs = PyMem_New(parse_job, n ? n : 1);
+    if (!batch.jobs) {
+	Py_DECREF(seq);
+	return PyErr_NoMemory();
+    }
+    memset(batch.jobs, 0, (n ? n : 1) * sizeof(parse_job));
+
+    /* the exports we take here keep every buffer pinned while the pool runs */
+    for (nbuffers = 0; nbuffers < n; nbuffers++) {
+	item = PySequence_Fast_GET_ITEM(seq, nbuffers);
+	if (PyUnicode_Check(item) || _get_read_buffer(item, &batch.jobs[nbuffers].data) < 0) {
+	    PyErr_Clear();
+	    PyErr_Format(PyExc_TypeError, "parse_many() item %zd does not support the buffer interface", nbuffers);
+	    goto done;
+	}
+    }
+
+    /* for PEM, find each item's certificate block and allocate the string it decodes into */
+    for (i = 0; batch.pem && i < n; i++) {
+	Py_ssize_t offset = 0, start;
+	if (_pem_find_certificate(batch.jobs[i].data.buf, batch.jobs[i].data.len, &offset, &start,
+				  &batch.jobs[i].body, &batch.jobs[i].body_len) &&
+	    !(batch.jobs[i].der = BASE64_DECODED_STRING(batch.jobs[i].body_len)))
+	    goto done;
+    }
+
+    if (_pool_map(_parse_many_work, &batch, n, nthreads) < 0)
+	goto done;
+
+    if (!(L = PyList_New(n)))
+	goto done;
+
+    for (i = 0; i < n; i++) {
+	if (batch.jobs[i].certificate && batch.jobs[i].der) {
+	    /* for PEM, the decoded string becomes the source */
+	    PyString_AS_STRING(batch.jobs[i].der)[Py_SIZE(batch.jobs[i].der)] = '\0';
+	    PyBuffer_Release(&batch.jobs[i].data);
+	    if (PyObject_GetBuffer(batch.jobs[i].der, &batch.jobs[i].data, PyBUF_SIMPLE) < 0)
+		goto fail;
+	}
+	if (batch.jobs[i].certificate) {
+	    /* the new object takes over the certificate and the export (or a copy of the bytes) */
+	    item = _cx509_from_decoded(batch.jobs[i].certificate, &batch.jobs[i].arena, &batch.jobs[i].spans, &batch.jobs[i].data,
+				       batch.jobs[i].rval.consumed, zero_copy);
+	    batch.jobs[i].certificate = NULL;
+	    if (!item)
+		goto fail;
+	    ((cx509 *) item)->limits = batch.limits;
+	}
+	else if (batch.jobs[i].exceeded) {
+	    item = PyObject_CallFunction(BudgetExceeded, "Nn", PyString_FromFormat("decode budget exceeded: %s",
+							      budget_names[batch.jobs[i].exceeded]), i);
+	    if (!item)
+		goto fail;
+	}
+	else {
+	    item = PyObject_CallFunction(PyExc_ValueError, "sn", "failed to decode certificate", i);
+	    if (!item)
+		goto fail;
+	}
+	PyList_SET_ITEM(L, i, item); /* steals reference */
+    }
+    goto done;
+
+  fail:
+    Py_CLEAR(L);
+  done:
+    /* free anything we decoded but did not hand out, and release the exports we still hold */
+    for (i = 0; i < n; i++) {
+	_free_certificate(batch.jobs[i].certificate, &batch.jobs[i].arena);
+	if (i < nbuffers)
+	    PyBuffer_Release(&batch.jobs[i].data); /* no-op once handed over */
+	Py_XDECREF(batch.jobs[i].der);
+    }
+    PyMem_Free(batch.jobs);
+    Py_DECREF(seq);
+    return L;
+}
+
+static int
+buffer_owner_getbuffer(buffer_owner *self, Py_buffer *view, int flags)
+{
+    return PyBuffer_FillInfo(view, (PyObject *) self, self->view.buf, self->view.len, 1, flags);
+}
+
+static void
+buffer_owner_dealloc(buffer_owner *self)
+{
+    PyBuffer_Release(&self->view);
+    PyObject_Del(self);
+}
+
+static PyBufferProcs buffer_owner_as_buffer = {
+    0,						/* bf_getreadbuffer */
+    0,						/* bf_getwritebuffer */
+    0,						/* bf_getsegcount */
+    0,						/* bf_getcharbuffer */
+    (getbufferproc) buffer_owner_getbuffer,	/* bf_getbuffer */
+    0,						/* bf_releasebuffer */
+};
+
+static PyTypeObject buffer_ownerType = {
+    PyObject_HEAD_INIT(NULL)
+    0,						/*ob_size*/
+    "cx509._buffer_owner",			/*tp_name*/
+    sizeof(buffer_owner),			/*tp_basicsize*/
+    0,                         			/*tp_itemsize*/
+    (destructor) buffer_owner_dealloc,		/*tp_dealloc*/
+    0,                         			/*tp_print*/
+    0,                         			/*tp_getattr*/
+    0,                         			/*tp_setattr*/
+    0,                         			/*tp_compare*/
+    0,                         			/*tp_repr*/
+    0,                         			/*tp_as_number*/
+    0,                         			/*tp_as_sequence*/
+    0,                         			/*tp_as_mapping*/
+    0,                         			/*tp_hash */
+    0, 	                       			/*tp_call*/
+    0,                         			/*tp_str*/
+    0,                         			/*tp_getattro*/
+    0,                         			/*tp_setattro*/
+    &buffer_owner_as_buffer,			/*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER, /*tp_flags*/
+    "read-only memory shared by cx509 objects",	/* tp_doc */
+};
+
+/*
+ * Base64 decoding for PEM input. The scalar decoder below handles everything, but hands runs of
+ * plain base64 text (no whitespace or padding) to a vector kernel when the CPU has one: 32 chars at
+ * a time with AVX2, or 16 with SSSE3. The kernels use Wojciech Mula's nibble-lookup validation and
+ * multiply-add packing, and return the number of input chars they consumed, stopping at the first
+ * block that contains anything else or that would overrun the output.
+ */
+static const char base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static signed char base64_table[256];	/* char -> 6-bit value, or -1 */
+static size_t (*base64_kernel)(const unsigned char *in, size_t len, unsigned char *out, size_t room);
+static const char *base64_kernel_name = "scalar";
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_BASE64_SIMD 1
+
+__attribute__((target("avx2")))
+static size_t
+_base64_kernel_avx2(const unsigned char *in, size_t len, unsigned char *out, size_t room)
+{
+    const __m256i lut_lo = _mm256_setr_epi8(
+	0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+	0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lut_hi = _mm256_setr_epi8(
+	0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(
+	0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+    const __m256i pack_shuffle = _mm256_setr_epi8(
+	2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+	2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i pack_permute = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1);
+    __m256i str, hi_nibbles, lo_nibbles, hi, lo, roll, merged;
+    size_t done = 0;
+
+    /* each block reads 32 chars and stores 32 bytes, of which the first 24 are output */
+    while (len - done >= 32 && room >= 32) {
+	str = _mm256_loadu_si256((const __m256i *) (in + done));
+	hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask_2f);
+	lo_nibbles = _mm256_and_si256(str, mask_2f);
+	hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+	lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+	if (!_mm256_testz_si256(lo, hi))
+	    break; /* not plain base64 */
+	roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(_mm256_cmpeq_epi8(str, mask_2f), hi_nibbles));
+	str = _mm256_add_epi8(str, roll);
+	merged = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+	merged = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+	merged = _mm256_shuffle_epi8(merged, pack_shuffle);
+	merged = _mm256_permutevar8x32_epi32(merged, pack_permute);
+	_mm256_storeu_si256((__m256i *) out, merged);
+	done += 32;
+	out += 24;
+	room -= 24;
+    }
+    return done;
+}
+
+__attribute__((target("ssse3")))
+static size_t
+_base64_kernel_ssse3(const unsigned char *in, size_t len, unsigned char *out, size_t room)
+{
+    const __m128i lut_lo = _mm_setr_epi8(
+	0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lut_hi = _mm_setr_epi8(
+	0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(
+	0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_2f = _mm_set1_epi8(0x2f);
+    const __m128i pack_shuffle = _mm_setr_epi8(
+	2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    __m128i str, hi_nibbles, lo_nibbles, hi, lo, roll, merged;
+    size_t done = 0;
+
+    /* each block reads 16 chars and stores 16 bytes, of which the first 12 are output */
+    while (len - done >= 16 && room >= 16) {
+	str = _mm_loadu_si128((const __m128i *) (in + done));
+	hi_nibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask_2f);
+	lo_nibbles = _mm_and_si128(str, mask_2f);
+	hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+	lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+	if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0xFFFF)
+	    break; /* not plain base64 */
+	roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(_mm_cmpeq_epi8(str, mask_2f), hi_nibbles));
+	str = _mm_add_epi8(str, roll);
+	merged = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+	merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+	merged = _mm_shuffle_epi8(merged, pack_shuffle);
+	_mm_storeu_si128((__m128i *) out, merged);
+	done += 16;
+	out += 12;
+	room -= 12;
+    }
+    return done;
+}
+#endif /* x86 SIMD */
+
+/* build the scalar table and pick the best kernel this CPU supports */
+static void
+_base64_init(void)
+{
+    int i;
+
+    memset(base64_table, -1, sizeof(base64_table));
+    for (i = 0; i < 64; i++)
+	base64_table[(unsigned char) base64_alphabet[i]] = (signed char) i;
+
+#ifdef HAVE_BASE64_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+	base64_kernel = _base64_kernel_avx2;
+	base64_kernel_name = "avx2";
+    }
+    else if (__builtin_cpu_supports("ssse3")) {
+	base64_kernel = _base64_kernel_ssse3;
+	base64_kernel_name = "ssse3";
+    }
+#endif
+}
+
+/*
+ * Decode base64 text, ignoring whitespace, into out, which must have room for 3 * (len / 4) + 3
+ * bytes. Returns the number of bytes written, or -1 if the text is not valid base64. Pure C, so
+ * callers may release the GIL around it.
+ */
+static Py_ssize_t
+_base64_decode(const char *in, Py_ssize_t len, unsigned char *out)
+{
+    const unsigned char *p = (const unsigned char *) in, *end = p + len, *retry = p;
+    unsigned char *o = out, *limit = out + 3 * (len / 4);
+    unsigned long bits = 0;
+    size_t done;
+    int n = 0, pad = 0;
+
+    while (p < end) {
+	if (base64_kernel && n == 0 && !pad && p >= retry) {
+	    done = base64_kernel(p, end - p, o, limit - o);
+	    p += done;
+	    o += done / 4 * 3;
+	    if (p >= end)
+		break;
+	    /* run the scalar loop through the character that stopped the kernel, then try again */
+	    for (retry = p; retry < end && base64_table[*retry] >= 0; retry++)
+		;
+	    retry++;
+	}
+
+	if (base64_table[*p] >= 0 && !pad) {
+	    bits = (bits << 6) | (unsigned long) base64_table[*p];
+	    if (++n == 4) {
+		*o++ = (unsigned char) (bits >> 16);
+		*o++ = (unsigned char) (bits >> 8);
+		*o++ = (unsigned char) bits;
+		bits = 0;
+		n = 0;
+	    }
+	}
+	else if (*p == '=' && n + pad >= 2 && n + pad < 4)
+	    pad++;
+	else if (!isspace(*p))
+	    return -1;
+	p++;
+    }
+
+    /* a final quantum of 2 or 3 characters yields 1 or 2 bytes */
+    if (n + pad != 0 && (n + pad != 4 || n < 2))
+	return -1;
+    if (n == 2)
+	*o++ = (unsigned char) (bits >> 4);
+    else if (n == 3) {
+	*o++ = (unsigned char) (bits >> 10);
+	*o++ = (unsigned char) (bits >> 2);
+    }
+    return o - out;
+}
+
+/* find needle in haystack[0..len); returns NULL if it isn't there */
+static const char *
+_find(const char *haystack, Py_ssize_t len, const char *needle)
+{
+    size_t n = strlen(needle);
+    const char *p = haystack, *end = haystack + len;
+
+    while ((Py_ssize_t) n <= end - p && (p = memchr(p, needle[0], (end - p) - n + 1))) {
+	if (!memcmp(p, needle, n))
+	    return p;
+	p++;
+    }
+    return NULL;
+}
+
+/*
+ * Find the next PEM certificate block in buf[*offset..size); blocks with other labels (keys, CRLs),
+ * and blocks whose END label doesn't match their BEGIN label, are skipped. On success, sets *start
+ * to where the block begins and *body and *body_len to its base64 text, advances *offset past the
+ * END line and returns 1. Returns 0 if there are no more certificates. Pure C.
+ */
+static int
+_pem_find_certificate(const char *buf, Py_ssize_t size, Py_ssize_t *offset, Py_ssize_t *start,
+		      const char **body, Py_ssize_t *body_len)
+{
+    static const char *certificate_labels[] = { "CERTIFICATE", "X509 CERTIFICATE", "TRUSTED CERTIFICATE", NULL };
+    const char *begin, *label, *label_end, *end, *after, *stop = buf + size;
+    Py_ssize_t label_len;
+    int i;
+
+    while ((begin = _find(buf + *offset, size - *offset, "-----BEGIN "))) {
+	label = begin + strlen("-----BEGIN ");
+	if (!(label_end = _find(label, stop - label, "-----")))
+	    break;
+	if (!(end = _find(label_end + 5, stop - label_end - 5, "-----END ")))
+	    break; /* truncated block */
+	after = _find(end + 9, stop - end - 9, "-----");
+	*offset = after ? (after - buf) + 5 : size;
+
+	label_len = label_end - label;
+	if (!after || after - (end + 9) != label_len || memcmp(end + 9, label, label_len))
+	    continue; /* END label doesn't match BEGIN */
+	for (i = 0; certificate_labels[i]; i++) {
+	    if ((Py_ssize_t) strlen(certificate_labels[i]) == label_len && !memcmp(label, certificate_labels[i], label_len)) {
+		*start = begin - buf;
+		*body = label_end + 5;
+		*body_len = end - *body;
+		return 1;
+	    }
+	}
+    }
+    *offset = size;
+    return 0;
+}
+
+/*
+ * Find the next PEM certificate in buf[*offset..size) and base64-decode its body into a new string.
+ * On return *offset is past the block and *start is where it began. Returns NULL with no exception
+ * set when there are no more certificates.
+ */
+static PyObject *
+_next_pem_certificate(const char *buf, Py_ssize_t size, Py_ssize_t *offset, Py_ssize_t *start)
+{
+    const char *body;
+    Py_ssize_t body_len, n;
+    PyObject *der;
+
+    if (!_pem_find_certificate(buf, size, offset, start, &body, &body_len))
+	return NULL;
+    if (!(der = BASE64_DECODED_STRING(body_len)))
+	return NULL;
+    n = _base64_decode(body, body_len, (unsigned char *) PyString_AS_STRING(der));
+    if (n < 0) {
+	Py_DECREF(der);
+	PyErr_Format(PyExc_ValueError, "invalid base64 in PEM block at offset %zd", *start);
+	return NULL;
+    }
+    if (_PyString_Resize(&der, n) < 0)
+	return NULL;
+    return der;
+}
+
+/* decode the first PEM certificate in data and return its DER encoding (for benchmarks) */
+static PyObject *
+cx509__pem_decode(PyObject *module, PyObject *args)
+{
+    Py_buffer data;
+    Py_ssize_t offset = 0, start;
+    PyObject *der;
+
+    if (!PyArg_ParseTuple(args, "s*", &data))
+	return NULL;
+    der = _next_pem_certificate(data.buf, data.len, &offset, &start);
+    PyBuffer_Release(&data);
+    if (!der && !PyErr_Occurred())
+	PyErr_Format(PyExc_ValueError, "no PEM certificate found");
+    return der;
+}
+
+/* lazily yields the certificates in a memory-mapped file; see cx509_iter_file */
+typedef struct {
+    PyObject_HEAD
+    PyObject *owner;		/* buffer_owner over the mapped file, or NULL if the file is empty */
+    Py_ssize_t offset;		/* where to look for the next certificate */
+    int pem;
+    int zero_copy;
+} file_iterator;
+
+static void
+file_iterator_dealloc(file_iterator *self)
+{
+    Py_XDECREF(self->owner);
+    PyObject_Del(self);
+}
+
+static PyObject *
+file_iterator_next(file_iterator *self)
+{
+    const char *buf;
+    Py_ssize_t size, start = self->offset;
+    Py_buffer item;
+    PyObject *der;
+    Certificate_t *certificate;
+    cx509_arena arena;
+    cert_spans_t spans;
+    asn_dec_rval_t rval;
+    tlv_t tlv;
+
+    if (!self->owner)
+	return NULL;
+    memset(&arena, 0, sizeof(arena));
+    buf = ((buffer_owner *) self->owner)->view.buf;
+    size = ((buffer_owner *) self->owner)->view.len;
+    if (self->offset >= size)
+	return NULL;
+
+    if (self->pem) {
+	/* PEM: the decoded string becomes the certificate's source; a block with bad base64 is yielded as an error, like one that won't decode */
+	if (!(der = _next_pem_certificate(buf, size, &self->offset, &start))) {
+	    if (!PyErr_ExceptionMatches(PyExc_ValueError))
+		return NULL;
+	    PyErr_Clear();
+	    return PyObject_CallFunction(PyExc_ValueError, "sn", "invalid base64 in PEM block", start);
+	}
+	if (PyObject_GetBuffer(der, &item, PyBUF_SIMPLE) < 0) {
+	    Py_DECREF(der);
+	    return NULL;
+	}
+	Py_DECREF(der); /* item holds a reference */
+    }
+    else {
+	/* DER: the outer TLV length tells us where the next certificate starts */
+	if (_tlv_at((const uint8_t *) buf, (size_t) size, (size_t) self->offset, &tlv) < 0) {
+	    self->offset = size;
+	    PyErr_Format(PyExc_ValueError, "malformed DER at offset %zd", start);
+	    return NULL;
+	}
+	self->offset += tlv.length;
+	if (PyObject_GetBuffer(self->owner, &item, PyBUF_SIMPLE) < 0)
+	    return NULL;
+	item.buf = (char *) item.buf + start;
+	item.len = tlv.length;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    certificate = _decode_certificate(ber_decode, item.buf, (size_t) item.len, &spans, &rval, &arena);
+    Py_END_ALLOW_THREADS
+
+    if (!certificate) {
+	PyBuffer_Release(&item);
+	return PyObject_CallFunction(PyExc_ValueError, "sn", "failed to decode certificate", start);
+    }
+    return _cx509_from_decoded(certificate, &arena, &spans, &item, rval.consumed, self->zero_copy);
+}
+
+static PyTypeObject file_iteratorType = {
+    PyObject_HEAD_INIT(NULL)
+    0,						/*ob_size*/
+    "cx509._file_iterator",			/*tp_name*/
+    sizeof(file_iterator),			/*tp_basicsize*/
+    0,                         			/*tp_itemsize*/
+    (destructor) file_iterator_dealloc,		/*tp_dealloc*/
+    0,                         			/*tp_print*/
+    0,                         			/*tp_getattr*/
+    0,                         			/*tp_setattr*/
+    0,                         			/*tp_compare*/
+    0,                         			/*tp_repr*/
+    0,                         			/*tp_as_number*/
+    0,                         			/*tp_as_sequence*/
+    0,                         			/*tp_as_mapping*/
+    0,                         			/*tp_hash */
+    0, 	                       			/*tp_call*/
+    0,                         			/*tp_str*/
+    0,                         			/*tp_getattro*/
+    0,                         			/*tp_setattro*/
+    0,                         			/*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,				/*tp_flags*/
+    "iterator over the certificates in a file",	/* tp_doc */
+    0,		               			/* tp_traverse */
+    0,		               			/* tp_clear */
+    0,		               			/* tp_richcompare */
+    0,		               			/* tp_weaklistoffset */
+    PyObject_SelfIter,				/* tp_iter */
+    (iternextfunc) file_iterator_next,		/* tp_iternext */
+};
+
+/*
+ * Memory-map a file of concatenated DER certificates, or of PEM blocks, and return an iterator that
+ * decodes them one at a time straight out of the mapping. Each item is a cx509 object, or a
+ * ValueError instance if the certificate (or PEM block) at that offset failed to decode; only
+ * malformed outer DER, after which we can't find the next certificate, ends the iteration with an
+ * exception.
+ */
+static PyObject *
+cx509_iter_file(PyObject *module, PyObject *args, PyObject *kw)
+{
+    static char *kwlist[] = { "path", "format", "zero_copy", NULL };
+    char *path, *format = NULL;
+    int zero_copy = 0, pem;
+    PyObject *file = NULL, *mmap_module = NULL, *mmap_type = NULL, *mmap_args = NULL, *mmap_kw = NULL;
+    PyObject *mapping = NULL, *size = NULL;
+    buffer_owner *owner = NULL;
+    file_iterator *it = NULL;
+    const void *buf;
+    Py_ssize_t len;
+    int fd;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "s|si", kwlist, &path, &format, &zero_copy))
+	return NULL;
+
+    if (format && (!strcmp(format, "pem") || !strcmp(format, "PEM")))
+	pem = 1;
+    else if (format && strcmp(format, "der") && strcmp(format, "DER") &&
+	     strcmp(format, "ber") && strcmp(format, "BER")) {
+	PyErr_Format(PyExc_ValueError, "unknown format");
+	return NULL;
+    }
+    else
+	pem = 0;
+
+    /* we let the mmap module do the (platform-specific) mapping */
+    if (!(file = PyFile_FromString(path, "rb")) ||
+	(fd = PyObject_AsFileDescriptor(file)) < 0 ||
+	!(size = PyObject_CallMethod(file, "seek", "ii", 0, 2)))
+	goto done;
+    Py_DECREF(size);
+    if (!(size = PyObject_CallMethod(file, "tell", NULL)))
+	goto done;
+
+    if (!(it = PyObject_New(file_iterator, &file_iteratorType)))
+	goto done;
+    it->owner = NULL;
+    it->offset = 0;
+    it->pem = pem;
+    it->zero_copy = zero_copy;
+
+    if (PyObject_IsTrue(size)) { /* mmap refuses to map an empty file */
+	/* mmap.mmap(fd, 0, access=mmap.ACCESS_READ) */
+	if (!(mmap_module = PyImport_ImportModule("mmap")) ||
+	    !(mmap_type = PyObject_GetAttrString(mmap_module, "mmap")) ||
+	    !(mmap_args = Py_BuildValue("(in)", fd, (Py_ssize_t) 0)) ||
+	    !(mmap_kw = Py_BuildValue("{sN}", "access", PyObject_GetAttrString(mmap_module, "ACCESS_READ"))) ||
+	    !(mapping = PyObject_Call(mmap_type, mmap_args, mmap_kw)) ||
+	    PyObject_AsReadBuffer(mapping, &buf, &len) < 0 ||
+	    !(owner = PyObject_New(buffer_owner, &buffer_ownerType))) {
+	    Py_CLEAR(it);
+	    goto done;
+	}
+	PyBuffer_FillInfo(&owner->view, mapping, (void *) buf, len, 1, PyBUF_SIMPLE);
+	it->owner = (PyObject *) owner;
+    }
+
+  done:
+    if (file) {
+	PyObject *closed = PyObject_CallMethod(file, "close", NULL);
+	Py_XDECREF(closed);
+	Py_DECREF(file);
+    }
+    Py_XDECREF(size);
+    Py_XDECREF(mmap_module);
+    Py_XDECREF(mmap_type);
+    Py_XDECREF(mmap_args);
+    Py_XDECREF(mmap_kw);
+    Py_XDECREF(mapping);
+    return (PyObject *) it;
+}
+
+/*
+ * In-memory certificate store for chain building. Each certificate gets an entry tuple holding its
+ * subject and issuer name keys (see get_subject_key) and its subjectKeyIdentifier and authorityKeyIdentifier
+ * keyIdentifier (None if absent), and the store keeps a dict per key mapping it to the list of
+ * entries that have it. Finding a certificate's issuers is then a dict lookup on its issuer name
+ * plus a key identifier check on the few candidates, rather than a scan of the store.
+ */
+enum { ENTRY_CERT, ENTRY_SUBJECT, ENTRY_ISSUER, ENTRY_SKI, ENTRY_AKI, ENTRY_SIZE };
+
+typedef struct {
+    PyObject_HEAD
+    PyObject *certs;		/* list of the certificates in the order they were added */
+    PyObject *entries;		/* dict: SHA-256 fingerprint when added -> entry */
+    PyObject *by_subject;	/* dict: subject name key -> list of entries */
+    PyObject *by_issuer;	/* dict: issuer name key -> list of entries */
+    PyObject *by_ski;		/* dict: subjectKeyIdentifier -> list of entries */
+    PyObject *by_aki;		/* dict: authorityKeyIdentifier keyIdentifier -> list of entries */
+} cert_store;
+
+static PyTypeObject cert_storeType;
+
+/* the subjectKeyIdentifier (or, if authority, the authorityKeyIdentifier keyIdentifier) of cert, or None */
+static PyObject *
+_key_identifier(cx509 *cert, int authority)
+{
+    struct Extension *ext = _find_extension(cert, authority ? "authorityKeyIdentifier" : "subjectKeyIdentifier");
+    AuthorityKeyIdentifier_t *aki = NULL;
+    SubjectKeyIdentifier_t *ski = NULL;
+    KeyIdentifier_t *id = NULL;
+    asn_dec_rval_t rval;
+    PyObject *result = NULL;
+    int exceeded = 0;
+
+    if (ext) {
+	BEGIN_SCRATCH(cert);
+	if (authority) {
+	    rval = _nested_decode(&cert->limits, STAT_EXTENSIONS_DECODE, &asn_DEF_AuthorityKeyIdentifier, (void **) &aki,
+				  (const void *) ext->extnValue.buf, (size_t) ext->extnValue.size, &exceeded);
+	    if (rval.code == RC_OK && aki)
+		id = aki->keyIdentifier;
+	}
+	else {
+	    rval = _nested_decode(&cert->limits, STAT_EXTENSIONS_DECODE, &asn_DEF_SubjectKeyIdentifier, (void **) &ski,
+				  (const void *) ext->extnValue.buf, (size_t) ext->extnValue.size, &exceeded);
+	    if (rval.code == RC_OK && ski)
+		id = ski;
+	}
+	if (id && id->buf)
+	    result = PyString_FromStringAndSize((const char *) id->buf, id->size);
+	if (aki)
+	    asn_DEF_AuthorityKeyIdentifier.free_struct(&asn_DEF_AuthorityKeyIdentifier, (void *) aki, 0);
+	if (ski)
+	    asn_DEF_SubjectKeyIdentifier.free_struct(&asn_DEF_SubjectKeyIdentifier, (void *) ski, 0);
+	END_SCRATCH(cert);
+	if (exceeded) {
+	    Py_CLEAR(result);
+	    _budget_error(exceeded);
+	    return NULL;
+	}
+	if (result || PyErr_Occurred())
+	    return result;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+/* build the entry tuple for cert */
+static PyObject *
+_store_make_entry(PyObject *cert)
+{
+    cx509 *c = (cx509 *) cert;
+    PyObject *entry, *item;
+    int i;
+
+    if (!PyObject_TypeCheck(cert, &cx509Type)) {
+	PyErr_Format(PyExc_TypeError, "expected a cx509 object");
+	return NULL;
+    }
+    if (!c->certificate) {
+	PyErr_Format(PyExc_ValueError, "empty certificate");
+	return NULL;
+    }
+    if (_need(c, PART(PART_SUBJECT) | PART(PART_ISSUER) | PART(PART_EXTENSIONS)) < 0)
+	return NULL;
+
+    if (!(entry = PyTuple_New(ENTRY_SIZE)))
+	return NULL;
+    Py_INCREF(cert);
+    PyTuple_SET_ITEM(entry, ENTRY_CERT, cert); /* steals reference */
+    for (i = ENTRY_SUBJECT; i < ENTRY_SIZE; i++) {
+	switch (i) {
+	case ENTRY_SUBJECT: item = cx509_get_subject_key(c); break;
+	case ENTRY_ISSUER: item = cx509_get_issuer_key(c); break;
+	case ENTRY_SKI: item = _key_identifier(c, 0); break;
+	default: item = _key_identifier(c, 1); break;
+	}
+	if (!item) {
+	    Py_DECREF(entry);
+	    return NULL;
+	}
+	PyTuple_SET_ITEM(entry, i, item); /* steals reference */
+    }
+    return entry;
+}
+
+/*
+ * The key of cert in the entries dict: its SHA-256 fingerprint. Entries are keyed by the string
+ * rather than the object, whose hash would change if it were reparsed while stored.
+ */
+static PyObject *
+_store_key(cx509 *cert)
+{
+    if (_fingerprint(cert, DIGEST_SHA256) < 0)
+	return NULL;
+    return PyString_FromStringAndSize((const char *) cert->sha256, DIGEST_SIZE(DIGEST_SHA256));
+}
+
+/* the entry for cert: the stored one if cert is in the store, otherwise a new one */
+static PyObject *
+_store_entry(cert_store *self, PyObject *cert)
+{
+    PyObject *entry, *key;
+
+    if (PyObject_TypeCheck(cert, &cx509Type) && ((cx509 *) cert)->certificate) {
+	if (!(key = _store_key((cx509 *) cert)))
+	    return NULL;
+	entry = PyDict_GetItem(self->entries, key); /* borrowed */
+	Py_DECREF(key);
+	if (entry) {
+	    Py_INCREF(entry);
+	    return entry;
+	}
+    }
+    return _store_make_entry(cert);
+}
+
+/* append entry to the list under key in index (None keys aren't indexed) */
+static int
+_store_index(PyObject *index, PyObject *key, PyObject *entry)
+{
+    PyObject *L;
+    int rc;
+
+    if (key == Py_None)
+	return 0;
+    if ((L = PyDict_GetItem(index, key))) /* borrowed */
+	return PyList_Append(L, entry);
+    if (!(L = PyList_New(1)))
+	return -1;
+    Py_INCREF(entry);
+    PyList_SET_ITEM(L, 0, entry); /* steals reference */
+    rc = PyDict_SetItem(index, key, L);
+    Py_DECREF(L);
+    return rc;
+}
+
+/* undo _store_index(index, key, entry), entry being the last one appended under key */
+static void
+_store_unindex(PyObject *index, PyObject *key, PyObject *entry)
+{
+    PyObject *L;
+    Py_ssize_t n;
+
+    if (key == Py_None || !(L = PyDict_GetItem(index, key))) /* borrowed */
+	return;
+    n = PyList_GET_SIZE(L);
+    if (!n || PyList_GET_ITEM(L, n - 1) != entry)
+	return;
+    if (n == 1)
+	PyDict_DelItem(index, key);
+    else
+	PyList_SetSlice(L, n - 1, n, NULL);
+}
+
+/*
+ * Add cert; returns 1 if added, 0 if an equal certificate was already there, -1 on error. On error
+ * the store is left as it was: cert is indexed first and added to entries last, and whatever was
+ * done is undone if a step fails.
+ */
+static int
+_store_add(cert_store *self, PyObject *cert)
+{
+    PyObject *indexes[ENTRY_SIZE] = { NULL, self->by_subject, self->by_issuer, self->by_ski, self->by_aki };
+    PyObject *entry, *key = NULL, *type, *value, *traceback;
+    int i = ENTRY_SUBJECT, rc = -1;
+
+    if (!(entry = _store_make_entry(cert)) || !(key = _store_key((cx509 *) cert)))
+	goto done;
+    if (PyDict_GetItem(self->entries, key)) {
+	rc = 0;
+	goto done;
+    }
+    for (; i < ENTRY_SIZE; i++)
+	if (_store_index(indexes[i], PyTuple_GET_ITEM(entry, i), entry) < 0)
+	    break;
+    if (i == ENTRY_SIZE && PyList_Append(self->certs, cert) == 0) {
+	if (PyDict_SetItem(self->entries, key, entry) == 0) {
+	    rc = 1;
+	    goto done;
+	}
+	PyList_SetSlice(self->certs, PyList_GET_SIZE(self->certs) - 1, PyList_GET_SIZE(self->certs), NULL);
+    }
+
+    PyErr_Fetch(&type, &value, &traceback);
+    while (--i >= ENTRY_SUBJECT)
+	_store_unindex(indexes[i], PyTuple_GET_ITEM(entry, i), entry);
+    PyErr_Restore(type, value, traceback);
+  done:
+    Py_XDECREF(entry);
+    Py_XDECREF(key);
+    return rc;
+}
+
+/*
+ * Append to result the certificates of the entries listed under key in index whose name_field
+ * equals name and whose id_field doesn't contradict id (both key identifiers present but different).
+ * If check_name is false, the name isn't compared; we use that to match by key identifier alone.
+ */
+static int
+_store_match(PyObject *result, PyObject *index, PyObject *key, int name_field, PyObject *name,
+	     int id_field, PyObject *id, int check_name)
+{
+    PyObject *L, *entry, *other;
+    Py_ssize_t i;
+    int equal;
+
+    if (key == Py_None || !(L = PyDict_GetItem(index, key))) /* borrowed */
+	return 0;
+    for (i = 0; i < PyList_GET_SIZE(L); i++) {
+	entry = PyList_GET_ITEM(L, i);
+	if (check_name) {
+	    if ((equal = PyObject_RichCompareBool(PyTuple_GET_ITEM(entry, name_field), name, Py_EQ)) < 0)
+		return -1;
+	    if (!equal)
+		continue;
+	}
+	other = PyTuple_GET_ITEM(entry, id_field);
+	if (id != Py_None && other != Py_None) {
+	    if ((equal = PyObject_RichCompareBool(other, id, Py_EQ)) < 0)
+		return -1;
+	    if (!equal)
+		continue;
+	}
+	if (PyList_Append(result, PyTuple_GET_ITEM(entry, ENTRY_CERT)) < 0)
+	    return -1;
+    }
+    return 0;
+}
+
+/*
+ * The stored certificates that could have issued cert: those whose subject is cert's issuer and
+ * whose subjectKeyIdentifier, if both are present, is cert's authorityKeyIdentifier. If no name
+ * matches, we fall back to the key identifier alone, which finds issuers whose names were encoded
+ * differently.
+ */
+static PyObject *
+_store_find_issuers(cert_store *self, PyObject *entry)
+{
+    PyObject *result = PyList_New(0);
+    PyObject *issuer = PyTuple_GET_ITEM(entry, ENTRY_ISSUER), *aki = PyTuple_GET_ITEM(entry, ENTRY_AKI);
+
+    if (!result)
+	return NULL;
+    if (_store_match(result, self->by_subject, issuer, ENTRY_SUBJECT, issuer, ENTRY_SKI, aki, 1) < 0 ||
+	(!PyList_GET_SIZE(result) &&
+	 _store_match(result, self->by_ski, aki, ENTRY_SUBJECT, issuer, ENTRY_SKI, aki, 0) < 0))
+	Py_CLEAR(result);
+    return result;
+}
+
+static PyObject *
+cert_store_find_issuers(cert_store *self, PyObject *cert)
+{
+    PyObject *entry, *result;
+
+    if (!(entry = _store_entry(self, cert)))
+	return NULL;
+    result = _store_find_issuers(self, entry);
+    Py_DECREF(entry);
+    return result;
+}
+
+/* the converse of find_issuers: the stored certificates cert could have issued */
+static PyObject *
+cert_store_find_issued(cert_store *self, PyObject *cert)
+{
+    PyObject *entry, *result;
+    PyObject *subject, *ski;
+
+    if (!(entry = _store_entry(self, cert)))
+	return NULL;
+    subject = PyTuple_GET_ITEM(entry, ENTRY_SUBJECT);
+    ski = PyTuple_GET_ITEM(entry, ENTRY_SKI);
+    if ((result = PyList_New(0)) &&
+	(_store_match(result, self->by_issuer, subject, ENTRY_ISSUER, subject, ENTRY_AKI, ski, 1) < 0 ||
+	 (!PyList_GET_SIZE(result) &&
+	  _store_match(result, self->by_aki, ski, ENTRY_ISSUER, subject, ENTRY_AKI, ski, 0) < 0)))
+	Py_CLEAR(result);
+    Py_DECREF(entry);
+    return result;
+}
+
+/*
+ * Follow issuers up from leaf, taking the first candidate at each hop that isn't already in the
+ * chain, until we reach a certificate with no (new) issuer in the store or max_depth certificates.
+ */
+static PyObject *
+cert_store_build_chain(cert_store *self, PyObject *args, PyObject *kw)
+{
+    static char *kwlist[] = { "leaf", "max_depth", NULL };
+    PyObject *leaf, *chain = NULL, *entry = NULL, *issuers = NULL, *next;
+    Py_ssize_t max_depth = 16, i;
+    int seen;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "O|n", kwlist, &leaf, &max_depth))
+	return NULL;
+
+    if (!(entry = _store_entry(self, leaf)) || !(chain = PyList_New(0)) || PyList_Append(chain, leaf) < 0)
+	goto fail;
+
+    while (PyList_GET_SIZE(chain) < max_depth) {
+	if (!(issuers = _store_find_issuers(self, entry)))
+	    goto fail;
+	next = NULL;
+	for (i = 0; i < PyList_GET_SIZE(issuers) && !next; i++) {
+	    if ((seen = PySequence_Contains(chain, PyList_GET_ITEM(issuers, i))) < 0)
+		goto fail;
+	    if (!seen)
+		next = PyList_GET_ITEM(issuers, i); /* borrowed */
+	}
+	if (!next)
+	    break;
+	if (PyList_Append(chain, next) < 0)
+	    goto fail;
+	Py_CLEAR(issuers);
+	Py_DECREF(entry);
+	if (!(entry = _store_entry(self, next)))
+	    goto fail;
+    }
+    Py_XDECREF(issuers);
+    Py_DECREF(entry);
+    return chain;
+
+  fail:
+    Py_XDECREF(issuers);
+    Py_XDECREF(entry);
+    Py_XDECREF(chain);
+    return NULL;
+}
+
+static PyObject *
+cert_store_add(cert_store *self, PyObject *cert)
+{
+    int rc = _store_add(self, cert);
+
+    if (rc < 0)
+	return NULL;
+    return PyBool_FromLong(rc);
+}
+
+static PyObject *
+cert_store_new(PyTypeObject *type, PyObject *args, PyObject *kw)
+{
+    cert_store *self = (cert_store *) type->tp_alloc(type, 0);
+
+    if (!self)
+	return NULL;
+    if (!(self->certs = PyList_New(0)) || !(self->entries = PyDict_New()) ||
+	!(self->by_subject = PyDict_New()) || !(self->by_issuer = PyDict_New()) ||
+	!(self->by_ski = PyDict_New()) || !(self->by_aki = PyDict_New())) {
+	Py_DECREF(self);
+	return NULL;
+    }
+    return (PyObject *) self;
+}
+
+static int
+cert_store_init(cert_store *self, PyObject *args, PyObject *kw)
+{
+    static char *kwlist[] = { "certs", NULL };
+    PyObject *certs = NULL, *it, *cert;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "|O", kwlist, &certs))
+	return -1;
+    if (!certs)
+	return 0;
+
+    if (!(it = PyObject_GetIter(certs)))
+	return -1;
+    while ((cert = PyIter_Next(it))) {
+	if (_store_add(self, cert) < 0) {
+	    Py_DECREF(cert);
+	    break;
+	}
+	Py_DECREF(cert);
+    }
+    Py_DECREF(it);
+    return PyErr_Occurred() ? -1 : 0;
+}
+
+static void
+cert_store_dealloc(cert_store *self)
+{
+    Py_XDECREF(self->certs);
+    Py_XDECREF(self->entries);
+    Py_XDECREF(self->by_subject);
+    Py_XDECREF(self->by_issuer);
+    Py_XDECREF(self->by_ski);
+    Py_XDECREF(self->by_aki);
+    Py_TYPE(self)->tp_free(self);
+}
+
+static Py_ssize_t
+cert_store_length(cert_store *self)
+{
+    return PyList_GET_SIZE(self->certs);
+}
+
+static int
+cert_store_contains(cert_store *self, PyObject *cert)
+{
+    PyObject *key;
+    int rc;
+
+    if (!PyObject_TypeCheck(cert, &cx509Type) || !((cx509 *) cert)->certificate)
+	return 0;
+    if (!(key = _store_key((cx509 *) cert)))
+	return -1;
+    rc = PyDict_Contains(self->entries, key);
+    Py_DECREF(key);
+    return rc;
+}
+
+static PyObject *
+cert_store_iter(cert_store *self)
+{
+    return PyObject_GetIter(self->certs);
+}
+
+static PySequenceMethods cert_store_as_sequence = {
+    (lenfunc) cert_store_length,		/* sq_length */
+    0,						/* sq_concat */
+    0,						/* sq_repeat */
+    0,						/* sq_item */
+    0,						/* sq_slice */
+    0,						/* sq_ass_item */
+    0,						/* sq_ass_slice */
+    (objobjproc) cert_store_contains,		/* sq_contains */
+};
+
+static PyMethodDef cert_store_methods[] = {
+    {"add", (PyCFunction) cert_store_add, METH_O, "Add a cx509 object; return False if an equal certificate was already in the store." },
+    {"find_issuers", (PyCFunction) cert_store_find_issuers, METH_O, "Return a list of the stored certificates whose subject and subjectKeyIdentifier match the given certificate's issuer and authorityKeyIdentifier." },
+    {"find_issued", (PyCFunction) cert_store_find_issued, METH_O, "Return a list of the stored certificates the given certificate could have issued." },
+    {"build_chain", (PyCFunction) cert_store_build_chain, METH_VARARGS|METH_KEYWORDS, "Return the list of certificates from leaf up to the last issuer found in the store, at most max_depth (default 16) long." },
+    {NULL}  /* Sentinel */
+};
+
+static PyTypeObject cert_storeType = {
+    PyObject_HEAD_INIT(NULL)
+    0,						/*ob_size*/
+    "cx509.CertStore",				/*tp_name*/
+    sizeof(cert_store),				/*tp_basicsize*/
+    0,                         			/*tp_itemsize*/
+    (destructor) cert_store_dealloc,		/*tp_dealloc*/
+    0,                         			/*tp_print*/
+    0,                         			/*tp_getattr*/
+    0,                         			/*tp_setattr*/
+    0,                         			/*tp_compare*/
+    0,                         			/*tp_repr*/
+    0,                         			/*tp_as_number*/
+    &cert_store_as_sequence,			/*tp_as_sequence*/
+    0,                         			/*tp_as_mapping*/
+    0,                         			/*tp_hash */
+    0, 	                       			/*tp_call*/
+    0,                         			/*tp_str*/
+    0,                         			/*tp_getattro*/
+    0,                         			/*tp_setattro*/
+    0,                         			/*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,	/*tp_flags*/
+    "indexed in-memory store of cx509 objects for finding issuers and building chains",	/* tp_doc */
+    0,		               			/* tp_traverse */
+    0,		               			/* tp_clear */
+    0,		               			/* tp_richcompare */
+    0,		               			/* tp_weaklistoffset */
+    (getiterfunc) cert_store_iter,		/* tp_iter */
+    0,		        			/* tp_iternext */
+    cert_store_methods,				/* tp_methods */
+    0,						/* tp_members */
+    0,                         			/* tp_getset */
+    0,                         			/* tp_base */
+    0,                         			/* tp_dict */
+    0,                         			/* tp_descr_get */
+    0,                         			/* tp_descr_set */
+    0,                         			/* tp_dictoffset */
+    (initproc) cert_store_init,			/* tp_init */
+    0,                        			/* tp_alloc */
+    cert_store_new,				/* tp_new */
+};
+
+/*
+ * Hostname index for picking certificates by SNI name. Certificates are filed under their dNSName
+ * subjectAltNames, or under their subject commonName if they have none (RFC 6125, section 6.4.4),
+ * in a trie keyed by label from the right: "www.example.com" names the node com -> example -> www.
+ * Each node keeps an open-addressing hash table of its children and lists of the certificates whose
+ * names end there. A wildcard name is kept on the node for the domain it covers, so "*.example.com"
+ * lives on com -> example. Matching walks the hostname's labels from the right, then takes the
+ * exact matches from the node for the whole name and the wildcard matches from its parent.
+ *
+ * Wildcards follow RFC 6125, section 6.4.3: only the leftmost label may contain one, it matches
+ * within that label only, and names like "*.com" with fewer than two labels after the wildcard
+ * label are ignored. A partial wildcard ("w*.example.com") doesn't match an A-label ("xn--...").
+ * Names are compared case-insensitively, and a single trailing dot is ignored.
+ */
+#define HOSTNAME_MAX 253
+#define HOSTNAME_MAX_LABELS 127
+
+typedef struct hostname_node hostname_node;
+struct hostname_node {
+    hostname_node **children;	/* hash table of child nodes, at most half full, or NULL */
+    size_t nchildren;
+    size_t capacity;		/* size of children: a power of two, or 0 */
+    PyObject *exact;		/* list of certificates named by this node, or NULL */
+    PyObject *wildcard;		/* list of certificates named "*." + this node, or NULL */
+    PyObject *partial;		/* list of (prefix, suffix, certificate) named prefix*suffix.node, or NULL */
+    uint32_t hash;
+    size_t len;
+    char label[1];		/* len lowercase bytes */
+};
+
+/* one label of a hostname, pointing into the normalized copy */
+typedef struct {
+    const char *p;
+    size_t len;
+    uint32_t hash;
+} label_t;
+
+typedef struct {
+    PyObject_HEAD
+    hostname_node *root;
+    Py_ssize_t count;		/* certificates added */
+} hostname_index;
+
+static PyTypeObject hostname_indexType;
+
+/*
+ * Copy name into buf (HOSTNAME_MAX + 1 bytes) in lowercase, without any trailing dot, and fill in
+ * labels, leftmost first. Returns the number of labels, or 0 if name isn't a plausible hostname.
+ */
+static int
+_split_hostname(const char *name, size_t len, char *buf, label_t *labels)
+{
+    size_t i, start = 0;
+    uint32_t hash = 2166136261u;
+    int n = 0;
+    char c;
+
+    if (len && name[len - 1] == '.')
+	len--;
+    if (!len || len > HOSTNAME_MAX)
+	return 0;
+    for (i = 0; i <= len; i++) {
+	if (i == len || name[i] == '.') {
+	    if (i == start || n == HOSTNAME_MAX_LABELS)
+		return 0; /* empty label, or too many */
+	    labels[n].p = buf + start;
+	    labels[n].len = i - start;
+	    labels[n].hash = hash;
+	    n++;
+	    start = i + 1;
+	    hash = 2166136261u;
+	    continue;
+	}
+	c = name[i];
+	if (c >= 'A' && c <= 'Z')
+	    c = c - 'A' + 'a';
+	else if (!c)
+	    return 0;
+	buf[i] = c;
+	hash ^= (uint8_t) c;
+	hash *= 16777619u;
+    }
+    return n;
+}
+
+static hostname_node *
+_node_new(const label_t *label)
+{
+    hostname_node *node = PyMem_Malloc(sizeof(hostname_node) + label->len);
+
+    if (!node) {
+	PyErr_NoMemory();
+	return NULL;
+    }
+    memset(node, 0, sizeof(hostname_node));
+    memcpy(node->label, label->p, label->len);
+    node->len = label->len;
+    node->hash = label->hash;
+    return node;
+}
+
+static void
+_node_free(hostname_node *node)
+{
+    size_t i;
+
+    if (!node)
+	return;
+    for (i = 0; i < node->capacity; i++)
+	_node_free(node->children[i]);
+    PyMem_Free(node->children);
+    Py_XDECREF(node->exact);
+    Py_XDECREF(node->wildcard);
+    Py_XDECREF(node->partial);
+    PyMem_Free(node);
+}
+
+/* the slot in node's table where a child for label is, or would go */
+static hostname_node **
+_node_slot(hostname_node *node, const label_t *label)
+{
+    size_t mask = node->capacity - 1, i;
+    hostname_node *child;
+
+    for (i = label->hash & mask; (child = node->children[i]); i = (i + 1) & mask)
+	if (child->hash == label->hash && child->len == label->len && !memcmp(child->label, label->p, label->len))
+	    break;
+    return &node->children[i];
+}
+
+static hostname_node *
+_node_child(hostname_node *node, const label_t *label)
+{
+    return node->capacity ? *_node_slot(node, label) : NULL;
+}
+
+/* the child of node for label, which is added if need be; NULL (with an exception set) if out of memory */
+static hostname_node *
+_node_add_child(hostname_node *node, const label_t *label)
+{
+    hostname_node **slot, **old = node->children;
+    size_t old_capacity = node->capacity, i;
+    label_t key;
+
+    if ((slot = node->capacity ? _node_slot(node, label) : NULL) && *slot)
+	return *slot;
+
+    if (2 * (node->nchildren + 1) > node->capacity) {
+	node->capacity = node->capacity ? 2 * node->capacity : 4;
+	if (!(node->children = PyMem_Malloc(node->capacity * sizeof(hostname_node *)))) {
+	    node->children = old;
+	    node->capacity = old_capacity;
+	    PyErr_NoMemory();
+	    return NULL;
+	}
+	memset(node->children, 0, node->capacity * sizeof(hostname_node *));
+	for (i = 0; i < old_capacity; i++)
+	    if (old[i]) {
+		key.p = old[i]->label;
+		key.len = old[i]->len;
+		key.hash = old[i]->hash;
+		*_node_slot(node, &key) = old[i];
+	    }
+	PyMem_Free(old);
+	slot = _node_slot(node, label);
+    }
+
+    if (!(*slot = _node_new(label)))
+	return NULL;
+    node->nchildren++;
+    return *slot;
+}
+
+/*
+ * Append item to *list, creating it if need be. A certificate's names are added one after another,
+ * so if two of them land on the same list (say "a.example.com" and "A.example.com"), the certificate
+ * is already the last item; we don't add it again, so lists never hold duplicates.
+ */
+static int
+_append_to(PyObject **list, PyObject *item)
+{
+    if (!*list && !(*list = PyList_New(0)))
+	return -1;
+    if (PyList_GET_SIZE(*list) && PyList_GET_ITEM(*list, PyList_GET_SIZE(*list) - 1) == item)
+	return 0;
+    return PyList_Append(*list, item);
+}
+
+/* append item to list unless it's already there (by identity) */
+static int
+_append_unique(PyObject *list, PyObject *item)
+{
+    Py_ssize_t i;
+
+    for (i = 0; i < PyList_GET_SIZE(list); i++)
+	if (PyList_GET_ITEM(list, i) == item)
+	    return 0;
+    return PyList_Append(list, item);
+}
+
+/* append the items of from (which has no duplicates) to list, skipping any already there */
+static int
+_extend_unique(PyObject *list, PyObject *from)
+{
+    Py_ssize_t i;
+
+    if (!PyList_GET_SIZE(list))
+	return PyList_SetSlice(list, 0, 0, from);
+    for (i = 0; i < PyList_GET_SIZE(from); i++)
+	if (_append_unique(list, PyList_GET_ITEM(from, i)) < 0)
+	    return -1;
+    return 0;
+}
+
+/* file cert under name; returns 1 if it was indexed, 0 if name isn't usable, -1 on error */
+static int
+_hostname_index_add_name(hostname_index *self, const char *name, size_t len, PyObject *cert)
+{
+    char buf[HOSTNAME_MAX + 1];
+    label_t labels[HOSTNAME_MAX_LABELS];
+    hostname_node *node = self->root;
+    const char *star, *end;
+    PyObject *item;
+    int n, i, rc;
+
+    if (!(n = _split_hostname(name, len, buf, labels)))
+	return 0;
+    for (i = 1; i < n; i++)
+	if (memchr(labels[i].p, '*', labels[i].len))
+	    return 0; /* wildcard other than in the leftmost label */
+    end = labels[0].p + labels[0].len;
+    if ((star = memchr(labels[0].p, '*', labels[0].len)) && (n < 3 || memchr(star + 1, '*', end - star - 1)))
+	return 0; /* wildcard over a public suffix, or more than one */
+
+    for (i = n - 1; i >= (star ? 1 : 0); i--)
+	if (!(node = _node_add_child(node, &labels[i])))
+	    return -1;
+
+    if (!star)
+	rc = _append_to(&node->exact, cert);
+    else if (labels[0].len == 1)
+	rc = _append_to(&node->wildcard, cert);
+    else {
+	if (!(item = Py_BuildValue("(s#s#O)", labels[0].p, (int) (star - labels[0].p), star + 1, (int) (end - star - 1), cert)))
+	    return -1;
+	rc = _append_to(&node->partial, item);
+	Py_DECREF(item);
+    }
+    return rc < 0 ? -1 : 1;
+}
+
+/* index cert under its dNSName subjectAltNames, or its subject commonName; returns the number of names indexed */
+static Py_ssize_t
+_hostname_index_add(hostname_index *self, PyObject *cert)
+{
+    cx509 *c = (cx509 *) cert;
+    struct Extension *ext;
+    GeneralNames_t *altName = NULL;
+    GeneralName_t *gn;
+    const uint8_t *cn;
+    size_t cn_len;
+    asn_dec_rval_t rval;
+    Py_ssize_t added = 0;
+    int dNSNames = 0, j, rc, exceeded = 0;
+
+    if (!PyObject_TypeCheck(cert, &cx509Type)) {
+	PyErr_Format(PyExc_TypeError, "expected a cx509 object");
+	return -1;
+    }
+    if (!c->certificate) {
+	PyErr_Format(PyExc_ValueError, "empty certificate");
+	return -1;
+    }
+    if (_need(c, PART(PART_SUBJECT) | PART(PART_EXTENSIONS)) < 0)
+	return -1;
+
+    if ((ext = _find_extension(c, "subjectAltName"))) {
+	BEGIN_SCRATCH(c);
+	rval = _nested_decode(&c->limits, STAT_EXTENSIONS_DECODE, &asn_DEF_GeneralNames, (void **) &altName,
+			      (const void *) ext->extnValue.buf, (size_t) ext->extnValue.size, &exceeded);
+	if (rval.code == RC_OK && altName) {
+	    for (j = 0; j < altName->list.count && added >= 0; j++) {
+		gn = altName->list.array[j];
+		if (gn && gn->present == GeneralName_PR_dNSName && gn->choice.dNSName.buf) {
+		    dNSNames++;
+		    rc = _hostname_index_add_name(self, (const char *) gn->choice.dNSName.buf, (size_t) gn->choice.dNSName.size, cert);
+		    added = rc < 0 ? -1 : added + rc;
 		}
 	    }
+	}
+	asn_DEF_GeneralNames.free_struct(&asn_DEF_GeneralNames, (void *) altName, 0);
+	END_SCRATCH(c);
+	if (exceeded) {
+	    _budget_error(exceeded);
+	    return -1;
+	}
+    }
+
+    if (!dNSNames && _last_common_name(&c->certificate->tbsCertificate.subject, &cn, &cn_len) == 0) {
+	rc = _hostname_index_add_name(self, (const char *) cn, cn_len, cert);
+	added = rc < 0 ? -1 : added + rc;
+    }
+
+    if (added >= 0)
+	self->count++;
+    return added;
+}
+
+/* append to result the certificates matching the hostname name, each once */
+static int
+_hostname_index_match(hostname_index *self, const char *name, size_t len, PyObject *result)
+{
+    char buf[HOSTNAME_MAX + 1];
+    label_t labels[HOSTNAME_MAX_LABELS];
+    hostname_node *node = self->root, *child;
+    PyObject *item, *prefix, *suffix;
+    Py_ssize_t i, plen, slen;
+    int n;
+
+    if (!(n = _split_hostname(name, len, buf, labels)) || memchr(name, '*', len))
+	return 0;
+    for (i = n - 1; i >= 1 && node; i--)
+	node = _node_child(node, &labels[i]);
+    if (!node)
+	return 0;
+
+    if ((child = _node_child(node, &labels[0])) && child->exact && _extend_unique(result, child->exact) < 0)
+	return -1;
+    if (node->wildcard && _extend_unique(result, node->wildcard) < 0)
+	return -1;
+    if (node->partial && !(labels[0].len >= 4 && !memcmp(labels[0].p, "xn--", 4)))
+	for (i = 0; i < PyList_GET_SIZE(node->partial); i++) {
+	    item = PyList_GET_ITEM(node->partial, i);
+	    prefix = PyTuple_GET_ITEM(item, 0);
+	    suffix = PyTuple_GET_ITEM(item, 1);
+	    plen = PyString_GET_SIZE(prefix);
+	    slen = PyString_GET_SIZE(suffix);
+	    if ((Py_ssize_t) labels[0].len >= plen + slen &&
+		!memcmp(labels[0].p, PyString_AS_STRING(prefix), plen) &&
+		!memcmp(labels[0].p + labels[0].len - slen, PyString_AS_STRING(suffix), slen) &&
+		_append_unique(result, PyTuple_GET_ITEM(item, 2)) < 0)
+		return -1;
+	}
+    return 0;
+}
+
+static PyObject *
+hostname_index_match(hostname_index *self, PyObject *args)
+{
+    const char *name;
+    int len;
+    PyObject *result;
+
+    if (!PyArg_ParseTuple(args, "s#", &name, &len))
+	return NULL;
+    if ((result = PyList_New(0)) && _hostname_index_match(self, name, (size_t) len, result) < 0)
+	Py_CLEAR(result);
+    return result;
+}
+
+static PyObject *
+hostname_index_match_many(hostname_index *self, PyObject *hostnames)
+{
+    PyObject *seq, *L, *result, *item;
+    Py_ssize_t n, i;
+
+    if (!(seq = PySequence_Fast(hostnames, "expected a sequence of hostnames")))
+	return NULL;
+    n = PySequence_Fast_GET_SIZE(seq);
+    if (!(L = PyList_New(n))) {
+	Py_DECREF(seq);
+	return NULL;
+    }
+    for (i = 0; i < n; i++) {
+	item = PySequence_Fast_GET_ITEM(seq, i);
+	if (!PyString_Check(item)) {
+	    PyErr_Format(PyExc_TypeError, "hostname %zd is not a string", i);
+	    goto fail;
+	}
+	if (!(result = PyList_New(0)))
+	    goto fail;
+	PyList_SET_ITEM(L, i, result); /* steals reference */
+	if (_hostname_index_match(self, PyString_AS_STRING(item), (size_t) PyString_GET_SIZE(item), result) < 0)
+	    goto fail;
+    }
+    Py_DECREF(seq);
+    return L;
+
+  fail:
+    Py_DECREF(seq);
+    Py_DECREF(L);
+    return NULL;
+}
+
+static PyObject *
+hostname_index_add(hostname_index *self, PyObject *cert)
+{
+    Py_ssize_t added = _hostname_index_add(self, cert);
+
+    if (added < 0)
+	return NULL;
+    return PyInt_FromSsize_t(added);
+}
+
+static PyObject *
+hostname_index_new(PyTypeObject *type, PyObject *args, PyObject *kw)
+{
+    hostname_index *self = (hostname_index *) type->tp_alloc(type, 0);
+    label_t root = { "", 0, 0 };
+
+    if (!self)
+	return NULL;
+    if (!(self->root = _node_new(&root))) {
+	Py_DECREF(self);
+	return NULL;
+    }
+    return (PyObject *) self;
+}
+
+static int
+hostname_index_init(hostname_index *self, PyObject *args, PyObject *kw)
+{
+    static char *kwlist[] = { "certs", NULL };
+    PyObject *certs = NULL, *it, *cert;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "|O", kwlist, &certs))
+	return -1;
+    if (!certs)
+	return 0;
+
+    if (!(it = PyObject_GetIter(certs)))
+	return -1;
+    while ((cert = PyIter_Next(it))) {
+	if (_hostname_index_add(self, cert) < 0) {
+	    Py_DECREF(cert);
+	    break;
+	}
+	Py_DECREF(cert);
+    }
+    Py_DECREF(it);
+    return PyErr_Occurred() ? -1 : 0;
+}
+
+static void
+hostname_index_dealloc(hostname_index *self)
+{
+    _node_free(self->root);
+    Py_TYPE(self)->tp_free(self);
+}
+
+static Py_ssize_t
+hostname_index_length(hostname_index *self)
+{
+    return self->count;
+}
+
+static PySequenceMethods hostname_index_as_sequence = {
+    (lenfunc) hostname_index_length,		/* sq_length */
+};
+
+static PyMethodDef hostname_index_methods[] = {
+    {"add", (PyCFunction) hostname_index_add, METH_O, "Index a cx509 object under its dNSName subjectAltNames (or its subject commonName if it has none); return the number of names indexed." },
+    {"match", (PyCFunction) hostname_index_match, METH_VARARGS, "Return a list of the indexed certificates valid for the given hostname, exact matches first." },
+    {"match_many", (PyCFunction) hostname_index_match_many, METH_O, "Return a list with the result of match() for each hostname in the given sequence." },
+    {NULL}  /* Sentinel */
+};
+
+static PyTypeObject hostname_indexType = {
+    PyObject_HEAD_INIT(NULL)
+    0,						/*ob_size*/
+    "cx509.HostnameIndex",			/*tp_name*/
+    sizeof(hostname_index),			/*tp_basicsize*/
+    0,                         			/*tp_itemsize*/
+    (destructor) hostname_index_dealloc,	/*tp_dealloc*/
+    0,                         			/*tp_print*/
+    0,                         			/*tp_getattr*/
+    0,                         			/*tp_setattr*/
+    0,                         			/*tp_compare*/
+    0,                         			/*tp_repr*/
+    0,                         			/*tp_as_number*/
+    &hostname_index_as_sequence,		/*tp_as_sequence*/
+    0,                         			/*tp_as_mapping*/
+    0,                         			/*tp_hash */
+    0, 	                       			/*tp_call*/
+    0,                         			/*tp_str*/
+    0,                         			/*tp_getattro*/
+    0,                         			/*tp_setattro*/
+    0,                         			/*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,	/*tp_flags*/
+    "index of cx509 objects by the hostnames they are valid for",	/* tp_doc */
+    0,		               			/* tp_traverse */
+    0,		               			/* tp_clear */
+    0,		               			/* tp_richcompare */
+    0,		               			/* tp_weaklistoffset */
+    0,		               			/* tp_iter */
+    0,		        			/* tp_iternext */
+    hostname_index_methods,			/* tp_methods */
+    0,						/* tp_members */
+    0,                         			/* tp_getset */
+    0,                         			/* tp_base */
+    0,                         			/* tp_dict */
+    0,                         			/* tp_descr_get */
+    0,                         			/* tp_descr_set */
+    0,                         			/* tp_dictoffset */
+    (initproc) hostname_index_init,		/* tp_init */
+    0,                        			/* tp_alloc */
+    hostname_index_new,				/* tp_new */
+};
+
+/*
+ * Columnar extraction. extract_columns() pulls a fixed set of fields out of many certificates (or
+ * encoded buffers, which are decoded and dropped without ever becoming cx509 objects) in one pass
+ * on the worker pool, into typed arrays exposed through the buffer protocol, so numpy and friends
+ * can wrap them without copying. Fixed-width fields are written straight into their columns by
+ * the workers; string fields are gathered per certificate and packed into an offsets column (n + 1
+ * int64 values) and a data column afterwards, as Arrow does.
+ */
+typedef struct {
+    PyObject_HEAD
+    char *data;
+    Py_ssize_t len;		/* number of items */
+    Py_ssize_t itemsize;
+    char format[2];		/* struct module format of one item */
+} column;
+
+static PyTypeObject columnType;
+
+static column *
+_column_new(char format, Py_ssize_t itemsize, Py_ssize_t len)
+{
+    column *self = PyObject_New(column, &columnType);
+
+    if (!self)
+	return NULL;
+    self->len = len;
+    self->itemsize = itemsize;
+    self->format[0] = format;
+    self->format[1] = '\0';
+    if (!(self->data = PyMem_Malloc(len * itemsize))) {
+	self->len = 0;
+	Py_DECREF(self);
+	return (column *) PyErr_NoMemory();
+    }
+    memset(self->data, 0, len * itemsize);
+    return self;
+}
+
+static void
+column_dealloc(column *self)
+{
+    PyMem_Free(self->data);
+    PyObject_Del(self);
+}
+
+static int
+column_getbuffer(column *self, Py_buffer *view, int flags)
+{
+    if (flags & PyBUF_WRITABLE) {
+	PyErr_Format(PyExc_BufferError, "columns are read-only");
+	return -1;
+    }
+    view->obj = (PyObject *) self;
+    Py_INCREF(self);
+    view->buf = self->data;
+    view->len = self->len * self->itemsize;
+    view->readonly = 1;
+    view->itemsize = self->itemsize;
+    view->format = (flags & PyBUF_FORMAT) ? self->format : NULL;
+    view->ndim = 1;
+    view->shape = (flags & PyBUF_ND) ? &self->len : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? &self->itemsize : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+/* the old buffer interface, which numpy.frombuffer uses on Python 2 */
+static Py_ssize_t
+column_getreadbuffer(column *self, Py_ssize_t segment, void **ptr)
+{
+    if (segment != 0) {
+	PyErr_Format(PyExc_SystemError, "accessing non-existent column segment");
+	return -1;
+    }
+    *ptr = self->data;
+    return self->len * self->itemsize;
+}
+
+static Py_ssize_t
+column_getsegcount(column *self, Py_ssize_t *lenp)
+{
+    if (lenp)
+	*lenp = self->len * self->itemsize;
+    return 1;
+}
+
+static Py_ssize_t
+column_length(column *self)
+{
+    return self->len;
+}
+
+static PyObject *
+column_repr(column *self)
+{
+    return PyString_FromFormat("<cx509 column of %zd '%s' items>", self->len, self->format);
+}
+
+static PyObject *
+column_get_format(column *self, void *closure)
+{
+    return PyString_FromString(self->format);
+}
+
+static PyObject *
+column_get_itemsize(column *self, void *closure)
+{
+    return PyInt_FromSsize_t(self->itemsize);
+}
+
+static PyGetSetDef column_getset[] = {
+    {"format", (getter) column_get_format, NULL, "struct module format of the items", NULL},
+    {"itemsize", (getter) column_get_itemsize, NULL, "size of an item in bytes", NULL},
+    {NULL}  /* Sentinel */
+};
+
+static PySequenceMethods column_as_sequence = {
+    (lenfunc) column_length,			/* sq_length */
+};
+
+static PyBufferProcs column_as_buffer = {
+    (readbufferproc) column_getreadbuffer,	/* bf_getreadbuffer */
+    0,						/* bf_getwritebuffer */
+    (segcountproc) column_getsegcount,		/* bf_getsegcount */
+    0,						/* bf_getcharbuffer */
+    (getbufferproc) column_getbuffer,		/* bf_getbuffer */
+    0,						/* bf_releasebuffer */
+};
+
+static PyTypeObject columnType = {
+    PyObject_HEAD_INIT(NULL)
+    0,						/*ob_size*/
+    "cx509._column",				/*tp_name*/
+    sizeof(column),				/*tp_basicsize*/
+    0,                         			/*tp_itemsize*/
+    (destructor) column_dealloc,		/*tp_dealloc*/
+    0,                         			/*tp_print*/
+    0,                         			/*tp_getattr*/
+    0,                         			/*tp_setattr*/
+    0,                         			/*tp_compare*/
+    (reprfunc) column_repr,			/*tp_repr*/
+    0,                         			/*tp_as_number*/
+    &column_as_sequence,			/*tp_as_sequence*/
+    0,                         			/*tp_as_mapping*/
+    0,                         			/*tp_hash */
+    0, 	                       			/*tp_call*/
+    0,                         			/*tp_str*/
+    0,                         			/*tp_getattro*/
+    0,                         			/*tp_setattro*/
+    &column_as_buffer,				/*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER, /*tp_flags*/
+    "read-only typed array returned by extract_columns",	/* tp_doc */
+    0,		               			/* tp_traverse */
+    0,		               			/* tp_clear */
+    0,		               			/* tp_richcompare */
+    0,		               			/* tp_weaklistoffset */
+    0,		               			/* tp_iter */
+    0,		        			/* tp_iternext */
+    0,						/* tp_methods */
+    0,						/* tp_members */
+    column_getset,				/* tp_getset */
+};
+
+/* the fields extract_columns knows; string fields become (offsets, data) column pairs */
+enum {
+    COLUMN_DECODED, COLUMN_VERSION, COLUMN_NOT_BEFORE, COLUMN_NOT_AFTER, COLUMN_KEYLEN,
+    COLUMN_KEY_ALGORITHM, COLUMN_SIGNATURE_ALGORITHM, COLUMN_SERIAL_NUMBER, COLUMN_SUBJECT_CN,
+    COLUMN_ISSUER_CN, COLUMN_FINGERPRINT, COLUMN_COUNT
+};
+
+static const struct {
+    const char *name;
+    char format;
+    Py_ssize_t itemsize;
+    int string;
+    int parts;			/* the PART bits a projected cx509 object needs decoded for the field */
+} column_fields[COLUMN_COUNT] = {
+    { "decoded", 'B', 1, 0, 0 },		/* 1 if the item decoded, else 0 (and the row holds missing values) */
+    { "version", 'i', 4, 0, PART(PART_VERSION) },	/* as get_version(); -1 if missing */
+    { "not_before", 'q', 8, 0, PART(PART_VALIDITY) },	/* seconds since the epoch; INT64_MIN if missing */
+    { "not_after", 'q', 8, 0, PART(PART_VALIDITY) },
+    { "keylen", 'i', 4, 0, PART(PART_PUBLIC_KEY) },	/* as get_public_key()["keylen"]; -1 if missing */
+    { "key_algorithm", 'H', 2, 0, PART(PART_PUBLIC_KEY) },	/* index into algorithm_names; 0 if unknown */
+    { "signature_algorithm", 'H', 2, 0, PART(PART_SIGNATURE_ALGORITHM) },
+    { "serial_number", 'B', 1, 1, PART(PART_SERIAL_NUMBER) },	/* INTEGER content octets */
+    { "subject_cn", 'B', 1, 1, PART(PART_SUBJECT) },	/* last commonName contents, as for HostnameIndex */
+    { "issuer_cn", 'B', 1, 1, PART(PART_ISSUER) },
+    { "fingerprint", 'B', 1, 1, 0 },		/* SHA-256 of the original encoding; empty for XER input */
+};
+
+typedef struct {
+    Py_buffer data;		/* the encoding to decode, unless cert is set */
+    cx509 *cert;		/* borrowed from the input sequence */
+    char *strings;		/* the row's string fields, one after another (malloc'd; written without the GIL) */
+    size_t lengths[COLUMN_COUNT];
+} column_job;
+
+typedef struct {
+    column_job *jobs;
+    int wanted[COLUMN_COUNT];
+    char *out[COLUMN_COUNT];	/* data of the fixed-width columns */
+} column_batch;
+
+static PyObject *algorithm_names = NULL; /* tuple: algorithm id -> name, or None */
+
+/* the id extract_columns reports for an algorithm OID: its slot in oid_table, plus 1 */
+static uint16_t
+_algorithm_id(const OBJECT_IDENTIFIER_t *algorithm)
+{
+    const oid_entry_t *oid = _oid_lookup(algorithm);
+
+    return oid ? (uint16_t) (oid - oid_table + 1) : 0;
+}
+
+/* fill in row i of batch from certificate (NULL if it didn't decode) */
+static void
+_extract_row(column_batch *batch, Py_ssize_t i, Certificate_t *certificate, const uint8_t *encoding, size_t encoding_len)
+{
+    column_job *job = &batch->jobs[i];
+    const uint8_t *strings[COLUMN_COUNT];
+    unsigned char digest[32];
+    TBSCertificate_t *tbs;
+    size_t total = 0;
+    long version = 0;
+    int64_t epoch;
+    char *to;
+    int k;
+
+#define SET(k, type, value) do { if (batch->wanted[k]) ((type *) batch->out[k])[i] = (value); } while (0)
+
+    if (!certificate) {
+	SET(COLUMN_VERSION, int32_t, -1);
+	SET(COLUMN_NOT_BEFORE, int64_t, EPOCH_MISSING);
+	SET(COLUMN_NOT_AFTER, int64_t, EPOCH_MISSING);
+	SET(COLUMN_KEYLEN, int32_t, -1);
+	return;
+    }
+    tbs = &certificate->tbsCertificate;
+
+    SET(COLUMN_DECODED, uint8_t, 1);
+    if (tbs->version && asn_INTEGER2long(tbs->version, &version) != 0)
+	version = -1;
+    SET(COLUMN_VERSION, int32_t, (int32_t) version);
+    SET(COLUMN_NOT_BEFORE, int64_t, _time_to_epoch(&tbs->validity.notBefore, &epoch) == 0 ? epoch : EPOCH_MISSING);
+    SET(COLUMN_NOT_AFTER, int64_t, _time_to_epoch(&tbs->validity.notAfter, &epoch) == 0 ? epoch : EPOCH_MISSING);
+    SET(COLUMN_KEYLEN, int32_t, (int32_t) (8 * tbs->subjectPublicKeyInfo.subjectPublicKey.size - tbs->subjectPublicKeyInfo.subjectPublicKey.bits_unused));
+    SET(COLUMN_KEY_ALGORITHM, uint16_t, _algorithm_id(&tbs->subjectPublicKeyInfo.algorithm.algorithm));
+    SET(COLUMN_SIGNATURE_ALGORITHM, uint16_t, _algorithm_id(&certificate->signatureAlgorithm.algorithm));
+
+#undef SET
+
+    /* string fields: find them all, then copy them into one block */
+    memset(strings, 0, sizeof(strings));
+    if (batch->wanted[COLUMN_SERIAL_NUMBER]) {
+	strings[COLUMN_SERIAL_NUMBER] = tbs->serialNumber.buf;
+	job->lengths[COLUMN_SERIAL_NUMBER] = (size_t) tbs->serialNumber.size;
+    }
+    if (batch->wanted[COLUMN_SUBJECT_CN])
+	_last_common_name(&tbs->subject, &strings[COLUMN_SUBJECT_CN], &job->lengths[COLUMN_SUBJECT_CN]);
+    if (batch->wanted[COLUMN_ISSUER_CN])
+	_last_common_name(&tbs->issuer, &strings[COLUMN_ISSUER_CN], &job->lengths[COLUMN_ISSUER_CN]);
+    if (batch->wanted[COLUMN_FINGERPRINT] && encoding) {
+	_sha_digest(DIGEST_SHA256, encoding, encoding_len, digest);
+	strings[COLUMN_FINGERPRINT] = digest;
+	job->lengths[COLUMN_FINGERPRINT] = sizeof(digest);
+    }
+
+    for (k = 0; k < COLUMN_COUNT; k++)
+	if (!strings[k])
+	    job->lengths[k] = 0;
+	else
+	    total += job->lengths[k];
+    if (!total || !(to = job->strings = malloc(total))) {
+	memset(job->lengths, 0, sizeof(job->lengths)); /* out of memory: the strings are left empty */
+	return;
+    }
+    for (k = 0; k < COLUMN_COUNT; k++)
+	if (job->lengths[k]) {
+	    memcpy(to, strings[k], job->lengths[k]);
+	    to += job->lengths[k];
+	}
+}
+
+static void
+_extract_columns_work(void *ctx, Py_ssize_t i)
+{
+    column_batch *batch = (column_batch *) ctx;
+    column_job *job = &batch->jobs[i];
+    Certificate_t *certificate;
+    cert_spans_t spans;
+    cx509_arena arena;
+    asn_dec_rval_t rval;
+
+    if (job->cert) {
+	spans = job->cert->spans;
+	_extract_row(batch, i, job->cert->certificate,
+		     spans.certificate.length ? (const uint8_t *) job->cert->source.buf + spans.certificate.offset : NULL,
+		     (size_t) spans.certificate.length);
+	return;
+    }
+
+    memset(&arena, 0, sizeof(arena));
+    memset(&spans, 0, sizeof(spans));
+    certificate = _decode_certificate(ber_decode, job->data.buf, (size_t) job->data.len, &spans, &rval, &arena);
+    _extract_row(batch, i, certificate,
+		 spans.certificate.length ? (const uint8_t *) job->data.buf + spans.certificate.offset : NULL,
+		 (size_t) spans.certificate.length);
+    _free_certificate(certificate, &arena);
+}
+
+/* the algorithm_names tuple, built on first use */
+static PyObject *
+_algorithm_names(void)
+{
+    PyObject *names, *name;
+    size_t i;
+
+    if (algorithm_names)
+	return algorithm_names;
+    if (!(names = PyTuple_New(oid_table_mask + 2)))
+	return NULL;
+    Py_INCREF(Py_None);
+    PyTuple_SET_ITEM(names, 0, Py_None); /* steals reference */
+    for (i = 0; i <= oid_table_mask; i++) {
+	name = oid_table[i].len && oid_table[i].py_key ? oid_table[i].py_key : Py_None;
+	Py_INCREF(name);
+	PyTuple_SET_ITEM(names, i + 1, name); /* steals reference */
+    }
+    return algorithm_names = names;
+}
+
+/*
+ * Extract fields from a sequence of cx509 objects and/or BER/DER buffers into columns. Returns a
+ * dict mapping each field name to a column, or to an (offsets, data) pair of columns for string
+ * fields, plus "decoded" (which rows decoded), and "algorithm_names" (a tuple mapping the values of
+ * the algorithm columns to names) if an algorithm field was asked for.
+ */
+static PyObject *
+cx509_extract_columns(PyObject *module, PyObject *args, PyObject *kw)
+{
+    static char *kwlist[] = { "certs", "fields", "threads", NULL };
+    PyObject *iterable, *fields = Py_None, *seq = NULL, *fseq = NULL, *item, *result = NULL, *value;
+    column *columns[COLUMN_COUNT], *offsets;
+    column_batch batch;
+    Py_ssize_t i, n = 0, nready = 0, total;
+    int nthreads = 0, k, needed = 0;
+    char *to;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "O|Oi", kwlist, &iterable, &fields, &nthreads))
+	return NULL;
+
+    memset(&batch, 0, sizeof(batch));
+    memset(columns, 0, sizeof(columns));
+    batch.wanted[COLUMN_DECODED] = 1;
+    if (fields == Py_None)
+	for (k = 0; k < COLUMN_COUNT; k++)
+	    batch.wanted[k] = 1;
+    else {
+	if (!(fseq = PySequence_Fast(fields, "fields must be a sequence of field names")))
+	    return NULL;
+	for (i = 0; i < PySequence_Fast_GET_SIZE(fseq); i++) {
+	    item = PySequence_Fast_GET_ITEM(fseq, i);
+	    for (k = 0; k < COLUMN_COUNT; k++)
+		if (PyString_Check(item) && !strcmp(PyString_AS_STRING(item), column_fields[k].name))
+		    break;
+	    if (k == COLUMN_COUNT) {
+		PyErr_Format(PyExc_ValueError, "unknown field %s", PyString_Check(item) ? PyString_AS_STRING(item) : "(not a string)");
+		goto done;
+	    }
+	    batch.wanted[k] = 1;
+	}
+    }
+
+    if (!(seq = PySequence_Fast(iterable, "extract_columns() argument must be iterable")))
+	goto done;
+    n = PySequence_Fast_GET_SIZE(seq);
+    if (!(batch.jobs = PyMem_New(column_job, n ? n : 1))) {
+	PyErr_NoMemory();
+	goto done;
+    }
+    memset(batch.jobs, 0, (n ? n : 1) * sizeof(column_job));
+
+    for (k = 0; k < COLUMN_COUNT; k++)
+	if (batch.wanted[k])
+	    needed |= column_fields[k].parts;
+    for (k = 0; k < COLUMN_COUNT; k++)
+	if (batch.wanted[k] && !column_fields[k].string) {
+	    if (!(columns[k] = _column_new(column_fields[k].format, column_fields[k].itemsize, n)))
+		goto done;
+	    batch.out[k] = columns[k]->data;
+	}
+
+    /*
+     * cx509 objects are read in place (marked busy so they can't be reparsed, after decoding any parts
+     * a projected parse skipped); anything else must be a buffer
+     */
+    for (nready = 0; nready < n; nready++) {
+	item = PySequence_Fast_GET_ITEM(seq, nready);
+	if (PyObject_TypeCheck(item, &cx509Type)) {
+	    if (((cx509 *) item)->certificate && _need((cx509 *) item, needed) < 0)
+		goto done;
+	    batch.jobs[nready].cert = (cx509 *) item;
+	    batch.jobs[nready].cert->busy++;
+	}
+	else if (PyUnicode_Check(item) || PyObject_GetBuffer(item, &batch.jobs[nready].data, PyBUF_SIMPLE) < 0) {
+	    PyErr_Clear();
+	    PyErr_Format(PyExc_TypeError, "extract_columns() item %zd is neither a cx509 object nor a buffer", nready);
+	    goto done;
+	}
+    }
 
-	    PyList_Append(L, dict); /* does not steal reference */
-	    Py_DECREF(dict);
+    if (_pool_map(_extract_columns_work, &batch, n, nthreads) < 0 || !(result = PyDict_New()))
+	goto done;
 
-	    if (oid)
-		PyMem_Free(oid);
+    for (k = 0; k < COLUMN_COUNT; k++) {
+	if (!batch.wanted[k])
+	    continue;
+	if (column_fields[k].string) {
+	    /* pack the rows' strings into offsets and data */
+	    if (!(offsets = _column_new('q', 8, n + 1)))
+		goto fail;
+	    for (i = 0, total = 0; i < n; i++) {
+		((int64_t *) offsets->data)[i] = (int64_t) total;
+		total += (Py_ssize_t) batch.jobs[i].lengths[k];
+	    }
+	    ((int64_t *) offsets->data)[n] = (int64_t) total;
+	    if (!(columns[k] = _column_new('B', 1, total))) {
+		Py_DECREF(offsets);
+		goto fail;
+	    }
+	    for (i = 0, to = columns[k]->data; i < n; i++) {
+		const char *from = batch.jobs[i].strings;
+		int j;
+		for (j = 0; j < k; j++)
+		    from += batch.jobs[i].lengths[j];
+		memcpy(to, from, batch.jobs[i].lengths[k]);
+		to += batch.jobs[i].lengths[k];
+	    }
+	    value = Py_BuildValue("(NO)", offsets, columns[k]);
+	}
+	else {
+	    value = (PyObject *) columns[k];
+	    Py_INCREF(value);
+	}
+	if (!value || PyDict_SetItemString(result, column_fields[k].name, value) < 0) {
+	    Py_XDECREF(value);
+	    goto fail;
 	}
+	Py_DECREF(value);
     }
 
-    return L;
+    if ((batch.wanted[COLUMN_KEY_ALGORITHM] || batch.wanted[COLUMN_SIGNATURE_ALGORITHM]) &&
+	(!_algorithm_names() || PyDict_SetItemString(result, "algorithm_names", algorithm_names) < 0))
+	goto fail;
+    goto done;
+
+  fail:
+    Py_CLEAR(result);
+  done:
+    for (i = 0; i < nready; i++) {
+	if (batch.jobs[i].cert)
+	    batch.jobs[i].cert->busy--;
+	else
+	    PyBuffer_Release(&batch.jobs[i].data);
+    }
+    for (i = 0; batch.jobs && i < n; i++)
+	free(batch.jobs[i].strings);
+    for (k = 0; k < COLUMN_COUNT; k++)
+	Py_XDECREF(columns[k]);
+    PyMem_Free(batch.jobs);
+    Py_XDECREF(seq);
+    Py_XDECREF(fseq);
+    return result;
 }
 
-static PyObject *
-cx509_get_public_key(cx509 *self)
-{
-    PyObject *dict, *tmp;
-    char *algorithm_oid = NULL;
-    const char *algorithm_name = NULL;
-    SubjectPublicKeyInfo_t *spki;
-    RSAPublicKey_t *rsapk = NULL;
-    asn_dec_rval_t rval;
-    char *modulus;
-    char *publicExponent;
+/*
+ * Expiry scans. expiring() only needs notAfter, which it finds in encoded buffers by walking the
+ * outer TLVs (_scan_validity) on the worker pool rather than decoding them; cx509 objects use (and
+ * fill in) their cached epochs. The input is consumed in blocks of EXPIRY_BLOCK items, so a long
+ * stream (iter_file(), say) never has more than that many buffers held at once.
+ */
+#define EXPIRY_BLOCK 16384
 
-    if (!self->certificate) {
-	PyErr_Format(PyExc_ValueError, "empty certificate");
-	return NULL;
-    }
+typedef struct {
+    Py_buffer data;		/* the encoding to scan, if scan is set */
+    int scan;
+    int64_t not_after;
+} expiry_job;
 
-    dict = PyDict_New();
-    spki = &self->certificate->tbsCertificate.subjectPublicKeyInfo;
+static void
+_expiring_work(void *ctx, Py_ssize_t i)
+{
+    expiry_job *job = &((expiry_job *) ctx)[i];
+    int64_t epochs[2];
 
-    algorithm_oid = _oid_to_string(&spki->algorithm.algorithm);
-    /* TBD: make sure spki->algorithm.parameters is empty, otherwise fail */
-    tmp = PyString_FromString((void *) algorithm_oid);
-    PyDict_SetItemString(dict, "algorithm_oid", tmp);
-    Py_DECREF(tmp);
+    if (!job->scan)
+	return;
+    if (_scan_validity((const uint8_t *) job->data.buf, (size_t) job->data.len, epochs) < 0)
+	epochs[1] = EPOCH_MISSING;
+    job->not_after = epochs[1];
+}
 
-    algorithm_name = find_oid(algorithm_oid, /*shortname:*/ 0);
-    tmp = PyString_FromString((void *) (algorithm_name ? algorithm_name : algorithm_oid));
-    PyDict_SetItemString(dict, "algorithm", tmp);
-    Py_DECREF(tmp);
+/*
+ * Return the (ascending) indices of the items in an iterable of cx509 objects and/or DER buffers
+ * whose notAfter time is before `before` and, if `after` is given, not before `after`, both in
+ * seconds since the epoch. Items without a usable notAfter are never included.
+ */
+static PyObject *
+cx509_expiring(PyObject *module, PyObject *args, PyObject *kw)
+{
+    static char *kwlist[] = { "certs", "before", "after", "threads", NULL };
+    PyObject *iterable, *iterator = NULL, *after_obj = Py_None, *item, *index, *result = NULL;
+    PY_LONG_LONG before, after = (PY_LONG_LONG) EPOCH_MISSING;
+    expiry_job *jobs = NULL;
+    Py_ssize_t i, n, nscan, base = 0;
+    int nthreads = 0, ok = 1;
+    cx509 *cert;
 
-    tmp = PyString_FromStringAndSize((void *) spki->subjectPublicKey.buf, spki->subjectPublicKey.size);
-    PyDict_SetItemString(dict, "key", tmp);
-    Py_DECREF(tmp);
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "OL|Oi", kwlist, &iterable, &before, &after_obj, &nthreads))
+	return NULL;
+    if (after_obj != Py_None && (after = PyLong_AsLongLong(after_obj)) == -1 && PyErr_Occurred())
+	return NULL;
 
-    tmp = PyInt_FromLong(8 * spki->subjectPublicKey.size - spki->subjectPublicKey.bits_unused);
-    PyDict_SetItemString(dict, "keylen", tmp);
-    Py_DECREF(tmp);
+    if (!(iterator = PyObject_GetIter(iterable)) || !(result = PyList_New(0)))
+	goto fail;
+    if (!(jobs = PyMem_New(expiry_job, EXPIRY_BLOCK))) {
+	PyErr_NoMemory();
+	goto fail;
+    }
 
-    /* if we know about this algorithm, decode the key */
-    if (!strcmp(algorithm_oid, "{ 1.2.840.113549.1.1.1 }")) { /* rsaEncryption */
-	rval = ber_decode(0, &asn_DEF_RSAPublicKey, 
-			  (void **) &rsapk,
-			  (const void *) spki->subjectPublicKey.buf, 
-			  (size_t) spki->subjectPublicKey.size);
-	if (rval.code == RC_OK) {
-	    /* the modulus is usually huge, so we need to convert it to hex, then have Python parse it into a long (bignum) */
-	    modulus = _integer_to_hex_string(&rsapk->modulus);
-	    if (modulus) {
-		tmp = PyLong_FromString(modulus, NULL, 16);
-		PyDict_SetItemString(dict, "modulus", tmp);
-		PyMem_Free(modulus);
-		Py_DECREF(tmp);
+    while (ok) {
+	/* take the next block: cx509 objects are resolved now, buffers are kept for the pool */
+	for (n = nscan = 0; n < EXPIRY_BLOCK && (item = PyIter_Next(iterator)); n++) {
+	    jobs[n].scan = 0;
+	    jobs[n].not_after = EPOCH_MISSING;
+	    if (PyObject_TypeCheck(item, &cx509Type)) {
+		cert = (cx509 *) item;
+		if (cert->certificate && _need(cert, PART(PART_VALIDITY)) < 0) {
+		    Py_DECREF(item);
+		    ok = 0;
+		    break;
+		}
+		if (cert->certificate) {
+		    _validity_epochs(cert);
+		    jobs[n].not_after = cert->epochs[1];
+		}
+	    }
+	    else if (!PyUnicode_Check(item) && PyObject_GetBuffer(item, &jobs[n].data, PyBUF_SIMPLE) == 0) {
+		jobs[n].scan = 1;
+		nscan++;
 	    }
+	    else {
+		PyErr_Clear();
+		PyErr_Format(PyExc_TypeError, "expiring() item %zd is neither a cx509 object nor a buffer", base + n);
+		Py_DECREF(item);
+		ok = 0;
+		break;
+	    }
+	    Py_DECREF(item);
+	}
+	if (ok && PyErr_Occurred())
+	    ok = 0;
+	if (ok && nscan && _pool_map(_expiring_work, jobs, n, nthreads) < 0)
+	    ok = 0;
 
-	    /* the public exponent is usually small (e.g., 3 or 65537), but we make no assumptions here */
-	    publicExponent = _integer_to_hex_string(&rsapk->publicExponent);
-	    if (publicExponent) {
-		tmp = PyLong_FromString(publicExponent, NULL, 16);
-		PyDict_SetItemString(dict, "public_exponent", tmp);
-		PyMem_Free(publicExponent);
-		Py_DECREF(tmp);
+	for (i = 0; i < n; i++) {
+	    if (jobs[i].scan)
+		PyBuffer_Release(&jobs[i].data);
+	    if (!ok || jobs[i].not_after == EPOCH_MISSING || jobs[i].not_after >= before || jobs[i].not_after < after)
+		continue;
+	    if (!(index = PyInt_FromSsize_t(base + i)) || PyList_Append(result, index) < 0) {
+		Py_XDECREF(index);
+		ok = 0;
+		continue;
 	    }
+	    Py_DECREF(index);
 	}
-	asn_DEF_RSAPublicKey.free_struct(&asn_DEF_RSAPublicKey, rsapk, 0);
+	base += n;
+	if (n < EXPIRY_BLOCK)
+	    break;
     }
+    if (ok)
+	goto done;
 
-    if (algorithm_oid)
-	PyMem_Free(algorithm_oid);
-    
-    return dict;
+  fail:
+    Py_CLEAR(result);
+  done:
+    PyMem_Free(jobs);
+    Py_XDECREF(iterator);
+    return result;
 }
 
-static PyObject *
-cx509_parse_digest_info(cx509 *self, PyObject *args, PyObject *kw)
-{
-    static char *kwlist[] = { "data", NULL };
-    PyObject *dict, *tmp;
-    const char *data = NULL;
-    Py_ssize_t len = 0;
-    DigestInfo_t *di = NULL;
-    asn_dec_rval_t rval;
-    char *dotted;
-    const char *algorithm_name;
+/*
+ * Content-addressed cache of decoded certificates. ParseCache.parse() hashes its input and, if the
+ * same bytes were parsed before, returns a new cx509 object sharing the tree decoded then rather
+ * than decoding them again. Each tree lives in a cache entry, a refcounted holder with its own
+ * arena and a copy (or, for a string, a reference) of the input; the objects sharing it hold
+ * references to it, so an evicted entry lives on until the last of them goes. Shared trees are
+ * never modified: projected parses aren't cached, and getters make their temporary decodes in each
+ * object's own arena.
+ *
+ * Entries are kept in a dict keyed by hash and on a list in least recently used order. When there
+ * are more than max_entries of them, or they take more than max_bytes (counting the input and the
+ * arena blocks of each), the least recently used are evicted. The GIL serializes lookups and
+ * updates; the decode on a miss runs without it.
+ */
+typedef struct cache_entry cache_entry;
+struct cache_entry {
+    PyObject_HEAD
+    Certificate_t *certificate;
+    cx509_arena arena;		/* holds certificate, unless it was decoded with the arena disabled */
+    Py_buffer source;		/* the input certificate was decoded from */
+    cert_spans_t spans;		/* component locations within source */
+    uint64_t hash;		/* XXH64 of source, our key in the cache */
+    size_t size;		/* bytes counted against max_bytes */
+    cache_entry *newer;		/* neighbours on the cache's LRU list */
+    cache_entry *older;
+};
 
-    if (!PyArg_ParseTupleAndKeywords(args, kw, "s#", kwlist, &data, &len))
-	return NULL;
+typedef struct {
+    PyObject_HEAD
+    PyObject *entries;		/* dict: XXH64 hash of the input -> cache_entry */
+    cache_entry *newest;	/* LRU list; the dict holds the references */
+    cache_entry *oldest;
+    Py_ssize_t max_entries;
+    Py_ssize_t max_bytes;	/* 0 for no limit */
+    Py_ssize_t bytes;		/* total size of the entries */
+    Py_ssize_t hits;
+    Py_ssize_t misses;
+    Py_ssize_t evictions;
+} parse_cache;
 
-    rval = ber_decode(0, &asn_DEF_DigestInfo, (void **) &di, (const void *) data, (size_t) len);
-    if (rval.code == RC_OK) {
-	dict = PyDict_New();
-	dotted = _oid_to_string(&di->digestAlgorithm.algorithm);
-	if (dotted) {
-	    tmp = PyString_FromString((void *) dotted);
-	    PyDict_SetItemString(dict, "algorithm_oid", tmp);
-	    Py_DECREF(tmp);
+static PyTypeObject cache_entryType;
+static PyTypeObject parse_cacheType;
 
-	    algorithm_name = find_oid(dotted, /*shortname:*/ 0);
-	    tmp = PyString_FromString((void *) (algorithm_name ? algorithm_name : dotted));
-	    PyDict_SetItemString(dict, "algorithm", tmp);
-	    Py_DECREF(tmp);
+/* XXH64 (seed 0), by Yann Collet; see https://github.com/Cyan4973/xxHash */
+#define XXH_PRIME1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME3 0x165667B19E3779F9ULL
+#define XXH_PRIME4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME5 0x27D4EB2F165667C5ULL
+#define ROL64(x, n) (((x) << (n)) | ((x) >> (64 - (n))))
 
-	    PyMem_Free(dotted);
-	}
-	if (di->digest.buf && di->digest.size) {
-	    tmp = PyString_FromStringAndSize((void *) di->digest.buf, (size_t) di->digest.size);
-	    PyDict_SetItemString(dict, "digest", tmp);
-	    Py_DECREF(tmp);
-	}
-    }
-    else {
-	PyErr_Format(PyExc_ValueError, "failed to parse DigestInfo");
-	dict = NULL;
-    }
-    asn_DEF_DigestInfo.free_struct(&asn_DEF_DigestInfo, di, 0);
-    return dict;
+static uint64_t
+_xxh_read64(const uint8_t *p)
+{
+    return (uint64_t) p[0] | (uint64_t) p[1] << 8 | (uint64_t) p[2] << 16 | (uint64_t) p[3] << 24 |
+	(uint64_t) p[4] << 32 | (uint64_t) p[5] << 40 | (uint64_t) p[6] << 48 | (uint64_t) p[7] << 56;
 }
 
-static PyObject *
-cx509_get_signature_algorithm(cx509 *self, PyObject *args, PyObject *kw)
+static uint64_t
+_xxh_round(uint64_t acc, uint64_t input)
 {
-    static char *kwlist[] = { "as_oid", NULL };
-    PyObject *as_oid = NULL;
-    char *dotted = NULL;
-    const char *algorithm_name;
-    PyObject *retval;
+    acc += input * XXH_PRIME2;
+    return ROL64(acc, 31) * XXH_PRIME1;
+}
 
-    if (!PyArg_ParseTupleAndKeywords(args, kw, "O", kwlist, &as_oid))
-	return NULL;
+static uint64_t
+_xxh_merge(uint64_t h, uint64_t v)
+{
+    h ^= _xxh_round(0, v);
+    return h * XXH_PRIME1 + XXH_PRIME4;
+}
 
-    if (!self->certificate) {
-	PyErr_Format(PyExc_ValueError, "empty certificate");
-	return NULL;
+static uint64_t
+_hash64(const uint8_t *p, size_t len)
+{
+    const uint8_t *end = p + len;
+    uint64_t h, v1, v2, v3, v4;
+
+    if (len >= 32) {
+	v1 = XXH_PRIME1 + XXH_PRIME2;
+	v2 = XXH_PRIME2;
+	v3 = 0;
+	v4 = 0 - XXH_PRIME1;
+	do {
+	    v1 = _xxh_round(v1, _xxh_read64(p));
+	    v2 = _xxh_round(v2, _xxh_read64(p + 8));
+	    v3 = _xxh_round(v3, _xxh_read64(p + 16));
+	    v4 = _xxh_round(v4, _xxh_read64(p + 24));
+	    p += 32;
+	} while (end - p >= 32);
+	h = ROL64(v1, 1) + ROL64(v2, 7) + ROL64(v3, 12) + ROL64(v4, 18);
+	h = _xxh_merge(h, v1);
+	h = _xxh_merge(h, v2);
+	h = _xxh_merge(h, v3);
+	h = _xxh_merge(h, v4);
     }
+    else
+	h = XXH_PRIME5;
+    h += len;
 
-    dotted = _oid_to_string(&self->certificate->signatureAlgorithm.algorithm);
-    if (as_oid == Py_True) {
-       retval = PyString_FromString(dotted);
+    for (; end - p >= 8; p += 8) {
+	h ^= _xxh_round(0, _xxh_read64(p));
+	h = ROL64(h, 27) * XXH_PRIME1 + XXH_PRIME4;
     }
-    else {
-	algorithm_name = find_oid(dotted, /*shortname:*/ 0);
-	retval = PyString_FromString(algorithm_name ? algorithm_name : dotted);
+    if (end - p >= 4) {
+	h ^= ((uint64_t) p[0] | (uint64_t) p[1] << 8 | (uint64_t) p[2] << 16 | (uint64_t) p[3] << 24) * XXH_PRIME1;
+	h = ROL64(h, 23) * XXH_PRIME2 + XXH_PRIME3;
+	p += 4;
     }
-    if (dotted)
-	PyMem_Free(dotted);
-    return retval;
+    for (; p < end; p++) {
+	h ^= *p * XXH_PRIME5;
+	h = ROL64(h, 11) * XXH_PRIME1;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_PRIME2;
+    h ^= h >> 29;
+    h *= XXH_PRIME3;
+    h ^= h >> 32;
+    return h;
 }
 
-static PyObject *
-cx509_get_signature_value(cx509 *self)
+/*
+ * Make a cache entry for a freshly decoded certificate. Keeps a string input as-is and copies any
+ * other buffer. Consumes arena and frees certificate if we fail; doesn't consume data.
+ */
+static cache_entry *
+_cache_entry_new(Certificate_t *certificate, cx509_arena *arena, const cert_spans_t *spans, Py_buffer *data)
 {
-    const unsigned char *signature;
-    size_t len;
+    cache_entry *entry;
+    PyObject *copy = NULL;
+    arena_block *block;
+    int result;
 
-    if (!self->certificate) {
-	PyErr_Format(PyExc_ValueError, "empty certificate");
+    if (!(entry = PyObject_New(cache_entry, &cache_entryType))) {
+	_free_certificate(certificate, arena);
 	return NULL;
     }
-
-    signature = self->certificate->signature.buf;
-    if (!signature)
+    entry->certificate = certificate;
+    entry->arena = *arena;
+    memset(arena, 0, sizeof(*arena));
+    entry->spans = *spans;
+    entry->newer = entry->older = NULL;
+    entry->source.obj = NULL;
+    if (!PyString_Check(data->obj) && !(copy = PyString_FromStringAndSize(data->buf, data->len))) {
+	Py_DECREF(entry);
 	return NULL;
-
-    len = self->certificate->signature.size;
-    if (!len)
+    }
+    result = PyObject_GetBuffer(copy ? copy : data->obj, &entry->source, PyBUF_SIMPLE);
+    Py_XDECREF(copy); /* the export holds its own reference */
+    if (result < 0) {
+	Py_DECREF(entry);
 	return NULL;
+    }
 
-    return PyString_FromStringAndSize((void *) signature, len);
+    entry->size = (size_t) data->len;
+    if (!entry->arena.head)
+	entry->size += (size_t) data->len * ARENA_BYTES_PER_INPUT_BYTE; /* decoded with malloc; a guess */
+    for (block = entry->arena.head; block; block = block->next)
+	entry->size += ARENA_ROUND(sizeof(arena_block)) + block->size;
+    return entry;
 }
 
-/*
- * This is pretty hacky. We can't easily get the raw bytes corresponding to the TBSCertificate from
- * the parser, so we just encode as DER again from scratch. It seems like this might be brittle, but
- * so far I haven't seen any problems. --dmb
- */
+static void
+cache_entry_dealloc(cache_entry *self)
+{
+    _free_certificate(self->certificate, &self->arena);
+    PyBuffer_Release(&self->source);
+    PyObject_Del(self);
+}
+
+/* a new cx509 object sharing entry's tree */
 static PyObject *
-cx509_get_tbs_certificate_data(cx509 *self)
+_cache_share(cache_entry *entry)
 {
-    asn_enc_rval_t er;  /* Encoder return value */
-    size_t count = 0;
-    void *allocated, *output;
-    PyObject *s;
+    cx509 *obj = (cx509 *) cx509Type.tp_alloc(&cx509Type, 0);
 
-    if (!self->certificate) {
-	PyErr_Format(PyExc_ValueError, "empty certificate");
+    if (!obj)
+	return NULL;
+    if (PyObject_GetBuffer(entry->source.obj, &obj->source, PyBUF_SIMPLE) < 0) {
+	Py_DECREF(obj);
 	return NULL;
     }
+    obj->certificate = entry->certificate;
+    obj->spans = entry->spans;
+    Py_INCREF(entry);
+    obj->shared = (PyObject *) entry;
+    return (PyObject *) obj;
+}
 
-    /* count number of bytes */
-    er = der_encode(&asn_DEF_TBSCertificate, &self->certificate->tbsCertificate, NULL, NULL);
-    if (er.encoded == -1) {
-	PyErr_Format(PyExc_ValueError, "failed to encode TBSCertificate as DER (count)");
-	return NULL; /* Failed to encode the data. */
-    }
+static void
+_cache_unlink(parse_cache *self, cache_entry *entry)
+{
+    if (entry->newer)
+	entry->newer->older = entry->older;
     else
-        count = er.encoded; /* Return the number of bytes */
-
-    /* allocate and encode to allocated buffer */
-    allocated = output = PyMem_Malloc(count);
-    er = der_encode(&asn_DEF_TBSCertificate, &self->certificate->tbsCertificate, _print2buffer, (void *) &output);
-    if (er.encoded == -1) {
-	PyMem_Free(allocated);
-	PyErr_Format(PyExc_ValueError, "failed to encode TBSCertificate as DER (print)");
-	return NULL; /* Failed to encode the data. */
-    }
-
-    s = PyString_FromStringAndSize(allocated, count);
-    PyMem_Free(allocated);
-    return s;
+	self->newest = entry->older;
+    if (entry->older)
+	entry->older->newer = entry->newer;
+    else
+	self->oldest = entry->newer;
+    entry->newer = entry->older = NULL;
+    self->bytes -= (Py_ssize_t) entry->size;
 }
 
-static char *
-_oid_to_string(OBJECT_IDENTIFIER_t *oid)
+static void
+_cache_link(parse_cache *self, cache_entry *entry)
 {
-    size_t count = 0;
-    void *allocated, *output;
+    entry->older = self->newest;
+    entry->newer = NULL;
+    if (self->newest)
+	self->newest->newer = entry;
+    else
+	self->oldest = entry;
+    self->newest = entry;
+    self->bytes += (Py_ssize_t) entry->size;
+}
 
-    if (!oid)
-	return NULL;
+/* the entry for the bytes in data (whose hash is key), or NULL if there isn't one */
+static cache_entry *
+_cache_lookup(parse_cache *self, PyObject *key, const Py_buffer *data)
+{
+    cache_entry *entry = (cache_entry *) PyDict_GetItem(self->entries, key);
 
-    if (OBJECT_IDENTIFIER_print(NULL, (const void *) oid, 0, _print2count, (void *) &count))
-	return NULL;
+    if (entry && entry->source.len == data->len && !memcmp(entry->source.buf, data->buf, data->len))
+	return entry;
+    return NULL;
+}
 
-    /* allocate and print to allocated buffer */
-    allocated = output = PyMem_Malloc(count + 1);
+/* add entry as the newest under key (replacing any colliding entry), then evict down to the limits */
+static int
+_cache_insert(parse_cache *self, PyObject *key, cache_entry *entry)
+{
+    cache_entry *old = (cache_entry *) PyDict_GetItem(self->entries, key);
+    PyObject *oldest_key;
 
-    /* write the output */
-    if (OBJECT_IDENTIFIER_print(NULL, (const void *) oid, 0, _print2buffer, (void *) &output)) {
-	PyMem_Free(output);
-	return NULL;
+    if (self->max_bytes && entry->size > (size_t) self->max_bytes)
+	return 0; /* would evict everything else and then itself */
+    Py_XINCREF(old);
+    if (PyDict_SetItem(self->entries, key, (PyObject *) entry) < 0) {
+	Py_XDECREF(old);
+	return -1;
     }
-    
-    *((char *) output) = 0; /* null-terminate */
+    if (old) {
+	/* a different input with the same hash */
+	_cache_unlink(self, old);
+	Py_DECREF(old);
+    }
+    _cache_link(self, entry);
 
-    return allocated;
+    while (self->oldest != entry &&
+	   (PyDict_Size(self->entries) > self->max_entries || (self->max_bytes && self->bytes > self->max_bytes))) {
+	old = self->oldest;
+	_cache_unlink(self, old);
+	if (!(oldest_key = PyLong_FromUnsignedLongLong((unsigned PY_LONG_LONG) old->hash)) ||
+	    PyDict_DelItem(self->entries, oldest_key) < 0) {
+	    Py_XDECREF(oldest_key);
+	    return -1;
+	}
+	Py_DECREF(oldest_key);
+	self->evictions++;
+    }
+    return 0;
 }
 
-/**
- * Find OID name or shortname from dotted string using binary search.
- */
-static const char *
-find_oid(const char *dotted, int shortname)
+static PyObject *
+parse_cache_parse(parse_cache *self, PyObject *args)
 {
-    int lo, hi, len;
-    oid_t *oids;
+    Py_buffer data;
+    PyObject *key, *result = NULL;
+    cache_entry *entry;
+    uint64_t hash;
+    Certificate_t *certificate;
+    cx509_arena arena;
+    cert_spans_t spans;
+    asn_dec_rval_t rval;
 
-    if (shortname) {
-	oids = OID_short_names;
-	if (nOIDs_short_names) {
-	    len = nOIDs_short_names;
-	}
-	else {
-	    for (len = 0; OID_short_names[len].dotted; ++len);
-	    nOIDs_short_names = len;
-	}
+    if (!PyArg_ParseTuple(args, "s*", &data))
+	return NULL;
+    hash = _hash64(data.buf, (size_t) data.len);
+    if (!(key = PyLong_FromUnsignedLongLong((unsigned PY_LONG_LONG) hash)))
+	goto done;
+
+    if ((entry = _cache_lookup(self, key, &data))) {
+	self->hits++;
+	_cache_unlink(self, entry);
+	_cache_link(self, entry);
+	result = _cache_share(entry);
+	goto done;
     }
-    else {
-	oids = OIDs;
-	if (nOIDs) {
-	    len = nOIDs;
-	}
-	else {
-	    for (len = 0; OIDs[len].dotted; ++len);
-	    nOIDs = len;
-	}
+    self->misses++;
+
+    memset(&arena, 0, sizeof(arena));
+    Py_BEGIN_ALLOW_THREADS
+    certificate = _decode_certificate(ber_decode, data.buf, (size_t) data.len, &spans, &rval, &arena);
+    Py_END_ALLOW_THREADS
+    if (!certificate) {
+	/* an empty object, as cx509() gives for input that doesn't decode; not cached */
+	_arena_release(&arena);
+	result = cx509Type.tp_alloc(&cx509Type, 0);
+	goto done;
     }
 
-    lo = 0;
-    hi = len - 1;
-    while (lo <= hi) {
-	int mid = ((unsigned int) lo + (unsigned int) hi) >> 1;
-	int cmp = strcmp(dotted, oids[mid].dotted);
-	if (cmp > 0)
-	    lo = mid + 1;
-	else if (cmp < 0)
-	    hi = mid - 1;
-	else
-	    return oids[mid].name;	/* found */
+    /* another thread may have cached the same bytes while we were decoding them */
+    if ((entry = _cache_lookup(self, key, &data))) {
+	_free_certificate(certificate, &arena);
+	result = _cache_share(entry);
+	goto done;
     }
+    if (!(entry = _cache_entry_new(certificate, &arena, &spans, &data)))
+	goto done;
+    entry->hash = hash;
+    if (_cache_insert(self, key, entry) == 0)
+	result = _cache_share(entry);
+    Py_DECREF(entry);
 
-#if 0 /* for debugging missing OIDs: */
-    printf("WARNING: OID not found: %s\n", dotted);
-#endif
+  done:
+    Py_XDECREF(key);
+    PyBuffer_Release(&data);
+    return result;
+}
 
-    return NULL; /* not found */
+static PyObject *
+parse_cache_clear(parse_cache *self)
+{
+    while (self->oldest)
+	_cache_unlink(self, self->oldest);
+    PyDict_Clear(self->entries);
+    Py_RETURN_NONE;
 }
 
-/* convert an ASN.1 integer type to the equivalent sequence of hex digits */
-static char *
-_integer_to_hex_string(INTEGER_t *iptr)
+static PyObject *
+parse_cache_new(PyTypeObject *type, PyObject *args, PyObject *kw)
 {
-    static const char *nybble = "0123456789ABCDEF";
-    const unsigned char *b;
-    char *allocated = NULL, *output;
+    parse_cache *self = (parse_cache *) type->tp_alloc(type, 0);
 
-    if(!iptr || !iptr->buf || !iptr->size)
+    if (!self)
 	return NULL;
+    if (!(self->entries = PyDict_New())) {
+	Py_DECREF(self);
+	return NULL;
+    }
+    self->max_entries = 1024;
+    return (PyObject *) self;
+}
+
+static int
+parse_cache_init(parse_cache *self, PyObject *args, PyObject *kw)
+{
+    static char *kwlist[] = { "max_entries", "max_bytes", NULL };
 
-    allocated = output = PyMem_Malloc(iptr->size * 2 + 1);
-    for (b = iptr->buf; b < iptr->buf + iptr->size; b++) {
-	*output++ = nybble[(((unsigned int) *b) >> 4) & 0xF];
-	*output++ = nybble[((unsigned int) *b) & 0xF];
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "|nn", kwlist, &self->max_entries, &self->max_bytes))
+	return -1;
+    if (self->max_entries < 1 || self->max_bytes < 0) {
+	PyErr_Format(PyExc_ValueError, "max_entries must be positive and max_bytes not negative");
+	return -1;
     }
-    *output++ = '\0';
-    return allocated;
+    return 0;
 }
 
 static void
-cx509_free(cx509 *self)
+parse_cache_dealloc(parse_cache *self)
 {
-    asn_DEF_Certificate.free_struct(&asn_DEF_Certificate, self->certificate, 0);
-    self->certificate = NULL;
+    Py_XDECREF(self->entries);
     Py_TYPE(self)->tp_free(self);
 }
 
-static PyMemberDef cx509_members[] = {
-    {NULL}  /* Sentinel */
+static Py_ssize_t
+parse_cache_length(parse_cache *self)
+{
+    return PyDict_Size(self->entries);
+}
+
+static PySequenceMethods parse_cache_as_sequence = {
+    (lenfunc) parse_cache_length,		/* sq_length */
 };
 
-static PyMethodDef cx509_methods[] = {
-    {"_parse", (PyCFunction) cx509_parse, METH_VARARGS|METH_KEYWORDS, "Parse the provided BER/DER/CER binary." },
-    {"get_version", (PyCFunction) cx509_get_version, METH_NOARGS, "Return the certificate version." },
-    {"get_validity", (PyCFunction) cx509_get_validity, METH_NOARGS, "Return (earliest, latest) valid date/time." },
-    {"get_issuer", (PyCFunction) cx509_get_issuer, METH_NOARGS, "Return a dict with information about the certificate issuer." },
-    {"get_subject", (PyCFunction) cx509_get_subject, METH_NOARGS, "Return a dict with information about the certificate subject." },
-    {"get_public_key", (PyCFunction) cx509_get_public_key, METH_NOARGS, "Return a dict with information about the public key." },
-    {"get_signature_algorithm", (PyCFunction) cx509_get_signature_algorithm, METH_VARARGS|METH_KEYWORDS, "Return the name of the signature algorithm." },
-    {"get_signature_value", (PyCFunction) cx509_get_signature_value, METH_NOARGS, "Return the raw, encrypted signature data as a string." },
-    {"get_tbs_certificate_data", (PyCFunction) cx509_get_tbs_certificate_data, METH_NOARGS, "Return the raw ASN.1 data for the tbsCertificate component of the certificate." },
-    {"parse_digest_info", (PyCFunction) cx509_parse_digest_info, METH_VARARGS|METH_KEYWORDS, "Parse the decrypted signature value and return a dict for the resulting DisgestInfo." },
-    {"extensions", (PyCFunction) cx509_extensions, METH_NOARGS, "Return list of extensions." },
+static PyMemberDef parse_cache_members[] = {
+    {"max_entries", T_PYSSIZET, offsetof(parse_cache, max_entries), READONLY, "most entries kept"},
+    {"max_bytes", T_PYSSIZET, offsetof(parse_cache, max_bytes), READONLY, "most bytes of input and decoded trees kept (0 for no limit)"},
+    {"bytes", T_PYSSIZET, offsetof(parse_cache, bytes), READONLY, "bytes of input and decoded trees kept"},
+    {"hits", T_PYSSIZET, offsetof(parse_cache, hits), READONLY, "parses answered from the cache"},
+    {"misses", T_PYSSIZET, offsetof(parse_cache, misses), READONLY, "parses that had to decode"},
+    {"evictions", T_PYSSIZET, offsetof(parse_cache, evictions), READONLY, "entries evicted to stay within the limits"},
+    {NULL}  /* Sentinel */
+};
 
+static PyMethodDef parse_cache_methods[] = {
+    {"parse", (PyCFunction) parse_cache_parse, METH_VARARGS, "Return a cx509 object for the given BER/DER buffer, sharing the decoded certificate with earlier results for the same bytes." },
+    {"clear", (PyCFunction) parse_cache_clear, METH_NOARGS, "Drop all entries; objects already returned keep their certificates." },
     {NULL}  /* Sentinel */
 };
 
-static PyTypeObject cx509Type = {
+static PyTypeObject cache_entryType = {
     PyObject_HEAD_INIT(NULL)
     0,						/*ob_size*/
-    "cx509.cx509",  				/*tp_name*/
-    sizeof(cx509),  				/*tp_basicsize*/
+    "cx509._cache_entry",			/*tp_name*/
+    sizeof(cache_entry),			/*tp_basicsize*/
     0,                         			/*tp_itemsize*/
-    (destructor) cx509_free,   			/*tp_dealloc*/
+    (destructor) cache_entry_dealloc,		/*tp_dealloc*/
     0,                         			/*tp_print*/
     0,                         			/*tp_getattr*/
     0,                         			/*tp_setattr*/
@@ -1230,33 +7543,66 @@ static PyTypeObject cx509Type = {
     0,                         			/*tp_as_mapping*/
     0,                         			/*tp_hash */
     0, 	                       			/*tp_call*/
-    (reprfunc) cx509___str__,  			/*tp_str*/
+    0,                         			/*tp_str*/
+    0,                         			/*tp_getattro*/
+    0,                         			/*tp_setattro*/
+    0,                         			/*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,				/*tp_flags*/
+    "decoded certificate shared by cx509 objects from a ParseCache",	/* tp_doc */
+};
+
+static PyTypeObject parse_cacheType = {
+    PyObject_HEAD_INIT(NULL)
+    0,						/*ob_size*/
+    "cx509.ParseCache",				/*tp_name*/
+    sizeof(parse_cache),			/*tp_basicsize*/
+    0,                         			/*tp_itemsize*/
+    (destructor) parse_cache_dealloc,		/*tp_dealloc*/
+    0,                         			/*tp_print*/
+    0,                         			/*tp_getattr*/
+    0,                         			/*tp_setattr*/
+    0,                         			/*tp_compare*/
+    0,                         			/*tp_repr*/
+    0,                         			/*tp_as_number*/
+    &parse_cache_as_sequence,			/*tp_as_sequence*/
+    0,                         			/*tp_as_mapping*/
+    0,                         			/*tp_hash */
+    0, 	                       			/*tp_call*/
+    0,                         			/*tp_str*/
     0,                         			/*tp_getattro*/
     0,                         			/*tp_setattro*/
     0,                         			/*tp_as_buffer*/
     Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,	/*tp_flags*/
-    "cx509 objects",				/* tp_doc */
+    "LRU cache of decoded certificates keyed by their encoding, shared by the cx509 objects it returns",	/* tp_doc */
     0,		               			/* tp_traverse */
     0,		               			/* tp_clear */
     0,		               			/* tp_richcompare */
     0,		               			/* tp_weaklistoffset */
-    0,		               			/* tp_iter */
+    0,						/* tp_iter */
     0,		        			/* tp_iternext */
-    cx509_methods,  				/* tp_methods */
-    cx509_members,  				/* tp_members */
+    parse_cache_methods,			/* tp_methods */
+    parse_cache_members,			/* tp_members */
     0,                         			/* tp_getset */
     0,                         			/* tp_base */
     0,                         			/* tp_dict */
     0,                         			/* tp_descr_get */
     0,                         			/* tp_descr_set */
     0,                         			/* tp_dictoffset */
-    (initproc)cx509_init,			/* tp_init */
+    (initproc) parse_cache_init,		/* tp_init */
     0,                        			/* tp_alloc */
-    cx509_new,    				/* tp_new */
+    parse_cache_new,				/* tp_new */
 };
 
-
 static PyMethodDef module_methods[] = {
+    {"parse_many", (PyCFunction) cx509_parse_many, METH_VARARGS|METH_KEYWORDS, "Decode an iterable of BER/DER/CER (or, with format=\"pem\", PEM) buffers on a native thread pool; return a list of cx509 objects (or ValueError instances for items that failed) in input order. max_size, max_depth, max_elements and max_ns bound each item's decode as they do for _parse (so for format=\"xer\" only max_size and max_ns apply to it); items over budget get a BudgetExceeded instance." },
+    {"_pem_decode", (PyCFunction) cx509__pem_decode, METH_VARARGS, "Return the DER encoding of the first PEM certificate in the given buffer." },
+    {"_use_arena", (PyCFunction) cx509__use_arena, METH_VARARGS, "Turn decoding into per-certificate arenas on or off (for benchmarking); return the previous setting." },
+    {"_alloc_stats", (PyCFunction) cx509__alloc_stats, METH_NOARGS, "Return a dict of allocator calls made by the decoder on this thread: malloc and free (C library) and arena." },
+    {"stats", (PyCFunction) cx509_stats, METH_NOARGS, "Return a dict mapping each instrumented method (and the nested decodes in extensions() and get_public_key()) to its calls, bytes decoded, total ns, decode failures by code (wmore, fail) and latency histogram (a list whose i'th item counts calls taking 2**i to 2**(i+1) ns), summed over all threads since the last reset_stats(); empty if built with CX509_NO_STATS." },
+    {"reset_stats", (PyCFunction) cx509_reset_stats, METH_NOARGS, "Start stats() counting from zero." },
+    {"extract_columns", (PyCFunction) cx509_extract_columns, METH_VARARGS|METH_KEYWORDS, "Extract fields (all, or the names given in fields) from a sequence of cx509 objects and/or BER/DER buffers on a native thread pool; return a dict of read-only typed columns supporting the buffer protocol, with (offsets, data) column pairs for string fields." },
+    {"expiring", (PyCFunction) cx509_expiring, METH_VARARGS|METH_KEYWORDS, "Return the indices of the items in an iterable of cx509 objects and/or DER buffers whose notAfter time (in seconds since the epoch) is before `before` and not before `after` (if given), scanning buffers on a native thread pool without fully decoding them." },
+    {"iter_file", (PyCFunction) cx509_iter_file, METH_VARARGS|METH_KEYWORDS, "Memory-map a file of concatenated DER certificates (format=\"der\") or PEM blocks (format=\"pem\") and lazily yield a cx509 object (or ValueError instance) for each." },
     {NULL}  /* Sentinel */
 };
 
@@ -1269,14 +7615,39 @@ initcx509(void)
 {
     PyObject* m;
 
-    if (PyType_Ready(&cx509Type) < 0)
+    if (PyType_Ready(&cx509Type) < 0 || PyType_Ready(&buffer_ownerType) < 0 || PyType_Ready(&file_iteratorType) < 0 ||
+	PyType_Ready(&cert_storeType) < 0 || PyType_Ready(&hostname_indexType) < 0 ||
+	PyType_Ready(&columnType) < 0 || PyType_Ready(&cache_entryType) < 0 || PyType_Ready(&parse_cacheType) < 0)
         return;
 
+    if (!oid_table && (_interned_init() < 0 || _oid_table_init() < 0 || _extension_decoders_init() < 0))
+	return;
+#ifdef CX509_STATS
+    if (_stat_init() < 0)
+	return;
+#endif
+
     m = Py_InitModule3("cx509", module_methods, "X.509 certificate");
     if (m == NULL)
 	return;
 
     Py_INCREF(&cx509Type);
     PyModule_AddObject(m, "cx509", (PyObject *) &cx509Type);
+    Py_INCREF(&cert_storeType);
+    PyModule_AddObject(m, "CertStore", (PyObject *) &cert_storeType);
+    Py_INCREF(&hostname_indexType);
+    PyModule_AddObject(m, "HostnameIndex", (PyObject *) &hostname_indexType);
+    Py_INCREF(&parse_cacheType);
+    PyModule_AddObject(m, "ParseCache", (PyObject *) &parse_cacheType);
+
+    if (!BudgetExceeded && !(BudgetExceeded = PyErr_NewException("cx509.BudgetExceeded", PyExc_ValueError, NULL)))
+	return;
+    Py_INCREF(BudgetExceeded);
+    PyModule_AddObject(m, "BudgetExceeded", BudgetExceeded);
+
+    _base64_init();
+    PyModule_AddStringConstant(m, "_base64_kernel", base64_kernel_name);
+    _sha_init();
+    PyModule_AddStringConstant(m, "_sha_kernel", sha_kernel_name);
 }
 
@@ -1,5 +1,6 @@
 #!/usr/bin/python
-from distutils.core import setup, Extension
+from distutils.core import setup, Extension, Command
+from distutils.command.build_ext import build_ext
 import os
 import sys
 from glob import glob
@@ -41,19 +42,61 @@ if not os.path.exists('asn1c') or not os.path.exists(rfc5280):
         exit(1)
 
 #
-# Add prebuilt X.509 C sources to sources list; these are asn1c examples, but provide everything we
-# need.
+# Prebuilt X.509 C sources; these are asn1c examples, but provide everything we need.
 #
-sources = glob(os.path.normpath("asn1c/examples/sample.source.PKIX1/*.c"))
-sources.extend(glob(os.path.normpath("asn1c/examples/sample.source.PKCS1/*.c")))
-extra_flags.extend([
-    '-Iasn1c/examples/sample.source.PKIX1',
-    '-Iasn1c/examples/sample.source.PKCS1',
-    '-DPDU=Certificate'
-])
-sources.append('cx509.c')
+asn1c_sources = glob(os.path.normpath("asn1c/examples/sample.source.PKIX1/*.c"))
+asn1c_sources.extend(glob(os.path.normpath("asn1c/examples/sample.source.PKCS1/*.c")))
+asn1c_sources.remove(os.path.normpath('asn1c/examples/sample.source.PKIX1/converter-sample.c'))
+asn1c_include_dirs = [
+    'asn1c/examples/sample.source.PKIX1',
+    'asn1c/examples/sample.source.PKCS1',
+]
+extra_flags.extend(['-I' + d for d in asn1c_include_dirs])
+extra_flags.append('-DPDU=Certificate')
 
-sources.remove(os.path.normpath('asn1c/examples/sample.source.PKIX1/converter-sample.c'))
+# Set CX509_NO_STATS in the environment to compile out cx509.stats() and the USDT probes.
+if os.environ.get('CX509_NO_STATS'):
+    extra_flags.append('-DCX509_NO_STATS')
+
+#
+# The asn1c sources are built as a static library with malloc, calloc, realloc and free redirected
+# to cx509's arena allocator, so certificate trees are decoded into per-object arenas (see "Arena
+# allocator" in cx509.c).
+#
+asn1c_macros = [('PDU', 'Certificate')]
+asn1c_macros.extend([(name, 'cx509_arena_' + name) for name in ('malloc', 'calloc', 'realloc', 'free')])
+
+class build_ext_with_asn1c(build_ext):
+    """build_ext links against the asn1c library, but won't build it by itself (e.g. for --inplace)."""
+    def run(self):
+        self.run_command('build_clib')
+        build_ext.run(self)
+
+class bench(Command):
+    """Build in place, then run bench/suite.py over the synthetic corpus and write its JSON results."""
+    description = "run the benchmark suite"
+    user_options = [
+        ('output=', 'o', "JSON results file [default: bench-results.json]"),
+        ('compare=', 'c', "earlier JSON results to compare against"),
+    ]
+
+    def initialize_options(self):
+        self.output = None
+        self.compare = None
+
+    def finalize_options(self):
+        if self.output is None:
+            self.output = 'bench-results.json'
+
+    def run(self):
+        build = self.reinitialize_command('build_ext')
+        build.inplace = 1
+        self.run_command('build_ext')
+        args = [sys.executable, os.path.join('bench', 'suite.py'), '--output', self.output]
+        if self.compare:
+            args.extend(['--compare', self.compare])
+        if subprocess.call(args) != 0:
+            exit(1)
 
 setup(
     name="cx509",
@@ -64,10 +107,16 @@ setup(
     description="X.509 certificate parsing using parser generated by asn1c.",
     license="MIT",
     platforms=["Platform Independent"],
+    libraries=[('asn1c_pkix', {
+            'sources': asn1c_sources,
+            'include_dirs': asn1c_include_dirs,
+            'macros': asn1c_macros,
+    })],
     ext_modules=[Extension(
             name='cx509',
-            sources=sources,
+            sources=['cx509.c'],
             extra_compile_args=extra_flags,
             extra_link_args=extra_flags
     )],
+    cmdclass={'build_ext': build_ext_with_asn1c, 'bench': bench},
 )